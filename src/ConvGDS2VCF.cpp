@@ -2,7 +2,7 @@
 //
 // ConvGDS2VCF.cpp: format conversion from GDS to VCF
 //
-// Copyright (C) 2013-2018    Xiuwen Zheng
+// Copyright (C) 2013-2020    Xiuwen Zheng
 //
 // This file is part of SeqArray.
 //
@@ -24,6 +24,7 @@
 #include <cstdio>
 #include <cstring>
 #include <vector>
+#include <zlib.h>
 
 using namespace std;
 
@@ -66,61 +67,44 @@ static string QuoteText(const char *p)
 
 // ========================================================================
 
-/// used in SEQ_OutVCF4
-static vector<int> VCF_INFO_Number;    ///<
-static vector<int> VCF_FORMAT_Number;  ///<
-static vector<SEXP> VCF_FORMAT_List;
-
-static size_t VCF_NumAllele;  ///< the number of alleles
-static size_t VCF_NumSample;  ///< the number of samples
-static Rconnection VCF_File = NULL;  ///< R connection object
-
-
 static const size_t LINE_BUFFER_SIZE = 4096;
-static vector<char> LineBuffer;
-static char *LineBegin = NULL;
-static char *LineEnd   = NULL;
-static char *pLine     = NULL;
-
 
-inline static void LineBuf_Init(int num_variant)
+/// the text of diploid genotypes with single-character alleles
+static const struct TGenoTextTable
 {
-	LineBuffer.resize(LINE_BUFFER_SIZE);
-	pLine = LineBegin = &LineBuffer[0];
-	LineEnd = pLine + LINE_BUFFER_SIZE;
-}
-
-inline static void LineBuf_Done()
-{
-	LineBuffer.clear();
-	vector<char>().swap(LineBuffer);
-	LineBegin = pLine = LineEnd = NULL;
-	VCF_INFO_Number.clear();
-	vector<int>().swap(VCF_INFO_Number);
-	VCF_FORMAT_Number.clear();
-	vector<int>().swap(VCF_FORMAT_Number);
-	VCF_FORMAT_List.clear();
-	vector<SEXP>().swap(VCF_FORMAT_List);
-}
-
-inline static void LineBuf_InitPtr()
-{
-	pLine = LineBegin = &LineBuffer[0];
-}
-
-inline static void LineBuf_NeedSize(size_t st)
-{
-	if (pLine + st > LineEnd)
+	C_UInt8 Code[256];  //< 0-9 for alleles, 10 for missing, 11 otherwise
+	char Text[12*12*2][4];  //< "a|b\t" or "a/b\t", or empty if not listed
+	TGenoTextTable()
+	{
+		memset(Code, 11, sizeof(Code));
+		for (int i=0; i < 10; i++) Code[i] = i;
+		Code[NA_RAW] = 10;
+		memset(Text, 0, sizeof(Text));
+		for (int g1=0; g1 <= 10; g1++)
+		{
+			for (int g2=0; g2 <= 10; g2++)
+			{
+				for (int phase=0; phase < 2; phase++)
+				{
+					char *p = Text[((g1*12 + g2) << 1) | phase];
+					p[0] = (g1 < 10) ? ('0' + g1) : '.';
+					p[1] = phase ? '|' : '/';
+					p[2] = (g2 < 10) ? ('0' + g2) : '.';
+					p[3] = '\t';
+				}
+			}
+		}
+	}
+	/// the text of a diploid genotype (4 bytes), empty if not listed
+	inline const char *Di(C_UInt8 g1, C_UInt8 g2, C_UInt8 phase) const
 	{
-		size_t p = pLine - LineBegin;
-		size_t n = p + st;
-		n = (n / LINE_BUFFER_SIZE + 1) * LINE_BUFFER_SIZE;
-		LineBuffer.resize(n);
-		LineBegin = &LineBuffer[0];
-		pLine = LineBegin + p;
-		LineEnd = LineBegin + n;
+		return Text[((Code[g1]*12 + Code[g2]) << 1) | (phase ? 1 : 0)];
 	}
-}
+} GENO_TEXT;
+
+/// "0/0\t" and "0|0\t" as 32-bit integers (little endian), used in SIMD
+static const int GENO_REF_UNPHASED = 0x09302F30;
+static const int GENO_REF_PHASED   = 0x09307C30;
 
 inline static char *fast_itoa(char *p, int32_t val)
 {
@@ -145,767 +129,1444 @@ inline static char *fast_itoa(char *p, int32_t val)
 	return p;
 }
 
-inline static void _Line_Append(int val)
+/// the types of values in TVCF_Value
+enum TVCF_ValueType
 {
-	if (val != NA_INTEGER)
-		pLine = fast_itoa(pLine, val);
-	else
-		*pLine++ = '.';
-}
-
-inline static void _Line_Append_Geno(int val)
+	VCF_VAL_NULL = 0,  ///< NULL or unsupported
+	VCF_VAL_RAW  = 1,  ///< RAW
+	VCF_VAL_INT  = 2,  ///< INTEGER
+	VCF_VAL_LGL  = 3,  ///< LOGICAL
+	VCF_VAL_REAL = 4,  ///< REAL
+	VCF_VAL_STR  = 5   ///< CHARACTER or factor
+};
+
+/// the values of a variable in a VCF line, extracted from an R object in the
+///   main thread, and then formatted without calling the R API
+struct COREARRAY_DLL_LOCAL TVCF_Value
 {
-	if (val >= 0)
+	int Type;              ///< TVCF_ValueType
+	size_t Len;            ///< the number of values
+	const C_UInt8 *pRaw;   ///< RAW values
+	const int *pInt;       ///< INTEGER or LOGICAL values
+	const double *pReal;   ///< REAL values
+	vector<const char*> pStr;  ///< strings, NULL for NA
+
+	TVCF_Value() { Type = VCF_VAL_NULL; Len = 0; pRaw = NULL; pInt = NULL; pReal = NULL; }
+
+	/// set the values, copied if 'copy' is true, otherwise the pointers refer
+	///   to the R object which should not be released when formatting
+	void Set(SEXP X, bool copy)
 	{
-		if (val < 10)
-			*pLine++ = val + '0';
-		else
-			pLine = fast_itoa(pLine, val);
-	} else 
-		*pLine++ = '.';
-}
-
-inline static void _Line_Append_Geno_Raw(C_UInt8 val)
-{
-	if (val < 10)
-		*pLine++ = val + '0';
-	else if (val == NA_RAW)
-		*pLine++ = '.';
-	else
-		pLine = fast_itoa(pLine, val);
-}
-
-inline static void _Line_Append(double val)
-{
-	if (R_FINITE(val))
-		pLine += sprintf(pLine, "%g", val);
-	else
-		*pLine++ = '.';
-}
-
-
-inline static void LineBuf_Append(int val)
-{
-	LineBuf_NeedSize(32);
-	_Line_Append(val);
-}
-
-inline static void LineBuf_Append(double val)
-{
-	LineBuf_NeedSize(32);
-	_Line_Append(val);
-}
-
-inline static void LineBuf_Append(const char *txt)
-{
-	const size_t n = strlen(txt);
-	LineBuf_NeedSize(n + 16);
-	memcpy(pLine, txt, n);
-	pLine += n;
-}
-
-
-inline static void put_text(const char *fmt, ...)
-{
-	va_list args;
-	va_start(args, fmt);
-	(*VCF_File->vfprintf)(VCF_File, fmt, args);
-	va_end(args);
-}
+		Type = VCF_VAL_NULL;
+		Len = 0;
+		pRaw = NULL; pInt = NULL; pReal = NULL;
+		pStr.clear();
+		if (Rf_isFactor(X))
+		{
+			Set_Str(PROTECT(Rf_asCharacterFactor(X)));
+			UNPROTECT(1);
+			return;
+		}
+		switch (TYPEOF(X))
+		{
+		case RAWSXP:
+			Type = VCF_VAL_RAW; Len = XLENGTH(X);
+			pRaw = (const C_UInt8*)RAW(X);
+			if (copy)
+			{
+				BufRaw.assign(pRaw, pRaw + Len);
+				pRaw = Len ? &BufRaw[0] : NULL;
+			}
+			break;
+		case INTSXP: case LGLSXP:
+			Type = IS_LOGICAL(X) ? VCF_VAL_LGL : VCF_VAL_INT;
+			Len = XLENGTH(X);
+			pInt = IS_LOGICAL(X) ? LOGICAL(X) : INTEGER(X);
+			if (copy)
+			{
+				BufInt.assign(pInt, pInt + Len);
+				pInt = Len ? &BufInt[0] : NULL;
+			}
+			break;
+		case REALSXP:
+			Type = VCF_VAL_REAL; Len = XLENGTH(X);
+			pReal = REAL(X);
+			if (copy)
+			{
+				BufReal.assign(pReal, pReal + Len);
+				pReal = Len ? &BufReal[0] : NULL;
+			}
+			break;
+		case STRSXP:
+			Set_Str(X); break;
+		}
+	}
 
+private:
+	vector<C_UInt8> BufRaw;  ///< the buffer of RAW values
+	vector<int> BufInt;      ///< the buffer of INTEGER or LOGICAL values
+	vector<double> BufReal;  ///< the buffer of REAL values
+	vector<char> BufStr;     ///< the buffer of null-terminated strings
 
+	/// strings are always copied, since CHARSXP may be released
+	void Set_Str(SEXP X)
+	{
+		Type = VCF_VAL_STR; Len = XLENGTH(X);
+		size_t size = 0;
+		for (size_t i=0; i < Len; i++)
+		{
+			SEXP s = STRING_ELT(X, i);
+			if (s != NA_STRING) size += strlen(CHAR(s)) + 1;
+		}
+		BufStr.resize(size);
+		pStr.resize(Len);
+		char *p = size ? &BufStr[0] : NULL;
+		for (size_t i=0; i < Len; i++)
+		{
+			SEXP s = STRING_ELT(X, i);
+			if (s != NA_STRING)
+			{
+				const size_t n = strlen(CHAR(s)) + 1;
+				memcpy(p, CHAR(s), n);
+				pStr[i] = p; p += n;
+			} else
+				pStr[i] = NULL;
+		}
+	}
+};
 
-// ========================================================================
 
 /// return the number in the INFO field
-inline static int INFO_GetNum(SEXP X, int n)
+inline static int INFO_GetNum(const TVCF_Value &X, int n)
 {
-	if (n < 0) n = Rf_length(X);
+	if (n < 0 || (size_t)n > X.Len) n = X.Len;
 
-	if (IS_INTEGER(X))
+	if (X.Type == VCF_VAL_INT)
 	{
-		int *p = INTEGER(X) + n;
+		const int *p = X.pInt + n;
 		for (; n > 0; n--)
 			if (*(--p) != NA_INTEGER) break;
-	} else if (IS_NUMERIC(X))
+	} else if (X.Type == VCF_VAL_REAL)
 	{
-		double *p = REAL(X) + n;
+		const double *p = X.pReal + n;
 		for (; n > 0; n--)
 			if (R_finite(*(--p))) break;
-	} else if (IS_CHARACTER(X))
+	} else if (X.Type == VCF_VAL_STR)
 	{
 		for (; n > 0; n--)
 		{
-			SEXP s = STRING_ELT(X, n-1);
-			if ((s != NA_STRING) && (CHAR(s)[0] != 0)) break;
+			const char *s = X.pStr[n-1];
+			if (s && (s[0] != 0)) break;
 		}
-	}
+	} else
+		n = 0;
 
 	return n;
 }
 
 
-/// write info values
-inline static void INFO_Write(SEXP X, size_t n)
+/// the types of VCF lines, according to SEQ_ToVCF*
+enum TVCF_LineType
 {
-	size_t i = 0;
-	if (IS_INTEGER(X))
-	{
-		LineBuf_NeedSize(12*n + 32);
-		for (int *p = INTEGER(X); i < n; i++)
-		{
-			if (i > 0) *pLine++ = ',';
-			_Line_Append(*p++);
-		}
-	} else if (IS_NUMERIC(X))
+	VCF_LINE_GENERAL   = 0,  ///< SEQ_ToVCF
+	VCF_LINE_DI_WRTFMT = 1,  ///< SEQ_ToVCF_Di_WrtFmt
+	VCF_LINE_HAPLOID   = 2,  ///< SEQ_ToVCF_Haploid
+	VCF_LINE_NOGENO    = 3   ///< SEQ_ToVCF_NoGeno
+};
+
+
+/// the data of a variant in a VCF line, see the list passed to SEQ_ToVCF*
+struct COREARRAY_DLL_LOCAL TVCF_Variant
+{
+	string Chr;       ///< CHROM
+	int Pos;          ///< POS
+	string ID;        ///< ID
+	string Allele;    ///< REF and ALT separated by ','
+	double Qual;      ///< QUAL
+	string Filter;    ///< FILTER
+	TVCF_Value Geno;   ///< genotypes
+	TVCF_Value Phase;  ///< phasing information
+	vector<string> InfoName;   ///< the names of INFO variables
+	vector<TVCF_Value> Info;   ///< INFO variables
+	vector<string> FmtName;    ///< the names of FORMAT variables
+	vector<TVCF_Value> Fmt;    ///< FORMAT variables
+
+	/// extract the data of the list 'X' in the main thread
+	void Set(int type, SEXP X, size_t num_info, size_t num_fmt, bool copy)
 	{
-		LineBuf_NeedSize(12*n + 32);
-		for (double *p = REAL(X); i < n; i++)
+		Chr = CHAR(STRING_ELT(VECTOR_ELT(X, 0), 0));
+		Pos = Rf_asInteger(VECTOR_ELT(X, 1));
+		ID = CHAR(STRING_ELT(VECTOR_ELT(X, 2), 0));
+		Allele = CHAR(STRING_ELT(VECTOR_ELT(X, 3), 0));
+		Qual = Rf_asReal(VECTOR_ELT(X, 4));
+		SEXP tmp = VECTOR_ELT(X, 5);
+		if (Rf_isFactor(tmp))
+			tmp = Rf_asCharacterFactor(tmp);
+		else
+			tmp = AS_CHARACTER(tmp);
+		PROTECT(tmp);
+		Filter = CHAR(STRING_ELT(tmp, 0));
+		UNPROTECT(1);
+
+		size_t info_st = 6;
+		if (type != VCF_LINE_NOGENO)
+			Geno.Set(VECTOR_ELT(X, info_st++), copy);
+		if (type == VCF_LINE_GENERAL || type == VCF_LINE_DI_WRTFMT)
+			Phase.Set(VECTOR_ELT(X, info_st++), copy);
+
+		SEXP VarNames = getAttrib(X, R_NamesSymbol);
+		InfoName.resize(num_info);
+		Info.resize(num_info);
+		for (size_t i=0; i < num_info; i++)
 		{
-			if (i > 0) *pLine++ = ',';
-			_Line_Append(*p++);
+			// "info.*"
+			InfoName[i] = CHAR(STRING_ELT(VarNames, i + info_st)) + 5;
+			Info[i].Set(VECTOR_ELT(X, i + info_st), copy);
 		}
-	} else if (IS_CHARACTER(X))
-	{
-		for (; i < n; i++)
+		FmtName.resize(num_fmt);
+		Fmt.resize(num_fmt);
+		for (size_t i=0; i < num_fmt; i++)
 		{
-			if (i > 0) *pLine++ = ',';
-			LineBuf_Append(CHAR(STRING_ELT(X, i)));
+			// "fmt.*"
+			const size_t k = i + num_info + info_st;
+			FmtName[i] = CHAR(STRING_ELT(VarNames, k)) + 4;
+			Fmt[i].Set(VECTOR_ELT(X, k), copy);
 		}
 	}
-}
+};
 
 
-/// write format values
-inline static void FORMAT_Write(SEXP X, size_t n, size_t Start, size_t Step)
+/// format the variants to VCF lines, appended to a text buffer
+class COREARRAY_DLL_LOCAL CVCF_Formatter
 {
-	if (IS_INTEGER(X) || IS_LOGICAL(X))
+public:
+	/// constructor
+	CVCF_Formatter(SEXP Sel, SEXP Info, SEXP Format)
 	{
-		int *base = (IS_INTEGER(X) ? INTEGER(X) : LOGICAL(X)) + Start;
-		int *p = base + (n - 1)*Step;
-		for (; n > 0; n--, p-=Step)
-			if (*p != NA_INTEGER) break;
-		LineBuf_NeedSize(12*n + 32);
-		p = base;
-		for (size_t i=0; i < n; i++)
-		{
-			if (i > 0) *pLine++ = ',';
-			_Line_Append(*p);
-			p += Step;
-		}
-	} else if (IS_NUMERIC(X))
+		NumAllele = INTEGER(Sel)[0];
+		NumSample = INTEGER(Sel)[1];
+
+		int *pInfo = INTEGER(Info);
+		INFO_Number.assign(pInfo, pInfo + Rf_length(Info));
+
+		int *pFmt = INTEGER(Format);
+		FORMAT_Number.assign(pFmt, pFmt + Rf_length(Format));
+
+		FORMAT_List.reserve(256);
+		LineBuffer.resize(LINE_BUFFER_SIZE);
+		pLine = LineBegin = &LineBuffer[0];
+		LineEnd = pLine + LINE_BUFFER_SIZE;
+	}
+
+	/// clear the text buffer
+	inline void Clear() { pLine = LineBegin; }
+	/// the starting pointer of text
+	inline const char *Text() const { return LineBegin; }
+	/// the number of characters in the buffer
+	inline size_t Size() const { return pLine - LineBegin; }
+	/// the null-terminated text
+	inline const char *CString()
 	{
-		double *base = REAL(X) + Start;
-		double *p = base + (n - 1)*Step;
-		for (; n > 0; n--, p-=Step)
-			if (R_finite(*p)) break;
-		LineBuf_NeedSize(12*n + 32);
-		p = base;
-		for (size_t i=0; i < n; i++)
-		{
-			if (i > 0) *pLine++ = ',';
-			_Line_Append(*p);
-			p += Step;
-		}
-	} else if (IS_CHARACTER(X) || Rf_isFactor(X))
+		LineBuf_NeedSize(1);
+		*pLine = 0;
+		return LineBegin;
+	}
+
+	/// append a VCF line according to the line type
+	void Format(int type, const TVCF_Variant &X)
 	{
-		if (Rf_isFactor(X))
-			X = Rf_asCharacterFactor(X);
-		for (; n > 0; n--)
+		switch (type)
 		{
-			SEXP s = STRING_ELT(X, Start + (n - 1)*Step);
-			if ((s != NA_STRING) && (CHAR(s)[0] != 0)) break;
+			case VCF_LINE_GENERAL:
+				ToVCF(X); break;
+			case VCF_LINE_DI_WRTFMT:
+				ToVCF_Di_WrtFmt(X); break;
+			case VCF_LINE_HAPLOID:
+				ToVCF_Haploid(X); break;
+			default:
+				ToVCF_NoGeno(X);
 		}
-		for (size_t i=0; i < n; i++, Start += Step)
+	}
+
+	/// convert to VCF4 in general
+	void ToVCF(const TVCF_Variant &X)
+	{
+		// CHROM, POS, ID, REF, ALT, QUAL, FILTER
+		ExportHead(X);
+		// INFO, FORMAT
+		ExportInfoFormat(X, true);
+		// phase information
+		const C_UInt8 *pAllele = X.Phase.pRaw;
+
+		// genotype
+		const TVCF_Value &geno = X.Geno;
+
+		if (geno.Type == VCF_VAL_RAW)
 		{
-			if (i > 0) *pLine++ = ',';
-			SEXP s = STRING_ELT(X, Start);
-			if (s != NA_STRING)
-				LineBuf_Append(CHAR(s));
-			else
-				*pLine++ = '.';
+			const C_UInt8 *pSamp = geno.pRaw;
+			// for-loop of samples
+			for (size_t i=0; i < NumSample; i++)
+			{
+				// add '\t'
+				if (i > 0) *pLine++ = '\t';
+				// genotypes
+				LineBuf_NeedSize(NumAllele << 4); // NumAllele*16
+				const char *s;
+				if (NumAllele == 2 &&
+					(s = GENO_TEXT.Di(pSamp[0], pSamp[1], *pAllele))[0])
+				{
+					// a single 4-byte store, '\t' is overwritten if needed
+					memcpy(pLine, s, 4);
+					pLine += 3; pSamp += 2; pAllele ++;
+				} else if (NumAllele == 2)
+				{
+					_Line_Append_Geno_Raw(*pSamp++);
+					*pLine++ = (*pAllele++) ? '|' : '/';
+					_Line_Append_Geno_Raw(*pSamp++);
+				} else {
+					for (size_t j=0; j < NumAllele; j++)
+					{
+						if (j > 0)
+							*pLine++ = (*pAllele++) ? '|' : '/';
+						_Line_Append_Geno_Raw(*pSamp++);
+					}
+				}
+				// annotation
+				vector<const TVCF_Value*>::iterator p;
+				for (p=FORMAT_List.begin(); p != FORMAT_List.end(); p++)
+				{
+					*pLine++ = ':';
+					size_t n = (*p)->Len / NumSample;
+					FORMAT_Write(**p, n, i, NumSample);
+				}
+			}
+		} else {
+			const int *pSamp = geno.pInt;
+			// for-loop of samples
+			for (size_t i=0; i < NumSample; i++)
+			{
+				// add '\t'
+				if (i > 0) *pLine++ = '\t';
+				// genotypes
+				LineBuf_NeedSize(NumAllele << 4); // NumAllele*16
+				if (NumAllele == 2)
+				{
+					_Line_Append_Geno(*pSamp++);
+					*pLine++ = (*pAllele++) ? '|' : '/';
+					_Line_Append_Geno(*pSamp++);
+				} else {
+					for (size_t j=0; j < NumAllele; j++)
+					{
+						if (j > 0)
+							*pLine++ = (*pAllele++) ? '|' : '/';
+						_Line_Append_Geno(*pSamp++);
+					}
+				}
+				// annotation
+				vector<const TVCF_Value*>::iterator p;
+				for (p=FORMAT_List.begin(); p != FORMAT_List.end(); p++)
+				{
+					*pLine++ = ':';
+					size_t n = (*p)->Len / NumSample;
+					FORMAT_Write(**p, n, i, NumSample);
+				}
+			}
 		}
-	}
 
-	if (n <= 0) *pLine++ = '.';
-}
+		*pLine++ = '\n';
+	}
 
+	/// convert to VCF4, diploid without FORMAT variables
+	void ToVCF_Di_WrtFmt(const TVCF_Variant &X)
+	{
+		// CHROM, POS, ID, REF, ALT, QUAL, FILTER
+		ExportHead(X);
+		// INFO, FORMAT
+		ExportInfoFormat(X, true);
+		// phase information
+		const C_UInt8 *pAllele = X.Phase.pRaw;
 
+		// for-loop, genotypes
+		size_t n = NumSample;
 
+		// genotype
+		const TVCF_Value &geno = X.Geno;
 
+		if (geno.Type == VCF_VAL_RAW)
+		{
+			const C_UInt8 *pSamp = geno.pRaw;
 
-// ========================================================================
+		#ifdef COREARRAY_SIMD_SSE2
 
-/// export the first seven columns: chr, pos, id, allele (REF/ALT), qual, filter
-inline static void ExportHead(SEXP X)
-{
-	// CHROM
-	LineBuf_Append(CHAR(STRING_ELT(VECTOR_ELT(X, 0), 0)));
-	*pLine++ = '\t';
+			// need buffer, the line is appended to the previous lines, so
+			//   unaligned stores are used
+			LineBuf_NeedSize(n*4 + 64);
 
-	// POS
-	LineBuf_Append(Rf_asInteger(VECTOR_ELT(X, 1)));
-	*pLine++ = '\t';
+			static const __m128i char_unphased = _mm_set1_epi8('/');
+			static const __m128i char_phased = _mm_set1_epi8('|');
+			static const __m128i char_tab = _mm_set1_epi8('\t');
 
-	// ID
-	char *s = (char*)CHAR(STRING_ELT(VECTOR_ELT(X, 2), 0));
-	if (*s != 0)
-		LineBuf_Append(s);
-	else
-		*pLine++ = '.';
-	*pLine++ = '\t';
+		#ifdef COREARRAY_SIMD_AVX2
+			static const __m256i ten = _mm256_set1_epi8(10);
+			static const __m256i na  = _mm256_set1_epi8(0xFF);
+			static const __m256i char_zero = _mm256_set1_epi8('0');
+			static const __m256i char_na = _mm256_set1_epi8('.');
+			static const __m256i ref_unphased = _mm256_set1_epi32(GENO_REF_UNPHASED);
+			static const __m256i ref_phased = _mm256_set1_epi32(GENO_REF_PHASED);
 
-	// allele -- REF/ALT
-	size_t n = pLine - LineBegin;
-	LineBuf_Append(CHAR(STRING_ELT(VECTOR_ELT(X, 3), 0)));
+			for (; n >= 16; n-=16)
+			{
+				__m256i v1 = MM_LOADU_256(pSamp);
+				__m128i v3 = MM_LOADU_128(pAllele);
+				// a run of 16 "0/0" or "0|0"
+				if (_mm256_testz_si256(v1, v1))
+				{
+					int m = _mm_movemask_epi8(
+						_mm_cmpeq_epi8(v3, _mm_setzero_si128()));
+					if (m == 0xFFFF || m == 0)
+					{
+						__m256i r = m ? ref_unphased : ref_phased;
+						_mm256_storeu_si256((__m256i *)pLine, r);
+						_mm256_storeu_si256((__m256i *)(pLine+32), r);
+						pSamp += 32; pAllele += 16; pLine += 64;
+						continue;
+					}
+				}
+				__m256i m1 = _mm256_cmpeq_epi8(v1, na);
+				if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(ten, _mm256_min_epu8(
+					_mm256_andnot_si256(m1, v1), ten)))) break;
+				pSamp += 32;
+
+				v1 = _mm256_add_epi8(v1, char_zero);
+				v1 = MM_BLEND_256(char_na, v1, m1);
+
+				pAllele += 16;
+				__m128i m = _mm_cmpeq_epi8(v3, _mm_setzero_si128());
+				v3 = MM_BLEND_128(char_unphased, char_phased, m);
+				__m256i phase = MM_SET_M128(_mm_unpackhi_epi8(v3, char_tab),
+					_mm_unpacklo_epi8(v3, char_tab));
+
+				__m256i w1 = _mm256_unpacklo_epi8(v1, phase);
+				__m256i w2 = _mm256_unpackhi_epi8(v1, phase);
+				_mm256_storeu_si256((__m256i *)pLine,
+					_mm256_permute2x128_si256(w1, w2, 0x20));
+				_mm256_storeu_si256((__m256i *)(pLine+32),
+					_mm256_permute2x128_si256(w1, w2, 0x31));
+				pLine += 64;
+			}
+		#else
+			static const __m128i ten = _mm_set1_epi8(10);
+			static const __m128i na  = _mm_set1_epi8(0xFF);
+			static const __m128i char_zero = _mm_set1_epi8('0');
+			static const __m128i char_na = _mm_set1_epi8('.');
+			static const __m128i ref_unphased = _mm_set1_epi32(GENO_REF_UNPHASED);
+			static const __m128i ref_phased = _mm_set1_epi32(GENO_REF_PHASED);
+
+			for (; n >= 16; n-=16)
+			{
+				__m128i v1 = MM_LOADU_128(pSamp);
+				__m128i v2 = MM_LOADU_128((pSamp+16));
+				// a run of 16 "0/0" or "0|0"
+				__m128i z = _mm_cmpeq_epi8(_mm_or_si128(v1, v2),
+					_mm_setzero_si128());
+				if (_mm_movemask_epi8(z) == 0xFFFF)
+				{
+					int m = _mm_movemask_epi8(_mm_cmpeq_epi8(
+						MM_LOADU_128(pAllele), _mm_setzero_si128()));
+					if (m == 0xFFFF || m == 0)
+					{
+						__m128i r = m ? ref_unphased : ref_phased;
+						_mm_storeu_si128((__m128i *)pLine, r);
+						_mm_storeu_si128((__m128i *)(pLine+16), r);
+						_mm_storeu_si128((__m128i *)(pLine+32), r);
+						_mm_storeu_si128((__m128i *)(pLine+48), r);
+						pSamp += 32; pAllele += 16; pLine += 64;
+						continue;
+					}
+				}
 
-	for (s = LineBegin+n; s < pLine; s++)
-	{
-		if (*s == ',')
-			{ *s = '\t'; break; }
-	}
-	if (s == pLine)
-	{
-		*pLine++ = '\t';
-		*pLine++ = '.';
-	}
-	*pLine++ = '\t';
-
-	// QUAL
-	LineBuf_Append(Rf_asReal(VECTOR_ELT(X, 4)));
-	*pLine++ = '\t';
-
-	// FILTER
-	SEXP tmp = VECTOR_ELT(X, 5);
-	if (Rf_isFactor(tmp))
-		tmp = Rf_asCharacterFactor(tmp);
-	else
-		tmp = AS_CHARACTER(tmp);
-	LineBuf_Append(CHAR(STRING_ELT(tmp, 0)));
-	*pLine++ = '\t';
-}
+				__m128i m1 = _mm_cmpeq_epi8(v1, na);
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(ten, _mm_min_epu8(
+					_mm_andnot_si128(m1, v1), ten)))) break;
+
+				__m128i m2 = _mm_cmpeq_epi8(v2, na);
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(ten, _mm_min_epu8(
+					_mm_andnot_si128(m2, v2), ten)))) break;
+				pSamp += 32;
+
+				v1 = _mm_add_epi8(v1, char_zero);
+				v1 = MM_BLEND_128(char_na, v1, m1);
+				v2 = _mm_add_epi8(v2, char_zero);
+				v2 = MM_BLEND_128(char_na, v2, m2);
+
+				__m128i v3 = MM_LOADU_128(pAllele);
+				pAllele += 16;
+				__m128i m = _mm_cmpeq_epi8(v3, _mm_setzero_si128());
+				v3 = MM_BLEND_128(char_unphased, char_phased, m);
+
+				__m128i p1 = _mm_unpacklo_epi8(v3, char_tab);
+				__m128i p2 = _mm_unpackhi_epi8(v3, char_tab);
+
+				_mm_storeu_si128((__m128i *)pLine, _mm_unpacklo_epi8(v1, p1));
+				_mm_storeu_si128((__m128i *)(pLine+16), _mm_unpackhi_epi8(v1, p1));
+				_mm_storeu_si128((__m128i *)(pLine+32), _mm_unpacklo_epi8(v2, p2));
+				_mm_storeu_si128((__m128i *)(pLine+48), _mm_unpackhi_epi8(v2, p2));
+				pLine += 64;
+			}
+		#endif
 
+		#endif
 
-/// export the INFO and FORMAT fields
-inline static void ExportInfoFormat(SEXP X, size_t info_st)
-{
-	// variable list
-	SEXP VarNames = getAttrib(X, R_NamesSymbol);
+			// tail
+			for (; n > 0; n--)
+			{
+				LineBuf_NeedSize(32);
+				const char *s = GENO_TEXT.Di(pSamp[0], pSamp[1], *pAllele);
+				if (s[0])
+				{
+					memcpy(pLine, s, 4);
+					pLine += 4; pSamp += 2; pAllele ++;
+				} else {
+					_Line_Append_Geno_Raw(*pSamp++);
+					*pLine++ = (*pAllele++) ? '|' : '/';
+					_Line_Append_Geno_Raw(*pSamp++);
+					*pLine++ = '\t';
+				}
+			}
+		} else {
+			// integer vector for genotypes
+			const int *pSamp = geno.pInt;
+			for (; n > 0; n--)
+			{
+				LineBuf_NeedSize(32);
+				_Line_Append_Geno(*pSamp++);
+				*pLine++ = (*pAllele++) ? '|' : '/';
+				_Line_Append_Geno(*pSamp++);
+				*pLine++ = '\t';
+			}
+		}
 
-	//====  INFO  ====//
+		pLine--; *pLine++ = '\n';
+	}
 
-	LineBuf_NeedSize(32);
-	size_t cnt_info = VCF_INFO_Number.size();
-	size_t n = 0;
-	for (size_t i=0; i < cnt_info; i++)
+	/// convert to haploid VCF4
+	void ToVCF_Haploid(const TVCF_Variant &X)
 	{
-		// name, "info.*"
-		const char *nm = CHAR(STRING_ELT(VarNames, i + info_st)) + 5;
-		// SEXP
-		SEXP D = VECTOR_ELT(X, i + info_st);
+		// CHROM, POS, ID, REF, ALT, QUAL, FILTER
+		ExportHead(X);
+		// INFO, FORMAT
+		ExportInfoFormat(X, true);
 
-		if (IS_LOGICAL(D))  // FLAG type
+		// genotype
+		const TVCF_Value &geno = X.Geno;
+
+		if (geno.Type == VCF_VAL_RAW)
 		{
-			if (Rf_asLogical(D) == TRUE)
+			const C_UInt8 *pSamp = geno.pRaw;
+			// for-loop of samples
+			for (size_t i=0; i < NumSample; i++)
 			{
-				if (n > 0) *pLine++ = ';';
-				LineBuf_Append(nm);
-				n ++;
+				// add '\t'
+				if (i > 0) *pLine++ = '\t';
+				// genotypes
+				LineBuf_NeedSize(NumAllele << 3); // NumAllele*8
+				_Line_Append_Geno_Raw(*pSamp++);
+				// annotation
+				vector<const TVCF_Value*>::iterator p;
+				for (p=FORMAT_List.begin(); p != FORMAT_List.end(); p++)
+				{
+					*pLine++ = ':';
+					size_t n = (*p)->Len / NumSample;
+					FORMAT_Write(**p, n, i, NumSample);
+				}
 			}
 		} else {
-			int m = INFO_GetNum(D, VCF_INFO_Number[i]);
-			if (m > 0)
+			const int *pSamp = geno.pInt;
+			// for-loop of samples
+			for (size_t i=0; i < NumSample; i++)
 			{
-				if (n > 0) *pLine++ = ';';
-				LineBuf_Append(nm);
-				*pLine++ = '=';
-				INFO_Write(D, m);
-				n ++;
+				// add '\t'
+				if (i > 0) *pLine++ = '\t';
+				// genotypes
+				LineBuf_NeedSize(NumAllele << 3); // NumAllele*8
+				_Line_Append_Geno(*pSamp++);
+				// annotation
+				vector<const TVCF_Value*>::iterator p;
+				for (p=FORMAT_List.begin(); p != FORMAT_List.end(); p++)
+				{
+					*pLine++ = ':';
+					size_t n = (*p)->Len / NumSample;
+					FORMAT_Write(**p, n, i, NumSample);
+				}
 			}
 		}
+
+		*pLine++ = '\n';
 	}
 
-	if (n <= 0) *pLine++ = '.';
-	*pLine++ = '\t';
+	/// convert to VCF4 without genotypes
+	void ToVCF_NoGeno(const TVCF_Variant &X)
+	{
+		// CHROM, POS, ID, REF, ALT, QUAL, FILTER
+		ExportHead(X);
+		// INFO, FORMAT
+		ExportInfoFormat(X, false);
+
+		// for-loop of samples
+		for (size_t i=0; i < NumSample; i++)
+		{
+			// add '\t'
+			if (i > 0) *pLine++ = '\t';
+			// annotation
+			vector<const TVCF_Value*>::iterator p;
+			vector<const TVCF_Value*>::iterator st = FORMAT_List.begin();
+			for (p=st; p != FORMAT_List.end(); p++)
+			{
+				if (p != st) *pLine++ = ':';
+				size_t n = (*p)->Len / NumSample;
+				FORMAT_Write(**p, n, i, NumSample);
+			}
+		}
+		*pLine++ = '\n';
+	}
 
-	//====  FORMAT  ====//
+private:
+	vector<int> INFO_Number;    ///< the numbers of INFO variables
+	vector<int> FORMAT_Number;  ///< the numbers of FORMAT variables
+	vector<const TVCF_Value*> FORMAT_List;  ///< FORMAT variables in the current line
+	size_t NumAllele;  ///< the number of alleles
+	size_t NumSample;  ///< the number of samples
 
-	VCF_FORMAT_List.clear();
-	size_t cnt_fmt = VCF_FORMAT_Number.size();
+	vector<char> LineBuffer;  ///< the line buffer
+	char *LineBegin;   ///< the starting pointer of line buffer
+	char *LineEnd;     ///< the end pointer of line buffer
+	char *pLine;       ///< the current pointer
 
-	LineBuf_NeedSize(32);
-	if (info_st > 6)
+	inline void LineBuf_NeedSize(size_t st)
 	{
-		pLine[0] = 'G'; pLine[1] = 'T';
-		pLine += 2;
-	} else if (cnt_fmt <= 0)
+		if (pLine + st > LineEnd)
+		{
+			size_t p = pLine - LineBegin;
+			size_t n = p + st;
+			n = (n / LINE_BUFFER_SIZE + 1) * LINE_BUFFER_SIZE;
+			LineBuffer.resize(n);
+			LineBegin = &LineBuffer[0];
+			pLine = LineBegin + p;
+			LineEnd = LineBegin + n;
+		}
+	}
+
+	inline void _Line_Append(int val)
 	{
-		pLine[0] = '.';
-		pLine ++;
+		if (val != NA_INTEGER)
+			pLine = fast_itoa(pLine, val);
+		else
+			*pLine++ = '.';
 	}
 
-	for (size_t i=0; i < cnt_fmt; i++)
+	inline void _Line_Append_Geno(int val)
 	{
-		// name, "fmt.*"
-		SEXP D = VECTOR_ELT(X, i + cnt_info + info_st);
-		if (!isNull(D))
+		if (val >= 0)
 		{
-			if (i > 0 || info_st > 6)
-				*pLine++ = ':';
-			const char *nm = CHAR(STRING_ELT(VarNames, i + cnt_info + info_st));
-			LineBuf_Append(nm + 4);
-			VCF_FORMAT_List.push_back(D);
-		}
+			if (val < 10)
+				*pLine++ = val + '0';
+			else
+				pLine = fast_itoa(pLine, val);
+		} else 
+			*pLine++ = '.';
 	}
-	*pLine++ = '\t';
-}
 
-}
+	inline void _Line_Append_Geno_Raw(C_UInt8 val)
+	{
+		if (val < 10)
+			*pLine++ = val + '0';
+		else if (val == NA_RAW)
+			*pLine++ = '.';
+		else
+			pLine = fast_itoa(pLine, val);
+	}
 
+	inline void _Line_Append(double val)
+	{
+		if (R_FINITE(val))
+			pLine += sprintf(pLine, "%g", val);
+		else
+			*pLine++ = '.';
+	}
 
-extern "C"
-{
-using namespace SeqArray;
 
-// ========================================================================
-// Convert to VCF4: GDS -> VCF4
-// ========================================================================
+	inline void LineBuf_Append(int val)
+	{
+		LineBuf_NeedSize(32);
+		_Line_Append(val);
+	}
 
-/// double quote text if needed
-COREARRAY_DLL_EXPORT SEXP SEQ_Quote(SEXP text, SEXP dQuote)
-{
-	SEXP NewText, ans;
-	PROTECT(NewText = AS_CHARACTER(text));
-	PROTECT(ans = NEW_CHARACTER(Rf_length(NewText)));
+	inline void LineBuf_Append(double val)
+	{
+		LineBuf_NeedSize(32);
+		_Line_Append(val);
+	}
 
-	for (int i=0; i < Rf_length(NewText); i++)
+	inline void LineBuf_Append(const char *txt)
 	{
-		string tmp = QuoteText(CHAR(STRING_ELT(NewText, i)));
-		if (LOGICAL(dQuote)[0] == TRUE)
+		const size_t n = strlen(txt);
+		LineBuf_NeedSize(n + 16);
+		memcpy(pLine, txt, n);
+		pLine += n;
+	}
+
+	/// write info values
+	inline void INFO_Write(const TVCF_Value &X, size_t n)
+	{
+		size_t i = 0;
+		if (X.Type == VCF_VAL_INT)
 		{
-			if ((tmp[0] != '\"') || (tmp[tmp.size()-1] != '\"'))
+			LineBuf_NeedSize(12*n + 32);
+			for (const int *p = X.pInt; i < n; i++)
 			{
-				tmp.insert(0, "\"");
-				tmp.push_back('\"');
+				if (i > 0) *pLine++ = ',';
+				_Line_Append(*p++);
+			}
+		} else if (X.Type == VCF_VAL_REAL)
+		{
+			LineBuf_NeedSize(12*n + 32);
+			for (const double *p = X.pReal; i < n; i++)
+			{
+				if (i > 0) *pLine++ = ',';
+				_Line_Append(*p++);
+			}
+		} else if (X.Type == VCF_VAL_STR)
+		{
+			for (; i < n; i++)
+			{
+				if (i > 0) *pLine++ = ',';
+				const char *s = X.pStr[i];
+				LineBuf_Append(s ? s : "NA");
 			}
 		}
-		SET_STRING_ELT(ans, i, mkChar(tmp.c_str()));
 	}
 
-	UNPROTECT(2);
-	return ans;
-}
 
+	/// write format values
+	inline void FORMAT_Write(const TVCF_Value &X, size_t n, size_t Start,
+		size_t Step)
+	{
+		if (X.Type == VCF_VAL_INT || X.Type == VCF_VAL_LGL)
+		{
+			const int *base = X.pInt + Start;
+			const int *p = base + (n - 1)*Step;
+			for (; n > 0; n--, p-=Step)
+				if (*p != NA_INTEGER) break;
+			LineBuf_NeedSize(12*n + 32);
+			p = base;
+			for (size_t i=0; i < n; i++)
+			{
+				if (i > 0) *pLine++ = ',';
+				_Line_Append(*p);
+				p += Step;
+			}
+		} else if (X.Type == VCF_VAL_REAL)
+		{
+			const double *base = X.pReal + Start;
+			const double *p = base + (n - 1)*Step;
+			for (; n > 0; n--, p-=Step)
+				if (R_finite(*p)) break;
+			LineBuf_NeedSize(12*n + 32);
+			p = base;
+			for (size_t i=0; i < n; i++)
+			{
+				if (i > 0) *pLine++ = ',';
+				_Line_Append(*p);
+				p += Step;
+			}
+		} else if (X.Type == VCF_VAL_STR)
+		{
+			for (; n > 0; n--)
+			{
+				const char *s = X.pStr[Start + (n - 1)*Step];
+				if (s && (s[0] != 0)) break;
+			}
+			for (size_t i=0; i < n; i++, Start += Step)
+			{
+				if (i > 0) *pLine++ = ',';
+				const char *s = X.pStr[Start];
+				if (s)
+					LineBuf_Append(s);
+				else
+					*pLine++ = '.';
+			}
+		}
 
+		if (n <= 0) *pLine++ = '.';
+	}
 
 
-// ========================================================================
 
 
-/// initialize
-COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF_Init(SEXP Sel, SEXP Info, SEXP Format,
-	SEXP File, SEXP Verbose)
-{
-	VCF_NumAllele = INTEGER(Sel)[0];
-	VCF_NumSample = INTEGER(Sel)[1];
-	VCF_File = R_GetConnection(File);
 
-	int *pInfo = INTEGER(Info);
-	VCF_INFO_Number.assign(pInfo, pInfo + Rf_length(Info));
+	// ========================================================================
 
-	int *pFmt = INTEGER(Format);
-	VCF_FORMAT_Number.assign(pFmt, pFmt + Rf_length(Format));
+	/// export the first seven columns: chr, pos, id, allele (REF/ALT), qual, filter
+	inline void ExportHead(const TVCF_Variant &X)
+	{
+		// CHROM
+		LineBuf_Append(X.Chr.c_str());
+		*pLine++ = '\t';
 
-	VCF_FORMAT_List.reserve(256);
-	LineBuf_Init(INTEGER(Sel)[2]);
+		// POS
+		LineBuf_Append(X.Pos);
+		*pLine++ = '\t';
 
-	return R_NilValue;
-}
+		// ID
+		if (!X.ID.empty())
+			LineBuf_Append(X.ID.c_str());
+		else
+			*pLine++ = '.';
+		*pLine++ = '\t';
 
-/// finalize
-COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF_Done()
-{
-	LineBuf_Done();
-	return R_NilValue;
-}
+		// allele -- REF/ALT
+		size_t n = pLine - LineBegin;
+		LineBuf_Append(X.Allele.c_str());
+
+		char *s;
+		for (s = LineBegin+n; s < pLine; s++)
+		{
+			if (*s == ',')
+				{ *s = '\t'; break; }
+		}
+		if (s == pLine)
+		{
+			*pLine++ = '\t';
+			*pLine++ = '.';
+		}
+		*pLine++ = '\t';
 
+		// QUAL
+		LineBuf_Append(X.Qual);
+		*pLine++ = '\t';
 
+		// FILTER
+		LineBuf_Append(X.Filter.c_str());
+		*pLine++ = '\t';
+	}
 
-/// convert to VCF4 in general
-COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF(SEXP X)
-{
-	// initialize line pointer
-	LineBuf_InitPtr();
-	// CHROM, POS, ID, REF, ALT, QUAL, FILTER
-	ExportHead(X);
-	// INFO, FORMAT
-	ExportInfoFormat(X, 8);
-	// phase information
-	SEXP phase = VECTOR_ELT(X, 7);
-	C_UInt8 *pAllele = (C_UInt8*)RAW(phase);
-
-	// genotype
-	SEXP geno = VECTOR_ELT(X, 6);
-
-	if (TYPEOF(geno) == RAWSXP)
-	{
-		C_UInt8 *pSamp = (C_UInt8*)RAW(geno);
-		// for-loop of samples
-		for (size_t i=0; i < VCF_NumSample; i++)
+
+	/// export the INFO and FORMAT fields
+	inline void ExportInfoFormat(const TVCF_Variant &X, bool has_geno)
+	{
+		//====  INFO  ====//
+
+		LineBuf_NeedSize(32);
+		size_t cnt_info = INFO_Number.size();
+		size_t n = 0;
+		for (size_t i=0; i < cnt_info; i++)
 		{
-			// add '\t'
-			if (i > 0) *pLine++ = '\t';
-			// genotypes
-			LineBuf_NeedSize(VCF_NumAllele << 4); // NumAllele*16
-			if (VCF_NumAllele == 2)
+			const char *nm = X.InfoName[i].c_str();
+			const TVCF_Value &D = X.Info[i];
+
+			if (D.Type == VCF_VAL_LGL)  // FLAG type
 			{
-				_Line_Append_Geno_Raw(*pSamp++);
-				*pLine++ = (*pAllele++) ? '|' : '/';
-				_Line_Append_Geno_Raw(*pSamp++);
-			} else {
-				for (size_t j=0; j < VCF_NumAllele; j++)
+				if (D.Len > 0 && D.pInt[0] == TRUE)
 				{
-					if (j > 0)
-						*pLine++ = (*pAllele++) ? '|' : '/';
-					_Line_Append_Geno_Raw(*pSamp++);
+					if (n > 0) *pLine++ = ';';
+					LineBuf_Append(nm);
+					n ++;
 				}
-			}
-			// annotation
-			vector<SEXP>::iterator p;
-			for (p=VCF_FORMAT_List.begin(); p != VCF_FORMAT_List.end(); p++)
-			{
-				*pLine++ = ':';
-				size_t n = Rf_length(*p) / VCF_NumSample;
-				FORMAT_Write(*p, n, i, VCF_NumSample);
-			}
-		}
-	} else {
-		int *pSamp = INTEGER(geno);
-		// for-loop of samples
-		for (size_t i=0; i < VCF_NumSample; i++)
-		{
-			// add '\t'
-			if (i > 0) *pLine++ = '\t';
-			// genotypes
-			LineBuf_NeedSize(VCF_NumAllele << 4); // NumAllele*16
-			if (VCF_NumAllele == 2)
-			{
-				_Line_Append_Geno(*pSamp++);
-				*pLine++ = (*pAllele++) ? '|' : '/';
-				_Line_Append_Geno(*pSamp++);
 			} else {
-				for (size_t j=0; j < VCF_NumAllele; j++)
+				int m = INFO_GetNum(D, INFO_Number[i]);
+				if (m > 0)
 				{
-					if (j > 0)
-						*pLine++ = (*pAllele++) ? '|' : '/';
-					_Line_Append_Geno(*pSamp++);
+					if (n > 0) *pLine++ = ';';
+					LineBuf_Append(nm);
+					*pLine++ = '=';
+					INFO_Write(D, m);
+					n ++;
 				}
 			}
-			// annotation
-			vector<SEXP>::iterator p;
-			for (p=VCF_FORMAT_List.begin(); p != VCF_FORMAT_List.end(); p++)
+		}
+
+		if (n <= 0) *pLine++ = '.';
+		*pLine++ = '\t';
+
+		//====  FORMAT  ====//
+
+		FORMAT_List.clear();
+		size_t cnt_fmt = FORMAT_Number.size();
+
+		LineBuf_NeedSize(32);
+		if (has_geno)
+		{
+			pLine[0] = 'G'; pLine[1] = 'T';
+			pLine += 2;
+		} else if (cnt_fmt <= 0)
+		{
+			pLine[0] = '.';
+			pLine ++;
+		}
+
+		for (size_t i=0; i < cnt_fmt; i++)
+		{
+			const TVCF_Value &D = X.Fmt[i];
+			if (D.Type != VCF_VAL_NULL)
 			{
-				*pLine++ = ':';
-				size_t n = Rf_length(*p) / VCF_NumSample;
-				FORMAT_Write(*p, n, i, VCF_NumSample);
+				if (i > 0 || has_geno)
+					*pLine++ = ':';
+				LineBuf_Append(X.FmtName[i].c_str());
+				FORMAT_List.push_back(&D);
 			}
 		}
+		*pLine++ = '\t';
 	}
+};
 
-	*pLine++ = '\n';
 
-	// output
-	if (VCF_File->text)
-	{
-		*pLine = 0;
-		put_text("%s", LineBegin);
-	} else {
-		size_t size = pLine - LineBegin;
-		size_t n = R_WriteConnection(VCF_File, LineBegin, size);
-		if (size != n)
-			throw ErrSeqArray("writing error.");
-	}
 
-	return R_NilValue;
-}
+// ========================================================================
+// BGZF-compressed output
 
+static const size_t BGZF_MAX_BLOCK = 65536;  ///< the maximum size of a BGZF block
+static const size_t BGZF_MAX_INPUT = 0xFF00; ///< the maximum input size of a BGZF block, as bgzip
 
+/// the header of a BGZF block, the block size is set at [16..17]
+static const C_UInt8 BGZF_HEADER[18] = {
+	31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 0, 0
+};
 
-// --------------------------------------------------------------
+/// the empty block at the end of a BGZF file
+static const C_UInt8 BGZF_EOF[28] = {
+	31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 27, 0,
+	3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
 
-/// convert to VCF4, diploid without FORMAT variables
-COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF_Di_WrtFmt(SEXP X)
+inline static void set_u32(C_UInt8 *p, C_UInt32 v)
+{
+	p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF;
+	p[2] = (v >> 16) & 0xFF; p[3] = v >> 24;
+}
+
+
+/// a BGZF file for writing, the text is compressed in blocks of 0xFF00 bytes
+///   by Write(), or by multiple threads via Compress() and then WriteBlocks()
+class COREARRAY_DLL_LOCAL CBGZF_Writer
 {
-	// initialize line pointer
-	LineBuf_InitPtr();
-	// CHROM, POS, ID, REF, ALT, QUAL, FILTER
-	ExportHead(X);
-	// INFO, FORMAT
-	ExportInfoFormat(X, 8);
-	// phase information
-	SEXP phase = VECTOR_ELT(X, 7);
-	C_UInt8 *pAllele = (C_UInt8*)RAW(phase);
-
-	// for-loop, genotypes
-	size_t n = VCF_NumSample;
-	size_t offset = 0;
-
-	// genotype
-	SEXP geno = VECTOR_ELT(X, 6);
-
-	if (TYPEOF(geno) == RAWSXP)
-	{
-		C_UInt8 *pSamp = (C_UInt8*)RAW(geno);
-
-	#ifdef COREARRAY_SIMD_SSE2
-
-		// need buffer
-		LineBuf_NeedSize(n*4 + 64);
-		// 32-byte alignment
-		offset = (size_t)pLine & 0x1F;
-		if (offset > 0)
-		{
-			offset = 32 - offset;
-			memmove(LineBegin+offset, LineBegin, pLine-LineBegin);
-			pLine += offset;
-		}
-
-		static const __m128i char_unphased = _mm_set1_epi8('/');
-		static const __m128i char_phased = _mm_set1_epi8('|');
-		static const __m128i char_tab = _mm_set1_epi8('\t');
-
-	#ifdef COREARRAY_SIMD_AVX2
-		static const __m256i ten = _mm256_set1_epi8(10);
-		static const __m256i na  = _mm256_set1_epi8(0xFF);
-		static const __m256i char_zero = _mm256_set1_epi8('0');
-		static const __m256i char_na = _mm256_set1_epi8('.');
-
-		for (; n >= 16; n-=16)
-		{
-			__m256i v1 = MM_LOADU_256(pSamp);
-			__m256i m1 = _mm256_cmpeq_epi8(v1, na);
-			if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(ten, _mm256_min_epu8(
-				_mm256_andnot_si256(m1, v1), ten)))) break;
-			pSamp += 32;
-
-			v1 = _mm256_add_epi8(v1, char_zero);
-			v1 = MM_BLEND_256(char_na, v1, m1);
-
-			__m128i v3 = MM_LOADU_128(pAllele);
-			pAllele += 16;
-			__m128i m = _mm_cmpeq_epi8(v3, _mm_setzero_si128());
-			v3 = MM_BLEND_128(char_unphased, char_phased, m);
-			__m256i phase = MM_SET_M128(_mm_unpackhi_epi8(v3, char_tab),
-				_mm_unpacklo_epi8(v3, char_tab));
-
-			__m256i w1 = _mm256_unpacklo_epi8(v1, phase);
-			__m256i w2 = _mm256_unpackhi_epi8(v1, phase);
-			_mm256_store_si256((__m256i *)pLine,
-				_mm256_permute2x128_si256(w1, w2, 0x20));
-			_mm256_store_si256((__m256i *)(pLine+32),
-				_mm256_permute2x128_si256(w1, w2, 0x31));
-			pLine += 64;
-		}
-	#else
-		static const __m128i ten = _mm_set1_epi8(10);
-		static const __m128i na  = _mm_set1_epi8(0xFF);
-		static const __m128i char_zero = _mm_set1_epi8('0');
-		static const __m128i char_na = _mm_set1_epi8('.');
-
-		for (; n >= 16; n-=16)
-		{
-			__m128i v1 = MM_LOADU_128(pSamp);
-			__m128i m1 = _mm_cmpeq_epi8(v1, na);
-			if (_mm_movemask_epi8(_mm_cmpeq_epi8(ten, _mm_min_epu8(
-				_mm_andnot_si128(m1, v1), ten)))) break;
-
-			__m128i v2 = MM_LOADU_128((pSamp+16));
-			__m128i m2 = _mm_cmpeq_epi8(v2, na);
-			if (_mm_movemask_epi8(_mm_cmpeq_epi8(ten, _mm_min_epu8(
-				_mm_andnot_si128(m2, v2), ten)))) break;
-			pSamp += 32;
-
-			v1 = _mm_add_epi8(v1, char_zero);
-			v1 = MM_BLEND_128(char_na, v1, m1);
-			v2 = _mm_add_epi8(v2, char_zero);
-			v2 = MM_BLEND_128(char_na, v2, m2);
-
-			__m128i v3 = MM_LOADU_128(pAllele);
-			pAllele += 16;
-			__m128i m = _mm_cmpeq_epi8(v3, _mm_setzero_si128());
-			v3 = MM_BLEND_128(char_unphased, char_phased, m);
-
-			__m128i p1 = _mm_unpacklo_epi8(v3, char_tab);
-			__m128i p2 = _mm_unpackhi_epi8(v3, char_tab);
-
-			_mm_store_si128((__m128i *)pLine, _mm_unpacklo_epi8(v1, p1));
-			_mm_store_si128((__m128i *)(pLine+16), _mm_unpackhi_epi8(v1, p1));
-			_mm_store_si128((__m128i *)(pLine+32), _mm_unpacklo_epi8(v2, p2));
-			_mm_store_si128((__m128i *)(pLine+48), _mm_unpackhi_epi8(v2, p2));
-			pLine += 64;
+public:
+	/// constructor
+	CBGZF_Writer(const char *fn)
+	{
+		File = fopen(fn, "wb");
+		if (!File)
+			throw ErrSeqArray("Cannot create the file '%s'.", fn);
+		Buffer.reserve(BGZF_MAX_INPUT);
+	}
+	/// destructor
+	~CBGZF_Writer()
+	{
+		if (File) fclose(File);
+	}
+
+	/// write the text, the last partial block is kept in the buffer
+	void Write(const void *ptr, size_t size)
+	{
+		const char *p = (const char*)ptr;
+		while (size > 0)
+		{
+			size_t n = BGZF_MAX_INPUT - Buffer.size();
+			if (n > size) n = size;
+			Buffer.insert(Buffer.end(), p, p + n);
+			p += n; size -= n;
+			if (Buffer.size() >= BGZF_MAX_INPUT) FlushBuffer();
 		}
-	#endif
+	}
 
-	#endif
+	/// write the blocks returned from Compress(), after the buffered text
+	void WriteBlocks(const vector<C_UInt8> &blocks)
+	{
+		FlushBuffer();
+		if (!blocks.empty())
+			WriteFile(&blocks[0], blocks.size());
+	}
 
-		// tail
-		for (; n > 0; n--)
+	/// write the buffered text and the end-of-file block, and close the file
+	void Close()
+	{
+		if (File)
 		{
-			LineBuf_NeedSize(32);
-			_Line_Append_Geno_Raw(*pSamp++);
-			*pLine++ = (*pAllele++) ? '|' : '/';
-			_Line_Append_Geno_Raw(*pSamp++);
-			*pLine++ = '\t';
+			FlushBuffer();
+			WriteFile(BGZF_EOF, sizeof(BGZF_EOF));
+			int rv = fclose(File);
+			File = NULL;
+			if (rv != 0) throw ErrSeqArray("writing error.");
 		}
-	} else {
-		// integer vector for genotypes
-		int *pSamp = INTEGER(geno);
-		for (; n > 0; n--)
+	}
+
+	/// append the BGZF blocks of the text to 'out', thread-safe
+	static void Compress(const char *p, size_t size, vector<C_UInt8> &out)
+	{
+		z_stream zs;
+		memset(&zs, 0, sizeof(zs));
+		if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+				Z_DEFAULT_STRATEGY) != Z_OK)
+			throw ErrSeqArray("deflateInit2() fails.");
+		while (size > 0)
 		{
-			LineBuf_NeedSize(32);
-			_Line_Append_Geno(*pSamp++);
-			*pLine++ = (*pAllele++) ? '|' : '/';
-			_Line_Append_Geno(*pSamp++);
-			*pLine++ = '\t';
+			const size_t n = (size < BGZF_MAX_INPUT) ? size : BGZF_MAX_INPUT;
+			const size_t st = out.size();
+			out.resize(st + BGZF_MAX_BLOCK);
+			C_UInt8 *h = &out[st];
+			memcpy(h, BGZF_HEADER, sizeof(BGZF_HEADER));
+			// raw deflate, 0xFF00 bytes always fit in a block
+			zs.next_in = (Bytef*)p;
+			zs.avail_in = n;
+			zs.next_out = h + sizeof(BGZF_HEADER);
+			zs.avail_out = BGZF_MAX_BLOCK - sizeof(BGZF_HEADER) - 8;
+			if (deflate(&zs, Z_FINISH) != Z_STREAM_END)
+			{
+				deflateEnd(&zs);
+				throw ErrSeqArray("deflate() fails.");
+			}
+			const size_t bsize = sizeof(BGZF_HEADER) + zs.total_out + 8;
+			h[16] = (bsize - 1) & 0xFF; h[17] = (bsize - 1) >> 8;
+			C_UInt8 *t = h + sizeof(BGZF_HEADER) + zs.total_out;
+			set_u32(t, crc32(crc32(0L, Z_NULL, 0), (const Bytef*)p, n));
+			set_u32(t + 4, n);
+			out.resize(st + bsize);
+			deflateReset(&zs);
+			p += n; size -= n;
 		}
+		deflateEnd(&zs);
 	}
 
-	pLine--; *pLine++ = '\n';
+private:
+	FILE *File;            ///< the file handle
+	vector<char> Buffer;   ///< the text not compressed yet
+	vector<C_UInt8> Zip;   ///< the compressed block of Buffer
 
-	// output
-	if (VCF_File->text)
+	void FlushBuffer()
 	{
-		*pLine = 0;
-		put_text("%s", LineBegin+offset);
-	} else {
-		size_t size = pLine - LineBegin - offset;
-		size_t n = R_WriteConnection(VCF_File, LineBegin + offset, size);
-		if (size != n)
+		if (!Buffer.empty())
+		{
+			Zip.clear();
+			Compress(&Buffer[0], Buffer.size(), Zip);
+			WriteFile(&Zip[0], Zip.size());
+			Buffer.clear();
+		}
+	}
+
+	void WriteFile(const void *p, size_t n)
+	{
+		if (fwrite(p, 1, n, File) != n)
 			throw ErrSeqArray("writing error.");
 	}
+};
+
+
+static void bgzf_file_close(Rconnection con)
+{
+	CBGZF_Writer *s = (CBGZF_Writer*)con->xprivate;
+	char msg[1024] = { 0 };
+	if (s)
+	{
+		try {
+			s->Close();
+		} catch (std::exception &E) {
+			strncpy(msg, E.what(), sizeof(msg)-1);
+		}
+		delete s;
+		con->xprivate = NULL;
+	}
+	con->isopen = FALSE;
+	// raise the writing error after the file is closed
+	if (msg[0]) error("%s", msg);
+}
 
-	return R_NilValue;
+static size_t bgzf_file_write(const void *ptr, size_t size, size_t nitems,
+	Rconnection con)
+{
+	CBGZF_Writer *s = (CBGZF_Writer*)con->xprivate;
+	if (!s || size <= 0) return 0;
+	try {
+		s->Write(ptr, size*nitems);
+	} catch (...) {
+		return 0;
+	}
+	return nitems;
 }
 
 
 
-// --------------------------------------------------------------
+// ========================================================================
+// Writing VCF lines
 
-/// convert to haploid VCF4
-COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF_Haploid(SEXP X)
+/// the maximum number of samples * variants in a chunk exported in parallel
+static const size_t VCF_EXPORT_CHUNK_CELL = 1 << 24;
+/// the maximum number of variants in a chunk exported in parallel
+static const size_t VCF_EXPORT_CHUNK_LINE = 256;
+/// the number of text blocks per thread in a chunk
+static const int VCF_EXPORT_BLOCK_PER_THREAD = 4;
+
+/// the context of exporting a VCF file, used in SEQ_ToVCF*
+class COREARRAY_DLL_LOCAL CVCF_Writer
 {
-	// initialize line pointer
-	LineBuf_InitPtr();
-	// CHROM, POS, ID, REF, ALT, QUAL, FILTER
-	ExportHead(X);
-	// INFO, FORMAT
-	ExportInfoFormat(X, 7);
+public:
+	/// constructor
+	CVCF_Writer(SEXP Sel, SEXP Info, SEXP Format, SEXP file, int num_thread):
+		Line(Sel, Info, Format)
+	{
+		File = R_GetConnection(file);
+		ZipFile = (File->write == &bgzf_file_write) ?
+			(CBGZF_Writer*)File->xprivate : NULL;
+		NumInfo = Rf_length(Info);
+		NumFormat = Rf_length(Format);
+		NumThread = (num_thread > 1) ? num_thread : 1;
+		NumQueue = 0;
+		HasError = false;
+		BlockSt = PendingSt = NumPending = 0;
+		if (NumThread > 1)
+		{
+			// the number of variants in a chunk
+			size_t nsamp = INTEGER(Sel)[1];
+			size_t n = VCF_EXPORT_CHUNK_CELL / (nsamp > 0 ? nsamp : 1);
+			if (n > VCF_EXPORT_CHUNK_LINE) n = VCF_EXPORT_CHUNK_LINE;
+			if (n < (size_t)NumThread * 2) n = NumThread * 2;
+			Queue.resize(n);
+			QueueType.resize(n);
+			// the text blocks of two chunks, one is formatted while the
+			//   other is written
+			const int nb = NumThread * VCF_EXPORT_BLOCK_PER_THREAD;
+			Blocks.resize(2*nb);
+			for (int i=0; i < 2*nb; i++)
+				Blocks[i] = new TBlock(Sel, Info, Format);
+		}
+	}
 
-	// genotype
-	SEXP geno = VECTOR_ELT(X, 6);
+	/// destructor
+	~CVCF_Writer()
+	{
+		for (size_t i=0; i < Blocks.size(); i++)
+			delete Blocks[i];
+	}
 
-	if (TYPEOF(geno) == RAWSXP)
+	/// format a variant, written immediately if serial, otherwise it is
+	///   queued and formatted with the other variants in the chunk
+	void Push(int type, SEXP X)
 	{
-		C_UInt8 *pSamp = (C_UInt8*)RAW(geno);
-		// for-loop of samples
-		for (size_t i=0; i < VCF_NumSample; i++)
+		if (NumThread <= 1)
 		{
-			// add '\t'
-			if (i > 0) *pLine++ = '\t';
-			// genotypes
-			LineBuf_NeedSize(VCF_NumAllele << 3); // NumAllele*8
-			_Line_Append_Geno_Raw(*pSamp++);
-			// annotation
-			vector<SEXP>::iterator p;
-			for (p=VCF_FORMAT_List.begin(); p != VCF_FORMAT_List.end(); p++)
+			Var.Set(type, X, NumInfo, NumFormat, false);
+			Line.Clear();
+			Line.Format(type, Var);
+			WriteText(Line);
+		} else {
+			if (HasError)
+				throw ErrSeqArray("the VCF export has failed.");
+			// copy the variant data, since the buffers are reused in seqApply()
+			Queue[NumQueue].Set(type, X, NumInfo, NumFormat, true);
+			QueueType[NumQueue] = type;
+			if (++NumQueue >= (int)Queue.size()) Flush();
+		}
+	}
+
+	/// write all remaining lines
+	void Finish()
+	{
+		if (!HasError && NumQueue > 0) Flush();
+		if (!HasError) WritePending();
+	}
+
+private:
+	/// a text block formatted by a thread
+	struct TBlock
+	{
+		CVCF_Formatter Fmt;     ///< the VCF lines
+		vector<C_UInt8> Zip;    ///< the BGZF blocks of the lines
+		string ErrMsg;          ///< the error message
+		TBlock(SEXP Sel, SEXP Info, SEXP Format): Fmt(Sel, Info, Format) { }
+	};
+
+	CVCF_Formatter Line;       ///< the line buffer used in serial
+	TVCF_Variant Var;          ///< the variant data used in serial
+	Rconnection File;          ///< R connection object
+	CBGZF_Writer *ZipFile;     ///< the BGZF file of the connection, or NULL
+	size_t NumInfo;            ///< the number of INFO variables
+	size_t NumFormat;          ///< the number of FORMAT variables
+	int NumThread;             ///< the number of threads
+	vector<TVCF_Variant> Queue;  ///< the queued variants
+	vector<C_UInt8> QueueType; ///< the line types of queued variants
+	int NumQueue;              ///< the number of queued variants
+	vector<TBlock*> Blocks;    ///< the text blocks of two chunks
+	int BlockSt;               ///< the first block of the next chunk
+	int PendingSt;             ///< the first block not written yet
+	int NumPending;            ///< the number of BGZF blocks not written yet
+	bool HasError;             ///< true if writing or formatting fails
+
+	/// format the queued variants in parallel without calling the R API;
+	///   the BGZF blocks of the previous chunk are written by the main thread
+	///   while the other threads format the current chunk, otherwise the
+	///   lines are written in order by the main thread after formatting,
+	///   since R connections are not thread-safe
+	void Flush()
+	{
+		const int nb = Blocks.size() / 2;
+		const int num_line = NumQueue;
+		const int num_block = (num_line < nb) ? num_line : nb;
+		const bool compress = (ZipFile != NULL);
+		TBlock **pBlock = &Blocks[BlockSt];
+		NumQueue = 0;
+		bool write_fail = false;
+		string write_error;
+
+	#ifdef _OPENMP
+		#pragma omp parallel num_threads(NumThread)
+	#endif
+		{
+			// write the previous chunk (C++ file I/O only)
+		#ifdef _OPENMP
+			#pragma omp master
+		#endif
 			{
-				*pLine++ = ':';
-				size_t n = Rf_length(*p) / VCF_NumSample;
-				FORMAT_Write(*p, n, i, VCF_NumSample);
+				try {
+					WritePending();
+				}
+				catch (std::exception &E) {
+					write_fail = true;
+					write_error = E.what();
+				}
 			}
+
+			// format the variants in contiguous blocks
+		#ifdef _OPENMP
+			#pragma omp for schedule(dynamic) nowait
+		#endif
+			for (int b=0; b < num_block; b++)
+				FormatBlock(*pBlock[b], b, num_block, num_line, compress);
 		}
-	} else {
-		int *pSamp = INTEGER(geno);
-		// for-loop of samples
-		for (size_t i=0; i < VCF_NumSample; i++)
+
+		if (write_fail)
+			{ HasError = true; throw ErrSeqArray(write_error); }
+		for (int b=0; b < num_block; b++)
 		{
-			// add '\t'
-			if (i > 0) *pLine++ = '\t';
-			// genotypes
-			LineBuf_NeedSize(VCF_NumAllele << 3); // NumAllele*8
-			_Line_Append_Geno(*pSamp++);
-			// annotation
-			vector<SEXP>::iterator p;
-			for (p=VCF_FORMAT_List.begin(); p != VCF_FORMAT_List.end(); p++)
+			if (!pBlock[b]->ErrMsg.empty())
+				{ HasError = true; throw ErrSeqArray(pBlock[b]->ErrMsg); }
+		}
+
+		if (compress)
+		{
+			// written in the next round or by Finish()
+			PendingSt = BlockSt; NumPending = num_block;
+			BlockSt = nb - BlockSt;
+		} else {
+			// write in the main thread
+			for (int b=0; b < num_block; b++)
 			{
-				*pLine++ = ':';
-				size_t n = Rf_length(*p) / VCF_NumSample;
-				FORMAT_Write(*p, n, i, VCF_NumSample);
+				try {
+					WriteText(pBlock[b]->Fmt);
+				} catch (...) {
+					HasError = true;
+					throw;
+				}
 			}
 		}
 	}
 
-	*pLine++ = '\n';
+	/// format the b-th block of the queued variants, thread-safe
+	void FormatBlock(TBlock &B, int b, int num_block, int num_line,
+		bool compress)
+	{
+		B.ErrMsg.clear();
+		try {
+			B.Fmt.Clear();
+			const int st = (C_Int64)num_line * b / num_block;
+			const int ed = (C_Int64)num_line * (b+1) / num_block;
+			for (int i=st; i < ed; i++)
+				B.Fmt.Format(QueueType[i], Queue[i]);
+			if (compress)
+			{
+				B.Zip.clear();
+				CBGZF_Writer::Compress(B.Fmt.Text(), B.Fmt.Size(), B.Zip);
+			}
+		}
+		catch (std::exception &E) {
+			B.ErrMsg = E.what();
+		}
+		catch (...) {
+			B.ErrMsg = "unknown error!";
+		}
+	}
 
-	// output
-	if (VCF_File->text)
+	/// write the BGZF blocks of the previous chunk in order
+	void WritePending()
 	{
-		*pLine = 0;
-		put_text("%s", LineBegin);
-	} else {
-		size_t size = pLine - LineBegin;
-		size_t n = R_WriteConnection(VCF_File, LineBegin, size);
-		if (size != n)
-			throw ErrSeqArray("writing error.");
+		const int n = NumPending;
+		NumPending = 0;
+		for (int b=0; b < n; b++)
+			ZipFile->WriteBlocks(Blocks[PendingSt + b]->Zip);
+	}
+
+	/// write the text to the connection
+	inline void WriteText(CVCF_Formatter &F)
+	{
+		if (File->text)
+		{
+			put_text("%s", F.CString());
+		} else {
+			size_t size = F.Size();
+			size_t n = R_WriteConnection(File, (void*)F.Text(), size);
+			if (size != n)
+				throw ErrSeqArray("writing error.");
+		}
+	}
+
+	inline void put_text(const char *fmt, ...)
+	{
+		va_list args;
+		va_start(args, fmt);
+		(*File->vfprintf)(File, fmt, args);
+		va_end(args);
 	}
+};
 
-	return R_NilValue;
 }
 
 
+extern "C"
+{
+using namespace SeqArray;
 
-// --------------------------------------------------------------
+// ========================================================================
+// Convert to VCF4: GDS -> VCF4
+// ========================================================================
 
-/// convert to VCF4 without genotypes
-COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF_NoGeno(SEXP X)
+/// double quote text if needed
+COREARRAY_DLL_EXPORT SEXP SEQ_Quote(SEXP text, SEXP dQuote)
 {
-	// initialize line pointer
-	LineBuf_InitPtr();
-	// CHROM, POS, ID, REF, ALT, QUAL, FILTER
-	ExportHead(X);
-	// INFO, FORMAT
-	ExportInfoFormat(X, 6);
+	SEXP NewText, ans;
+	PROTECT(NewText = AS_CHARACTER(text));
+	PROTECT(ans = NEW_CHARACTER(Rf_length(NewText)));
 
-	// for-loop of samples
-	for (size_t i=0; i < VCF_NumSample; i++)
+	for (int i=0; i < Rf_length(NewText); i++)
 	{
-		// add '\t'
-		if (i > 0) *pLine++ = '\t';
-		// annotation
-		vector<SEXP>::iterator p;
-		vector<SEXP>::iterator st = VCF_FORMAT_List.begin();
-		for (p=st; p != VCF_FORMAT_List.end(); p++)
+		string tmp = QuoteText(CHAR(STRING_ELT(NewText, i)));
+		if (LOGICAL(dQuote)[0] == TRUE)
 		{
-			if (p != st) *pLine++ = ':';
-			size_t n = Rf_length(*p) / VCF_NumSample;
-			FORMAT_Write(*p, n, i, VCF_NumSample);
+			if ((tmp[0] != '\"') || (tmp[tmp.size()-1] != '\"'))
+			{
+				tmp.insert(0, "\"");
+				tmp.push_back('\"');
+			}
 		}
+		SET_STRING_ELT(ans, i, mkChar(tmp.c_str()));
 	}
-	*pLine++ = '\n';
 
-	// output
-	if (VCF_File->text)
-	{
-		*pLine = 0;
-		put_text("%s", LineBegin);
-	} else {
-		size_t size = pLine - LineBegin;
-		size_t n = R_WriteConnection(VCF_File, LineBegin, size);
-		if (size != n)
-			throw ErrSeqArray("writing error.");
-	}
+	UNPROTECT(2);
+	return ans;
+}
+
+
+
+
+// ========================================================================
+
+static void free_vcf_writer(SEXP ref)
+{
+	CVCF_Writer *obj = (CVCF_Writer*)R_ExternalPtrAddr(ref);
+	if (obj) delete obj;
+}
+
+static CVCF_Writer *get_vcf_writer(SEXP ref)
+{
+	CVCF_Writer *obj = (CVCF_Writer*)R_ExternalPtrAddr(ref);
+	if (!obj)
+		throw ErrSeqArray("the VCF export context has been closed.");
+	return obj;
+}
+
 
-	return R_NilValue;
+/// create a BGZF file as a write-only connection
+COREARRAY_DLL_EXPORT SEXP SEQ_BGZF_Create(SEXP File)
+{
+	const char *fn = CHAR(STRING_ELT(File, 0));
+	COREARRAY_TRY
+
+		Rconnection con;
+		rv_ans = PROTECT(R_new_custom_connection(fn, "wb", "bgzf_file", &con));
+		con->xprivate = new CBGZF_Writer(R_ExpandFileName(fn));
+		con->isopen = TRUE;
+		con->canwrite = TRUE;
+		con->canread = FALSE;
+		con->text = FALSE;
+		con->close = &bgzf_file_close;
+		con->write = &bgzf_file_write;
+		UNPROTECT(1);
+
+	COREARRAY_CATCH
+}
+
+
+/// initialize, return the context of exporting
+COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF_Init(SEXP Sel, SEXP Info, SEXP Format,
+	SEXP File, SEXP Verbose, SEXP NumThread)
+{
+	COREARRAY_TRY
+		CVCF_Writer *obj = new CVCF_Writer(Sel, Info, Format, File,
+			Rf_asInteger(NumThread));
+		rv_ans = PROTECT(R_MakeExternalPtr(obj, R_NilValue, R_NilValue));
+		R_RegisterCFinalizerEx(rv_ans, free_vcf_writer, TRUE);
+		Rf_setAttrib(rv_ans, R_ClassSymbol, mkString("SeqClass_VCFWriter"));
+		UNPROTECT(1);
+	COREARRAY_CATCH
+}
+
+/// finalize, write the remaining lines
+COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF_Done(SEXP ctx)
+{
+	COREARRAY_TRY
+		CVCF_Writer *obj = (CVCF_Writer*)R_ExternalPtrAddr(ctx);
+		if (obj)
+		{
+			// the context is closed even if writing fails
+			R_ClearExternalPtr(ctx);
+			try {
+				obj->Finish();
+			} catch (...) {
+				delete obj;
+				throw;
+			}
+			delete obj;
+		}
+	COREARRAY_CATCH
+}
+
+
+/// convert to VCF4 in general
+COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF(SEXP X, SEXP ctx)
+{
+	COREARRAY_TRY
+		get_vcf_writer(ctx)->Push(VCF_LINE_GENERAL, X);
+	COREARRAY_CATCH
+}
+
+/// convert to VCF4, diploid without FORMAT variables
+COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF_Di_WrtFmt(SEXP X, SEXP ctx)
+{
+	COREARRAY_TRY
+		get_vcf_writer(ctx)->Push(VCF_LINE_DI_WRTFMT, X);
+	COREARRAY_CATCH
+}
+
+/// convert to haploid VCF4
+COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF_Haploid(SEXP X, SEXP ctx)
+{
+	COREARRAY_TRY
+		get_vcf_writer(ctx)->Push(VCF_LINE_HAPLOID, X);
+	COREARRAY_CATCH
+}
+
+/// convert to VCF4 without genotypes
+COREARRAY_DLL_EXPORT SEXP SEQ_ToVCF_NoGeno(SEXP X, SEXP ctx)
+{
+	COREARRAY_TRY
+		get_vcf_writer(ctx)->Push(VCF_LINE_NOGENO, X);
+	COREARRAY_CATCH
 }
 
 } // extern "C"
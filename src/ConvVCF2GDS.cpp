@@ -21,9 +21,11 @@
 
 #include "Index.h"
 #include "vectorization.h"
+#include <cstdio>
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <zlib.h>
 
 
 // 1: load format field except GT
@@ -68,270 +70,314 @@ static inline void end_timing()
 #error "No support of R_CONNECTIONS_VERSION"
 #endif
 
-static Rconnection VCF_File = NULL;  ///< R connection object
-
-static vector<char> VCF_Buffer;  ///< reading buffer
-static char *VCF_Buffer_Ptr;     ///< the current pointer to reading buffer
-static char *VCF_Buffer_EndPtr;  ///< the end pointer to reading buffer
 static const size_t VCF_BUFFER_SIZE = 65536;  ///< reading buffer size
-static const size_t VCF_BUFFER_SIZE_PLUS = 32;  ///< additional buffer is needed since *VCF_Buffer_EndPtr might be revised
+static const size_t VCF_BUFFER_SIZE_PLUS = 32;  ///< additional buffer is needed since *Buffer_EndPtr might be revised
 
-/// initialize
-inline static void Init_VCF_Buffer(SEXP File)
-{
-	VCF_File = R_GetConnection(File);
-	VCF_File->EOF_signalled = FALSE;
-	VCF_Buffer.resize(VCF_BUFFER_SIZE + VCF_BUFFER_SIZE_PLUS);
-	VCF_Buffer_EndPtr = VCF_Buffer_Ptr = &VCF_Buffer[0];
-}
 
-/// finalize
-inline static void Done_VCF_Buffer()
+/// the reading context of a VCF file, one object per conversion
+class COREARRAY_DLL_LOCAL CVCF_Reader
 {
-	VCF_File = NULL;
-	VCF_Buffer.clear();
-	vector<char>().swap(VCF_Buffer);
-	VCF_Buffer_Ptr = VCF_Buffer_EndPtr = NULL;
-}
+public:
+	char *Text_pBegin;  ///< the starting pointer for the text buffer
+	char *Text_pEnd;    ///< the end pointer for the text buffer
+	char *save_pBegin, *save_pEnd;  ///< save Text_pBegin, Text_pEnd
+	C_Int64 LineNum;    ///< the current line number
+	int ColumnNum;      ///< the current column number
 
+	CVCF_Reader()
+	{
+		File = NULL;
+		Buffer_Ptr = Buffer_EndPtr = NULL;
+		Text_pBegin = Text_pEnd = save_pBegin = save_pEnd = NULL;
+		Text_Size = 0;
+		LineNum = NextLineNum = 0;
+		ColumnNum = NextColumnNum = 0;
+	}
 
-/// read file buffer
-inline static void Read_VCF_Buffer()
-{
-	VCF_Buffer_Ptr = &VCF_Buffer[0];
-	size_t n = 0;
-	size_t unread_len = VCF_File->buff_stored_len - VCF_File->buff_pos;
-	if (unread_len > 0)
+	/// initialize
+	void Init(SEXP conn)
 	{
-		if (unread_len > VCF_BUFFER_SIZE) unread_len = VCF_BUFFER_SIZE;
-		memcpy(VCF_Buffer_Ptr, VCF_File->buff + VCF_File->buff_pos, unread_len);
-		VCF_Buffer_Ptr += unread_len;
-		VCF_File->buff_pos += unread_len;
-		n += unread_len;
+		File = R_GetConnection(conn);
+		File->EOF_signalled = FALSE;
+		Buffer.resize(VCF_BUFFER_SIZE + VCF_BUFFER_SIZE_PLUS);
+		Buffer_EndPtr = Buffer_Ptr = &Buffer[0];
 	}
-	if (n < VCF_BUFFER_SIZE)
+
+	/// finalize
+	void Done()
 	{
-		size_t m = R_ReadConnection(VCF_File, VCF_Buffer_Ptr, VCF_BUFFER_SIZE-n);
-		n += m;
+		File = NULL;
+		Buffer.clear();
+		vector<char>().swap(Buffer);
+		Buffer_Ptr = Buffer_EndPtr = NULL;
 	}
-	VCF_Buffer_Ptr = &VCF_Buffer[0];
-	VCF_Buffer_EndPtr = VCF_Buffer_Ptr + n;
-	if (n <= 0)
+
+	/// test EOF
+	inline bool IsEOF()
 	{
-		if (VCF_File->EOF_signalled)
-			throw ErrSeqArray("read text error.");
-		VCF_File->EOF_signalled = TRUE;
+		if (File->EOF_signalled) return true;
+		if (Buffer_Ptr >= Buffer_EndPtr)
+			ReadBuffer();
+		return (Buffer_Ptr >= Buffer_EndPtr);
 	}
-}
 
-/// test EOF
-inline static bool VCF_EOF()
-{
-	if (VCF_File->EOF_signalled) return true;
-	if (VCF_Buffer_Ptr >= VCF_Buffer_EndPtr)
-		Read_VCF_Buffer();
-	return (VCF_Buffer_Ptr >= VCF_Buffer_EndPtr);
-}
+	/// initialize text buffer
+	void InitText()
+	{
+		Text_Buffer.resize(1024);
+		Text_Size = 1024;
+		Text_pBegin = Text_pEnd = &Text_Buffer[0];
+		save_pBegin = save_pEnd = Text_pBegin;
+		LineNum = ColumnNum = 0;
+		NextLineNum = NextColumnNum = 1;
+	}
 
+	/// finalize text buffer
+	void DoneText()
+	{
+		Text_Buffer.clear();
+		vector<char>().swap(Text_Buffer);
+		Text_pBegin = Text_pEnd = NULL;
+		save_pBegin = save_pEnd = NULL;
+	}
 
+	/// get a string with a seperator '\t', which is saved in Text_Buffer
+	void GetText(int last_column)
+	{
+		if (File->EOF_signalled)
+			throw ErrSeqArray("it is the end of file.");
 
-// ===========================================================
+		ColumnNum = NextColumnNum;
+		LineNum = NextLineNum;
 
-static vector<char> Text_Buffer;  ///< text buffer
-static char *Text_pBegin;  ///< the starting pointer for the text buffer
-static char *Text_pEnd;    ///< the end pointer for the text buffer
-static size_t Text_Size;     ///< the buffer size in Text_Buffer
-static char *save_pBegin, *save_pEnd;  ///< save Text_pBegin, Text_pEnd
+		Text_pEnd = Text_pBegin = &Text_Buffer[0];
+		int ch = -1;
+		bool flag = true;
 
-static C_Int64 VCF_LineNum;  ///< the current line number
-static int VCF_ColumnNum;    ///< the current column number
-static C_Int64 VCF_NextLineNum;  ///< the next line number
-static int VCF_NextColumnNum;    ///< the next column number
+		while (true)
+		{
+			char *p = Buffer_Ptr;
+			while (p < Buffer_EndPtr)
+			{
+				ch = *p;
+				if (ch=='\t' || ch=='\n' || ch=='\r')
+					break;
+				p ++;
+			}
 
-static bool VCF_RaiseError;  ///< raise conversion error if true
-static size_t SampleNum;  ///< the total number of samples
+			if (flag && (p < Buffer_EndPtr))
+			{
+				Text_pBegin = Buffer_Ptr;
+				Text_pEnd = p;
+				Buffer_Ptr = p;
+				break;
+			} else
+				flag = false;
 
-/// initialize text buffer
-inline static void InitText()
-{
-	Text_Buffer.resize(1024);
-	Text_Size = 1024;
-	Text_pBegin = Text_pEnd = &Text_Buffer[0];
-	save_pBegin = save_pEnd = Text_pBegin;
-	VCF_LineNum = VCF_ColumnNum = 0;
-	VCF_NextLineNum = VCF_NextColumnNum = 1;
-}
+			// copy to Text_Buffer
+			size_t n = p - Buffer_Ptr;
+			size_t m = Text_pEnd - Text_pBegin;
+			size_t nn = m + n;
+			if (nn > Text_Size)
+			{
+				nn = ((nn / 1024) + 1) * 1024;
+				Text_Buffer.resize(nn + VCF_BUFFER_SIZE_PLUS);
+				Text_Size = nn;
+				Text_pBegin = &Text_Buffer[0];
+				Text_pEnd = Text_pBegin + m;
+			}
+			memcpy(Text_pEnd, Buffer_Ptr, n);
+			Buffer_Ptr += n;
+			Text_pEnd += n;
 
-/// finalize text buffer
-inline static void DoneText()
-{
-	Text_Buffer.clear();
-	vector<char>().swap(Text_Buffer);
-	Text_pBegin = Text_pEnd;
-	save_pBegin = save_pEnd = Text_pBegin;
-}
+			if (p < Buffer_EndPtr || File->EOF_signalled)
+				break;
+			else
+				ReadBuffer();
+		}
 
-/// get a string with a seperator '\t', which is saved in _Text_Buffer
-inline static void GetText(int last_column)
-{
-	if (VCF_File->EOF_signalled)
-		throw ErrSeqArray("it is the end of file.");
+		if (ch == '\t')
+		{
+			if (last_column == TRUE)
+				throw ErrSeqArray("more columns than what expected.");
+			NextColumnNum ++;
+			Buffer_Ptr ++;
+		} else {
+			if (last_column == FALSE)
+				throw ErrSeqArray("fewer columns than what expected.");
+			NextColumnNum = 1;
+			NextLineNum ++;
 
-	VCF_ColumnNum = VCF_NextColumnNum;
-	VCF_LineNum = VCF_NextLineNum;
+			// skip '\n' and '\r'
+			if (ch=='\n' || ch=='\r')
+			{
+				do {
+					Buffer_Ptr ++;
+					if (Buffer_Ptr >= Buffer_EndPtr)
+					{
+						if (File->EOF_signalled)
+							break;
+						if (flag)
+						{   // copy to Text_Buffer
+							size_t n = Text_pEnd - Text_pBegin;
+							if (n > Text_Size)
+							{
+								size_t nn = ((n / 1024) + 1) * 1024;
+								Text_Buffer.resize(nn + VCF_BUFFER_SIZE_PLUS);
+								Text_Size = nn;
+							}
+							memcpy(&Text_Buffer[0], Text_pBegin, n);
+							Text_pBegin = &Text_Buffer[0];
+							Text_pEnd = Text_pBegin + n;
+							flag = false;
+						}
+						ReadBuffer();
+					}
+					ch = *Buffer_Ptr;
+				} while (ch=='\n' || ch=='\r');
+			}
+		}
 
-	Text_pEnd = Text_pBegin = &Text_Buffer[0];
-	int ch = -1;
-	bool flag = true;
+		save_pBegin = Text_pBegin;
+		save_pEnd = Text_pEnd;
+	}
 
-	while (true)
+	/// skip the current line
+	void SkipLine()
 	{
-		char *p = VCF_Buffer_Ptr;
-		while (p < VCF_Buffer_EndPtr)
-		{
-			ch = *p;
-			if (ch=='\t' || ch=='\n' || ch=='\r')
-				break;
-			p ++;
-		}
+		ColumnNum = NextColumnNum;
+		LineNum = NextLineNum;
 
-		if (flag && (p < VCF_Buffer_EndPtr))
+		int ch = -1;
+		// search for '\n' or '\r'
+		while (true)
 		{
-			Text_pBegin = VCF_Buffer_Ptr;
-			Text_pEnd = p;
-			VCF_Buffer_Ptr = p;
-			break;
-		} else
-			flag = false;
+			Buffer_Ptr = (char*)vec_char_find_CRLF(Buffer_Ptr,
+				Buffer_EndPtr - Buffer_Ptr);
 
-		// copy to Text_Buffer
-		size_t n = p - VCF_Buffer_Ptr;
-		size_t m = Text_pEnd - Text_pBegin;
-		size_t nn = m + n;
-		if (nn > Text_Size)
-		{
-			nn = ((nn / 1024) + 1) * 1024;
-			Text_Buffer.resize(nn + VCF_BUFFER_SIZE_PLUS);
-			Text_Size = nn;
-			Text_pBegin = &Text_Buffer[0];
-			Text_pEnd = Text_pBegin + m;
+			if (Buffer_Ptr < Buffer_EndPtr)
+			{
+				ch = *Buffer_Ptr;
+				break;
+			} else if (!File->EOF_signalled)
+				ReadBuffer();
+			else
+				break;
 		}
-		memcpy(Text_pEnd, VCF_Buffer_Ptr, n);
-		VCF_Buffer_Ptr += n;
-		Text_pEnd += n;
 
-		if (p < VCF_Buffer_EndPtr || VCF_File->EOF_signalled)
-			break;
-		else
-			Read_VCF_Buffer();
+		// skip '\n' and '\r'
+		SkipCRLF(ch);
+
+		NextColumnNum = 1;
+		NextLineNum ++;
+		save_pBegin = save_pEnd = Text_pBegin;
 	}
 
-	if (ch == '\t')
+	/// append the current line to 'buf' without the line break, return the length
+	size_t ReadLine(vector<char> &buf)
 	{
-		if (last_column == TRUE)
-			throw ErrSeqArray("more columns than what expected.");
-		VCF_NextColumnNum ++;
-		VCF_Buffer_Ptr ++;
-	} else {
-		if (last_column == FALSE)
-			throw ErrSeqArray("fewer columns than what expected.");
-		VCF_NextColumnNum = 1;
-		VCF_NextLineNum ++;
+		ColumnNum = 0;
+		LineNum = NextLineNum;
+		const size_t old_size = buf.size();
 
-		// skip '\n' and '\r'
-		if (ch=='\n' || ch=='\r')
+		int ch = -1;
+		// search for '\n' or '\r'
+		while (true)
 		{
-			do {
-				VCF_Buffer_Ptr ++;
-				if (VCF_Buffer_Ptr >= VCF_Buffer_EndPtr)
-				{
-					if (VCF_File->EOF_signalled)
-						break;
-					if (flag)
-					{   // copy to Text_Buffer
-						size_t n = Text_pEnd - Text_pBegin;
-						if (n > Text_Size)
-						{
-							size_t nn = ((n / 1024) + 1) * 1024;
-							Text_Buffer.resize(nn + VCF_BUFFER_SIZE_PLUS);
-							Text_Size = nn;
-						}
-						memcpy(&Text_Buffer[0], Text_pBegin, n);
-						Text_pBegin = &Text_Buffer[0];
-						Text_pEnd = Text_pBegin + n;
-						flag = false;
-					}
-					Read_VCF_Buffer();
-				}
-				ch = *VCF_Buffer_Ptr;
-			} while (ch=='\n' || ch=='\r');
+			char *p = (char*)vec_char_find_CRLF(Buffer_Ptr,
+				Buffer_EndPtr - Buffer_Ptr);
+			buf.insert(buf.end(), Buffer_Ptr, p);
+			Buffer_Ptr = p;
+
+			if (Buffer_Ptr < Buffer_EndPtr)
+			{
+				ch = *Buffer_Ptr;
+				break;
+			} else if (!File->EOF_signalled)
+				ReadBuffer();
+			else
+				break;
 		}
-	}
 
-	save_pBegin = Text_pBegin;
-	save_pEnd = Text_pEnd;
-}
+		// skip '\n' and '\r'
+		SkipCRLF(ch);
 
-/// skip the current line
-inline static void SkipLine()
-{
-	VCF_ColumnNum = VCF_NextColumnNum;
-	VCF_LineNum = VCF_NextLineNum;
+		NextColumnNum = 1;
+		NextLineNum ++;
+		return buf.size() - old_size;
+	}
 
-	int ch = -1;
-	// search for '\n' or '\r'
-	while (true)
+	/// the line number of the next line
+	inline C_Int64 NextLine() const { return NextLineNum; }
+
+	/// set the position and text used in the error message
+	void SetErrorPos(C_Int64 line, int column, const string &text)
 	{
-		VCF_Buffer_Ptr = (char*)vec_char_find_CRLF(VCF_Buffer_Ptr,
-			VCF_Buffer_EndPtr - VCF_Buffer_Ptr);
+		LineNum = line;
+		ColumnNum = column;
+		Text_Buffer.assign(text.begin(), text.end());
+		Text_Buffer.push_back(0);
+		save_pBegin = &Text_Buffer[0];
+		save_pEnd = save_pBegin + text.size();
+	}
 
-		if (VCF_Buffer_Ptr < VCF_Buffer_EndPtr)
+private:
+	Rconnection File;      ///< R connection object
+	vector<char> Buffer;   ///< reading buffer
+	char *Buffer_Ptr;      ///< the current pointer to reading buffer
+	char *Buffer_EndPtr;   ///< the end pointer to reading buffer
+	vector<char> Text_Buffer;  ///< text buffer
+	size_t Text_Size;      ///< the buffer size in Text_Buffer
+	C_Int64 NextLineNum;   ///< the next line number
+	int NextColumnNum;     ///< the next column number
+
+	/// read file buffer
+	void ReadBuffer()
+	{
+		Buffer_Ptr = &Buffer[0];
+		size_t n = 0;
+		size_t unread_len = File->buff_stored_len - File->buff_pos;
+		if (unread_len > 0)
 		{
-			ch = *VCF_Buffer_Ptr;
-			break;
-		} else if (!VCF_File->EOF_signalled)
-			Read_VCF_Buffer();
-		else
-			break;
+			if (unread_len > VCF_BUFFER_SIZE) unread_len = VCF_BUFFER_SIZE;
+			memcpy(Buffer_Ptr, File->buff + File->buff_pos, unread_len);
+			Buffer_Ptr += unread_len;
+			File->buff_pos += unread_len;
+			n += unread_len;
+		}
+		if (n < VCF_BUFFER_SIZE)
+		{
+			size_t m = R_ReadConnection(File, Buffer_Ptr, VCF_BUFFER_SIZE-n);
+			n += m;
+		}
+		Buffer_Ptr = &Buffer[0];
+		Buffer_EndPtr = Buffer_Ptr + n;
+		if (n <= 0)
+		{
+			if (File->EOF_signalled)
+				throw ErrSeqArray("read text error.");
+			File->EOF_signalled = TRUE;
+		}
 	}
 
-	// skip '\n' and '\r'
-	if (ch=='\n' || ch=='\r')
+	/// skip '\n' and '\r'
+	inline void SkipCRLF(int ch)
 	{
-		do {
-			VCF_Buffer_Ptr ++;
-			if (VCF_Buffer_Ptr >= VCF_Buffer_EndPtr)
-			{
-				if (VCF_File->EOF_signalled)
-					break;
-				Read_VCF_Buffer();
-			}
-			ch = *VCF_Buffer_Ptr;
-		} while (ch=='\n' || ch=='\r');
+		if (ch=='\n' || ch=='\r')
+		{
+			do {
+				Buffer_Ptr ++;
+				if (Buffer_Ptr >= Buffer_EndPtr)
+				{
+					if (File->EOF_signalled)
+						break;
+					ReadBuffer();
+				}
+				ch = *Buffer_Ptr;
+			} while (ch=='\n' || ch=='\r');
+		}
 	}
-
-	VCF_NextColumnNum = 1;
-	VCF_NextLineNum ++;
-	save_pBegin = save_pEnd = Text_pBegin;
-}
-
-/// skip white space
-inline static void SkipWhiteSpace()
-{
-	// skip whitespace
-	while ((Text_pBegin < Text_pEnd) && (*Text_pBegin == ' '))
-		Text_pBegin ++;
-	while ((Text_pBegin < Text_pEnd) && (*(Text_pEnd-1) == ' '))
-		Text_pEnd --;
-}
-
-/// skip a dot
-inline static void SkipTextWithDot()
-{
-	SkipWhiteSpace();
-	if ((Text_pEnd-Text_pBegin == 1) && (*Text_pBegin == '.'))
-		Text_pBegin ++;
-}
+};
 
 
 
@@ -357,8 +403,114 @@ static const char *ERR_GENO_CONV = "Invalid integer conversion for genotypes '%s
 static const char *ERR_GENO_OUT_RANGE = "Genotype is out of range '%s'";
 static const char *ERR_FLOAT_CONV = "Invalid float conversion '%s'";
 
+
+/// find the first character 'ch' in [p, end), return end if not found
+inline static const char *find_char(const char *p, const char *end, char ch)
+{
+	// SWAR, eight characters per loop
+	static const C_UInt64 ONES  = 0x0101010101010101ULL;
+	static const C_UInt64 HIGHS = 0x8080808080808080ULL;
+	const C_UInt64 mask = ONES * (C_UInt8)ch;
+	while (end - p >= 8)
+	{
+		C_UInt64 v;
+		memcpy(&v, p, sizeof(v));
+		v ^= mask;  // zero byte if matched
+		if ((v - ONES) & ~v & HIGHS) break;
+		p += 8;
+	}
+	// tail
+	while ((p < end) && (*p != ch)) p ++;
+	return p;
+}
+
+inline static char *find_char(char *p, char *end, char ch)
+{
+	return (char*)find_char((const char*)p, (const char*)end, ch);
+}
+
+
+/// powers of 10 which are exactly representable in double
+static const double EXACT_POW10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/// locale-independent conversion of a decimal number in [p, end), return
+///   false if it is not a plain decimal number or the result might be inexact
+///   (the caller falls back to strtod), otherwise p is moved to the end
+inline static bool fast_strtod(const char *&p, const char *end, double &val)
+{
+	const char *s = p;
+	bool neg = false;
+	if ((s < end) && (*s=='-' || *s=='+'))
+		{ neg = (*s == '-'); s ++; }
+
+	// the mantissa with up to 19 significant digits
+	C_UInt64 w = 0;
+	int n_digit = 0, n_sig = 0, exp10 = 0;
+	for (; (s < end) && ((unsigned)(*s - '0') < 10); s ++)
+	{
+		n_digit ++;
+		if (w || (*s != '0'))
+		{
+			if (++n_sig > 19) return false;
+			w = w*10 + (*s - '0');
+		}
+	}
+	if ((s < end) && (*s == '.'))
+	{
+		for (s ++; (s < end) && ((unsigned)(*s - '0') < 10); s ++)
+		{
+			n_digit ++; exp10 --;
+			if (w || (*s != '0'))
+			{
+				if (++n_sig > 19) return false;
+				w = w*10 + (*s - '0');
+			}
+		}
+	}
+	if (n_digit <= 0) return false;
+
+	// the exponent
+	if ((s < end) && (*s=='e' || *s=='E'))
+	{
+		s ++;
+		bool eneg = false;
+		if ((s < end) && (*s=='-' || *s=='+'))
+			{ eneg = (*s == '-'); s ++; }
+		if (!((s < end) && ((unsigned)(*s - '0') < 10)))
+			return false;
+		int e = 0;
+		for (; (s < end) && ((unsigned)(*s - '0') < 10); s ++)
+			if (e < 100000) e = e*10 + (*s - '0');
+		exp10 += eneg ? -e : e;
+	}
+
+	// exact if both mantissa and 10^|exp10| are representable (one rounding)
+	double v = (double)w;
+	if (w > 0)
+	{
+		if (w > (C_UInt64(1) << 53)) return false;
+		if (exp10 < 0)
+		{
+			if (exp10 < -22) return false;
+			v /= EXACT_POW10[-exp10];
+		} else if (exp10 > 0)
+		{
+			if (exp10 > 22) return false;
+			v *= EXACT_POW10[exp10];
+		}
+	}
+
+	val = neg ? -v : v;
+	p = s;
+	return true;
+}
+
+
 /// get an integer from a string
-inline static int getInt32(const char *p, const char *end)
+inline static int getInt32(const char *p, const char *end, bool raise_error)
 {
 	while ((p < end) && (*p == ' '))
 		p ++;
@@ -368,7 +520,7 @@ inline static int getInt32(const char *p, const char *end)
 	{
 		p ++;
 		while ((p < end) && (*p == ' ')) p ++;
-		if ((p < end) && VCF_RaiseError)
+		if ((p < end) && raise_error)
 			throw ErrSeqArray(ERR_INT_CONV, SHORT(start, end).c_str());
 		return NA_INTEGER;
 	}
@@ -383,7 +535,7 @@ inline static int getInt32(const char *p, const char *end)
 		if ('0' <= ch && ch <= '9')
 		{
 			val = val*10 + (ch - '0');
-			if (VCF_RaiseError && (val > INT_MAX))
+			if (raise_error && (val > INT_MAX))
 				throw ErrSeqArray(ERR_INT_OUT_RANGE, SHORT(start, end).c_str());
 		} else {
 			if (ch == ' ')
@@ -392,7 +544,7 @@ inline static int getInt32(const char *p, const char *end)
 					p ++;
 				if (p >= end) break;
 			}
-			if (VCF_RaiseError)
+			if (raise_error)
 				throw ErrSeqArray(ERR_INT_CONV, SHORT(start, end).c_str());
 			return NA_INTEGER;
 		}
@@ -401,85 +553,94 @@ inline static int getInt32(const char *p, const char *end)
 	return sign ? -val : val;
 }
 
-/// get multiple integers from a string
-inline static void getInt32Array(const char *p, const char *end,
-	vector<C_Int32> &I32s)
+/// get an integer from an element of a comma-separated list, p is moved to
+///   the next element
+inline static C_Int32 getInt32Elm(const char *&p, const char *end,
+	bool raise_error)
 {
-	I32s.clear();
+	while ((p < end) && (*p == ' ')) p ++;
+	const char *start = p;
 
-	while (p < end)
+	if ((p < end) && (*p == '.'))
 	{
-		while ((p < end) && (*p == ' '))
-			p ++;
-		const char *start = p;
-
-		if ((p < end) && (*p == '.'))
+		p ++;
+		while ((p < end) && (*p == ' ')) p ++;
+		if ((p < end) && (*p != ','))
 		{
-			p ++;
-			while ((p < end) && (*p == ' ')) p ++;
-			if ((p < end) && (*p != ','))
-			{
-				if (VCF_RaiseError)
-					throw ErrSeqArray(ERR_INT_CONV, SHORT(start, end).c_str());
-				while ((p < end) && (*p != ',')) p ++;
-			}
-			I32s.push_back(NA_INTEGER);
-			if ((p < end) && (*p == ',')) p ++;
-			continue;
+			if (raise_error)
+				throw ErrSeqArray(ERR_INT_CONV, SHORT(start, end).c_str());
+			p = find_char(p, end, ',');
 		}
+		if (p < end) p ++;
+		return NA_INTEGER;
+	}
 
-		bool sign = ((p < end) && (*p == '-'));
-		if (sign) p ++;
+	bool sign = ((p < end) && (*p == '-'));
+	if (sign) p ++;
 
-		C_Int64 val = 0;
-		while (p < end)
+	// digits, saturated at INT_MAX+1 to avoid overflow
+	C_Int64 val = 0;
+	unsigned d;
+	while ((p < end) && ((d = (unsigned)(*p - '0')) < 10))
+	{
+		val = val*10 + d; p ++;
+		if (val > INT_MAX) val = C_Int64(INT_MAX) + 1;
+	}
+	if (val > INT_MAX)
+	{
+		if (raise_error)
+			throw ErrSeqArray(ERR_INT_OUT_RANGE, SHORT(start, end).c_str());
+		val = NA_INTEGER; sign = false;
+	}
+
+	// delimiter
+	while ((p < end) && (*p == ' ')) p ++;
+	if (p < end)
+	{
+		if (*p != ',')
 		{
-			char ch = *p;
-			if ('0' <= ch && ch <= '9')
-			{
-				val = val*10 + (ch - '0');
-				if (VCF_RaiseError && (val > INT_MAX))
-					throw ErrSeqArray(ERR_INT_OUT_RANGE, SHORT(start, end).c_str());
-				p ++;
-			} else {
-				if (ch == ' ')
-				{
-					while ((p < end) && (*p == ' '))
-						p ++;
-					if (p >= end) break;
-					ch = *p;
-				}
+			if (raise_error)
+				throw ErrSeqArray(ERR_INT_CONV, SHORT(start, end).c_str());
+			val = NA_INTEGER; sign = false;
+			p = find_char(p, end, ',');
+		}
+		if (p < end) p ++;
+	}
 
-				if (ch == ',')
-				{
-					p ++;
-					break;
-				} else {
-					if (VCF_RaiseError)
-						throw ErrSeqArray(ERR_INT_CONV, SHORT(start, end).c_str());
-					else
-						while ((p < end) && (*p != ',')) p ++;
-				}
+	return sign ? -val : val;
+}
 
-				val = NA_INTEGER; sign = false;
-				if ((p < end) && (*p == ',')) p ++;
-				break;
-			}
-		}
+/// get multiple integers from a string
+inline static void getInt32Array(const char *p, const char *end,
+	vector<C_Int32> &I32s, bool raise_error)
+{
+	I32s.clear();
+	while (p < end)
+		I32s.push_back(getInt32Elm(p, end, raise_error));
+}
 
-		I32s.push_back(sign ? -val : val);
+/// the allele codes of characters in genotypes
+static const struct TGenoCharTable
+{
+	C_Int8 Code[256];  //< 0-9 for digits, -1 for '.', -2 otherwise
+	TGenoCharTable()
+	{
+		memset(Code, -2, sizeof(Code));
+		for (int i=0; i < 10; i++) Code['0' + i] = i;
+		Code[(int)'.'] = -1;
 	}
-}
+} GENO_CHAR;
 
 /// get a genotype from a string
-inline static C_Int16 getGeno(const char *p, const char *end, int num_allele)
+inline static C_Int16 getGeno(const char *p, const char *end, int num_allele,
+	bool raise_error)
 {
 	const char *start = p;
 	if ((p < end) && (*p == '.'))
 	{
 		p ++;
 		while ((p < end) && (*p == ' ')) p ++;
-		if ((p < end) && VCF_RaiseError)
+		if ((p < end) && raise_error)
 			throw ErrSeqArray(ERR_INT_CONV, SHORT(start, end).c_str());
 		return -1;
 	}
@@ -491,7 +652,7 @@ inline static C_Int16 getGeno(const char *p, const char *end, int num_allele)
 		if ('0' <= ch && ch <= '9')
 		{
 			val = val*10 + (ch - '0');
-			if (VCF_RaiseError && (val > 32767))
+			if (raise_error && (val > 32767))
 				throw ErrSeqArray(ERR_INT_OUT_RANGE, SHORT(start, end).c_str());
 		} else {
 			if (ch == ' ')
@@ -500,7 +661,7 @@ inline static C_Int16 getGeno(const char *p, const char *end, int num_allele)
 					p ++;
 				if (p >= end) break;
 			}
-			if (VCF_RaiseError)
+			if (raise_error)
 				throw ErrSeqArray(ERR_GENO_CONV, SHORT(start, end).c_str());
 			return -1;
 		}
@@ -508,7 +669,7 @@ inline static C_Int16 getGeno(const char *p, const char *end, int num_allele)
 
 	if (val >= num_allele)
 	{
-		if (VCF_RaiseError)
+		if (raise_error)
 			throw ErrSeqArray(ERR_GENO_OUT_RANGE, SHORT(start, end).c_str());
 		val = -1;
 	}
@@ -518,7 +679,7 @@ inline static C_Int16 getGeno(const char *p, const char *end, int num_allele)
 
 
 /// get a real number from a string
-inline static double getFloat(char *p, char *end)
+inline static double getFloat(char *p, char *end, bool raise_error)
 {
 	while ((p < end) && (*p == ' ')) p ++;
 	while ((p < end) && (*(end-1) == ' ')) end --;
@@ -526,83 +687,94 @@ inline static double getFloat(char *p, char *end)
 
 	if (!((end-p == 1) && (*p == '.')))
 	{
-		char *endptr = (char*)p;
-		*end = 0;  // no worry, see VCF_BUFFER_SIZE_PLUS
-		double val = strtod(p, &endptr);
-
-		if (endptr == p)
+		double val;
+		const char *s = p;
+		if (!fast_strtod(s, end, val) || (s < end))
 		{
-			if (VCF_RaiseError)
-				throw ErrSeqArray(ERR_FLOAT_CONV, SHORT(start, end).c_str());
-			val = R_NaN;
-		} else {
-			p = endptr;
-			while ((p < end) && (*p == ' ')) p ++;
-			if (p < end)
+			char *endptr = (char*)p;
+			*end = 0;  // no worry, see VCF_BUFFER_SIZE_PLUS
+			val = strtod(p, &endptr);
+			if (endptr == p)
 			{
-				val = R_NaN;
-				if (VCF_RaiseError)
+				if (raise_error)
 					throw ErrSeqArray(ERR_FLOAT_CONV, SHORT(start, end).c_str());
+				return R_NaN;
 			}
+			s = endptr;
 		}
 
+		while ((s < end) && (*s == ' ')) s ++;
+		if (s < end)
+		{
+			val = R_NaN;
+			if (raise_error)
+				throw ErrSeqArray(ERR_FLOAT_CONV, SHORT(start, end).c_str());
+		}
 		return val;
 	} else {
 		return R_NaN;
 	}
 }
 
-/// get multiple real numbers from a string
-inline static void getFloatArray(char *p, char *end, vector<double> &F64s)
+/// get a real number from an element of a comma-separated list, p is moved
+///   to the next element, '*end' should be zero
+inline static double getFloatElm(char *&p, char *end, bool raise_error)
 {
-	while ((p < end) && (*(end-1) == ' ')) end --;
-	*end = 0;  // no worry, see VCF_BUFFER_SIZE_PLUS
-	F64s.clear();
+	while ((p < end) && (*p == ' ')) p ++;
+	const char *start = p;
 
-	while (p < end)
+	// missing value
+	if ((p < end) && (*p == '.'))
 	{
-		while ((p < end) && (*p == ' ')) p ++;
-		const char *start = p;
-		double val;
-
-		bool is_dot = false;
-		if ((p < end) && (*p == '.'))
+		char *s = p + 1;
+		while ((s < end) && (*s == ' ')) s ++;
+		if ((s >= end) || (*s == ','))
 		{
-			char *s = p + 1;
-			while ((s < end) && (*s == ' ')) s ++;
-			is_dot = (s >= end) || (*s == ',');
-			if (is_dot) p = s;
+			p = (s < end) ? s + 1 : s;
+			return R_NaN;
 		}
+	}
 
-		if (!is_dot)
+	// the fast path, or strtod for the others (e.g., inf, nan, hex)
+	double val;
+	const char *s = p;
+	if (!fast_strtod(s, end, val) || ((s < end) && (*s != ',') && (*s != ' ')))
+	{
+		char *endptr = p;
+		val = strtod(p, &endptr);
+		if (endptr == p)
 		{
-			char *endptr = (char*)p;
-			val = strtod(p, &endptr);
-
-			if (endptr == p)
-			{
-				if (VCF_RaiseError)
-					throw ErrSeqArray(ERR_FLOAT_CONV, SHORT(start, end).c_str());
-				val = R_NaN;
-				while ((p < end) && (*p != ',')) p ++;
-			} else {
-				p = endptr;
-				while ((p < end) && (*p == ' ')) p ++;
-				if ((p < end) && (*p != ','))
-				{
-					if (VCF_RaiseError)
-						throw ErrSeqArray(ERR_FLOAT_CONV, SHORT(start, end).c_str());
-					val = R_NaN;
-					while ((p < end) && (*p != ',')) p ++;
-				}
-			}
-		} else
+			if (raise_error)
+				throw ErrSeqArray(ERR_FLOAT_CONV, SHORT(start, end).c_str());
 			val = R_NaN;
-
-		F64s.push_back(val);
-		if ((p < end) && (*p == ',')) p ++;
+		}
+		s = endptr;
 	}
-}
+
+	// delimiter
+	p = (char*)s;
+	while ((p < end) && (*p == ' ')) p ++;
+	if ((p < end) && (*p != ','))
+	{
+		if (raise_error)
+			throw ErrSeqArray(ERR_FLOAT_CONV, SHORT(start, end).c_str());
+		val = R_NaN;
+		p = find_char(p, end, ',');
+	}
+	if (p < end) p ++;
+	return val;
+}
+
+/// get multiple real numbers from a string
+inline static void getFloatArray(char *p, char *end, vector<double> &F64s,
+	bool raise_error)
+{
+	while ((p < end) && (*(end-1) == ' ')) end --;
+	*end = 0;  // no worry, see VCF_BUFFER_SIZE_PLUS
+	F64s.clear();
+	while (p < end)
+		F64s.push_back(getFloatElm(p, end, raise_error));
+}
 
 
 /// get an integer from a string
@@ -614,7 +786,7 @@ inline static void getStringArray(char *p, char *end, vector<string> &UTF8s)
 		while ((p < end) && (*p == ' ')) p ++;
 		const char *s = p;
 
-		while ((p < end) && (*p != ',')) p ++;
+		p = find_char(p, end, ',');
 		const char *e = p;
 		while ((s < e) && (*(e-1) == ' ')) e --;
 
@@ -625,11 +797,259 @@ inline static void getStringArray(char *p, char *end, vector<string> &UTF8s)
 
 
 
+// ===========================================================
+// BCF2 typed values
+// ===========================================================
+
+// little-endian integers
+
+inline static C_UInt16 get_u16(const C_UInt8 *p)
+{
+	return C_UInt16(p[0]) | (C_UInt16(p[1]) << 8);
+}
+
+inline static C_UInt32 get_u32(const C_UInt8 *p)
+{
+	return C_UInt32(p[0]) | (C_UInt32(p[1]) << 8) | (C_UInt32(p[2]) << 16) |
+		(C_UInt32(p[3]) << 24);
+}
+
+inline static C_UInt64 get_u64(const C_UInt8 *p)
+{
+	return C_UInt64(get_u32(p)) | (C_UInt64(get_u32(p + 4)) << 32);
+}
+
+static const int BCF_BT_NULL  = 0;  ///< no value
+static const int BCF_BT_INT8  = 1;  ///< 8-bit integer
+static const int BCF_BT_INT16 = 2;  ///< 16-bit integer
+static const int BCF_BT_INT32 = 3;  ///< 32-bit integer
+static const int BCF_BT_FLOAT = 5;  ///< 32-bit float
+static const int BCF_BT_CHAR  = 7;  ///< character
+
+static const C_Int32 BCF_INT_END = INT_MIN + 1;  ///< the end of an integer vector, missing value is NA_INTEGER
+static const C_UInt32 BCF_FLOAT_MISSING = 0x7F800001;  ///< missing float
+static const C_UInt32 BCF_FLOAT_END = 0x7F800002;      ///< the end of a float vector
+
+static const char *ERR_BCF_TRUNCATED = "Truncated BCF record.";
+
+/// the size of a value in bytes, or -1 if it is an invalid type
+inline static int BCF_TypeSize(int type)
+{
+	switch (type)
+	{
+		case BCF_BT_NULL:  return 0;
+		case BCF_BT_INT8:  return 1;
+		case BCF_BT_INT16: return 2;
+		case BCF_BT_INT32: return 4;
+		case BCF_BT_FLOAT: return 4;
+		case BCF_BT_CHAR:  return 1;
+		default: return -1;
+	}
+}
+
+/// get an integer (NA_INTEGER for missing, BCF_INT_END for the end of vector)
+inline static C_Int32 BCF_GetInt(const C_UInt8 *p, int type)
+{
+	C_Int32 v;
+	switch (type)
+	{
+	case BCF_BT_INT8:
+		v = (C_Int8)p[0];
+		if (v == -128) return NA_INTEGER;
+		return (v == -127) ? BCF_INT_END : v;
+	case BCF_BT_INT16:
+		v = (C_Int16)get_u16(p);
+		if (v == -32768) return NA_INTEGER;
+		return (v == -32767) ? BCF_INT_END : v;
+	case BCF_BT_INT32:
+		// INT_MIN is missing, and INT_MIN+1 is the end of vector
+		return (C_Int32)get_u32(p);
+	default:
+		throw ErrSeqArray("Invalid BCF integer type (%d).", type);
+	}
+}
+
+/// get a real number from an integer or a float (R_NaN for missing),
+///   return false if it is the end of vector
+inline static bool BCF_GetNum(const C_UInt8 *p, int type, double &val)
+{
+	if (type == BCF_BT_FLOAT)
+	{
+		C_UInt32 u = get_u32(p);
+		if (u == BCF_FLOAT_END) return false;
+		if (u != BCF_FLOAT_MISSING)
+		{
+			float f;
+			memcpy(&f, &u, sizeof(f));
+			val = f;
+		} else
+			val = R_NaN;
+	} else {
+		C_Int32 v = BCF_GetInt(p, type);
+		if (v == BCF_INT_END) return false;
+		val = (v != NA_INTEGER) ? v : R_NaN;
+	}
+	return true;
+}
+
+/// the length of a character vector without the padding NULs
+inline static size_t BCF_StrLen(const C_UInt8 *p, size_t n)
+{
+	while ((n > 0) && (p[n-1] == 0)) n --;
+	return n;
+}
+
+static C_Int32 BCF_TypedInt(const C_UInt8 *&p, const C_UInt8 *end);
+
+/// get the type descriptor of a typed value, return the type and set the
+///   number of values
+inline static int BCF_TypeDesc(const C_UInt8 *&p, const C_UInt8 *end,
+	size_t &num)
+{
+	if (p >= end) throw ErrSeqArray(ERR_BCF_TRUNCATED);
+	const int type = (*p) & 0x0F;
+	num = (*p++) >> 4;
+	if (num == 15)
+	{
+		// the length is given by the next typed integer
+		C_Int32 n = BCF_TypedInt(p, end);
+		if (n < 0)
+			throw ErrSeqArray("Invalid vector length in the BCF record.");
+		num = n;
+	}
+	if (BCF_TypeSize(type) < 0)
+		throw ErrSeqArray("Invalid BCF type (%d).", type);
+	return type;
+}
+
+/// get a typed integer, e.g., the key of INFO or FORMAT
+static C_Int32 BCF_TypedInt(const C_UInt8 *&p, const C_UInt8 *end)
+{
+	size_t num;
+	const int type = BCF_TypeDesc(p, end, num);
+	if ((num != 1) || (type < BCF_BT_INT8) || (type > BCF_BT_INT32))
+		throw ErrSeqArray("Invalid typed integer in the BCF record.");
+	const int sz = BCF_TypeSize(type);
+	if (end - p < sz) throw ErrSeqArray(ERR_BCF_TRUNCATED);
+	C_Int32 v = BCF_GetInt(p, type);
+	p += sz;
+	return v;
+}
+
+/// get a typed vector with 'num' values per sample, return the type
+inline static int BCF_TypedVec(const C_UInt8 *&p, const C_UInt8 *end,
+	size_t &num, const C_UInt8 *&val, size_t num_sample=1)
+{
+	const int type = BCF_TypeDesc(p, end, num);
+	const size_t n = num * BCF_TypeSize(type) * num_sample;
+	if ((size_t)(end - p) < n) throw ErrSeqArray(ERR_BCF_TRUNCATED);
+	val = p; p += n;
+	return type;
+}
+
+
+
+// ===========================================================
+// Appending data to GDS nodes in batches
+// ===========================================================
+
+static const size_t VCF_APPEND_LINE = 4096;  ///< the maximum number of lines buffered before appending
+static const size_t VCF_APPEND_SIZE = 16*1024*1024;  ///< the approximate maximum size of buffered data in bytes
+
+/// the values appended to a GDS node in batches
+template<typename TYPE> struct COREARRAY_DLL_LOCAL TVCF_Append
+{
+	PdAbstractArray obj;  //< the GDS node, or NULL
+	vector<TYPE> buf;     //< the buffered values
+
+	TVCF_Append() { obj = NULL; }
+
+	void Init(PdAbstractArray node) { obj = node; buf.clear(); }
+
+	inline void Push(const TYPE &val) { buf.push_back(val); }
+	inline void Push(const TYPE *p, size_t n) { buf.insert(buf.end(), p, p + n); }
+	inline void Push(const vector<TYPE> &val)
+		{ buf.insert(buf.end(), val.begin(), val.end()); }
+	inline void Fill(const TYPE &val, size_t n) { buf.resize(buf.size()+n, val); }
+
+	/// append the buffered values to the GDS node
+	void Flush()
+	{
+		if (obj && !buf.empty())
+		{
+			GDS_Array_AppendData(obj, buf.size(), &buf[0],
+				TdTraits<TYPE>::SVType);
+		}
+		buf.clear();
+	}
+};
+
+
+/// the buffers of an INFO or FORMAT variable, only one of I32, F64 and S8
+///   is used according to the data type
+struct COREARRAY_DLL_LOCAL TVCF_FieldAppend
+{
+	TVCF_Append<C_Int32> I32;    //< integers or flags
+	TVCF_Append<C_Float64> F64;  //< real numbers
+	TVCF_Append<string> S8;      //< strings
+	TVCF_Append<C_Int32> Len;    //< the lengths
+
+	void Init(PdAbstractArray data_obj, PdAbstractArray len_obj)
+	{
+		I32.Init(data_obj); F64.Init(data_obj); S8.Init(data_obj);
+		Len.Init(len_obj);
+	}
+
+	void Flush()
+	{
+		I32.Flush(); F64.Flush(); S8.Flush(); Len.Flush();
+	}
+};
+
+
+/// the buffers of all GDS nodes written in the VCF import
+struct COREARRAY_DLL_LOCAL TVCF_WriteBuffer
+{
+	TVCF_Append<C_Int32> Idx;        //< variant.id
+	TVCF_Append<string> Chr;         //< chromosome
+	TVCF_Append<C_Int32> Pos;        //< position
+	TVCF_Append<string> RSID;        //< annotation/id
+	TVCF_Append<string> Allele;      //< allele
+	TVCF_Append<C_Float64> Qual;     //< annotation/qual
+	TVCF_Append<C_Int32> Filter;     //< annotation/filter
+	TVCF_Append<C_UInt8> Geno;       //< genotype/data, 2-bit values
+	TVCF_Append<C_Int32> GenoLen;    //< genotype/@data
+	TVCF_Append<C_Int32> GenoExtraIdx;  //< genotype/extra.index
+	TVCF_Append<C_Int32> GenoExtra;     //< genotype/extra
+	TVCF_Append<C_Int8> Phase;          //< phase/data
+	TVCF_Append<C_Int32> PhaseExtraIdx; //< phase/extra.index
+	TVCF_Append<C_Int8> PhaseExtra;     //< phase/extra
+	vector<TVCF_FieldAppend> Info;      //< INFO variables
+	vector<TVCF_FieldAppend> Format;    //< FORMAT variables
+	size_t NumLine;  //< the number of buffered lines
+
+	TVCF_WriteBuffer() { NumLine = 0; }
+
+	/// append all buffered values to the GDS nodes
+	void Flush()
+	{
+		Idx.Flush(); Chr.Flush(); Pos.Flush(); RSID.Flush();
+		Allele.Flush(); Qual.Flush(); Filter.Flush();
+		Geno.Flush(); GenoLen.Flush(); GenoExtraIdx.Flush(); GenoExtra.Flush();
+		Phase.Flush(); PhaseExtraIdx.Flush(); PhaseExtra.Flush();
+		for (size_t i=0; i < Info.size(); i++) Info[i].Flush();
+		for (size_t i=0; i < Format.size(); i++) Format[i].Flush();
+		NumLine = 0;
+	}
+};
+
+
+
 // ===========================================================
 // VCF structure
 // ===========================================================
 
-static string BlankString;
+static const string BlankString;
 
 static const int FIELD_TYPE_INT    = 1;
 static const int FIELD_TYPE_FLOAT  = 2;
@@ -652,12 +1072,18 @@ struct COREARRAY_DLL_LOCAL TVCF_Info
 	             // -3: # of possible genotypes (G), -4: # of alleles (R)
 	bool used;   //< if TRUE, it has been parsed for the current line
 
+	vector<C_Int32> I32s;    //< integers of the current line
+	vector<C_Float64> F64s;  //< real numbers of the current line
+	vector<string> S8s;      //< strings of the current line
+	C_Int32 len;  //< the length saved in 'len_obj', or -1 if not saved
+
 	TVCF_Info()
 	{
 		type = 0;
+		import_flag = used = false;
 		data_obj = len_obj = NULL;
 		number = 0;
-		used = false;
+		len = -1;
 	}
 
 	template<typename TYPE> inline void Index(vector<TYPE> &array,
@@ -668,7 +1094,7 @@ struct COREARRAY_DLL_LOCAL TVCF_Info
 		switch (number)
 		{
 		case -1:  // variable-length, .
-			GDS_Array_AppendData(len_obj, 1, &I32, svInt32);
+			len = I32;
 			break;
 
 		case -2:  // # of alternate alleles, A
@@ -680,7 +1106,7 @@ struct COREARRAY_DLL_LOCAL TVCF_Info
 					name.c_str(), N, I32, ERR_NUMBER);
 			} else if (I32 < N)
 				array.resize(N, missing);
-			GDS_Array_AppendData(len_obj, 1, &N, svInt32);
+			len = N;
 			break;
 
 		case -3:  // # of all possible genotypes, G
@@ -692,7 +1118,7 @@ struct COREARRAY_DLL_LOCAL TVCF_Info
 					name.c_str(), N, I32, ERR_NUMBER);
 			} else if (I32 < N)
 				array.resize(N, missing);
-			GDS_Array_AppendData(len_obj, 1, &N, svInt32);
+			len = N;
 			break;
 
 		case -4:  // # of alleles, R
@@ -704,7 +1130,7 @@ struct COREARRAY_DLL_LOCAL TVCF_Info
 					name.c_str(), N, I32, ERR_NUMBER);
 			} else if (I32 < N)
 				array.resize(N, missing);
-			GDS_Array_AppendData(len_obj, 1, &N, svInt32);
+			len = N;
 			break;
 
 		default:
@@ -718,27 +1144,138 @@ struct COREARRAY_DLL_LOCAL TVCF_Info
 						name.c_str(), number, N, ERR_NUMBER);
 				} else if (N < number)
 					array.resize(number, missing);
+				len = -1;
 			} else
 				throw ErrSeqArray("Invalid value 'number' in TVCF_Info.");
 		}
 	}
 
-	template<typename TYPE> void Fill(vector<TYPE> &array, TYPE val)
+	template<typename TYPE> void Fill(TVCF_FieldAppend &A,
+		TVCF_Append<TYPE> &data, TYPE val)
 	{
 		if (number < 0)
+			A.Len.Push(0);
+		else
+			data.Fill(val, number);
+	}
+
+	/// parse the value of the current line (no access to GDS nodes)
+	void Parse(char *p, char *end, int num_allele, bool raise_error)
+	{
+		switch (type)
 		{
-			C_Int32 I32 = 0;
-			GDS_Array_AppendData(len_obj, 1, &I32, svInt32);
-		} else {
-			array.clear();
-			array.resize(number, val);
-			GDS_Array_AppendData(data_obj, number, &(array[0]),
-				TdTraits<TYPE>::SVType);
+		case FIELD_TYPE_INT:
+			getInt32Array(p, end, I32s, raise_error);
+			Index(I32s, num_allele, NA_INTEGER);
+			break;
+		case FIELD_TYPE_FLOAT:
+			getFloatArray(p, end, F64s, raise_error);
+			Index(F64s, num_allele, R_NaN);
+			break;
+		case FIELD_TYPE_FLAG:
+			if (p < end)
+			{
+				throw ErrSeqArray(
+					"INFO ID '%s' should be a flag without values.",
+					name.c_str());
+			}
+			break;
+		case FIELD_TYPE_STRING:
+			getStringArray(p, end, S8s);
+			Index(S8s, num_allele, BlankString);
+			break;
+		default:
+			throw ErrSeqArray("Invalid INFO Type.");
 		}
 	}
-};
 
+	/// parse the value of a BCF typed vector (no access to GDS nodes)
+	void ParseBCF(int bcf_type, size_t num, const C_UInt8 *p, int num_allele,
+		bool raise_error)
+	{
+		if (bcf_type == BCF_BT_CHAR)
+		{
+			// parse it as the text in VCF
+			string s((const char*)p, BCF_StrLen(p, num));
+			char *b = &s[0];
+			Parse(b, b + s.size(), num_allele, raise_error);
+			return;
+		}
+		const int sz = BCF_TypeSize(bcf_type);
+		switch (type)
+		{
+		case FIELD_TYPE_INT:
+			if (bcf_type == BCF_BT_FLOAT)
+			{
+				throw ErrSeqArray("INFO ID '%s' should be integers.",
+					name.c_str());
+			}
+			I32s.clear();
+			for (; num > 0; num--, p += sz)
+			{
+				C_Int32 v = BCF_GetInt(p, bcf_type);
+				if (v == BCF_INT_END) break;
+				I32s.push_back(v);
+			}
+			Index(I32s, num_allele, NA_INTEGER);
+			break;
+		case FIELD_TYPE_FLOAT:
+			F64s.clear();
+			for (; num > 0; num--, p += sz)
+			{
+				double v;
+				if (!BCF_GetNum(p, bcf_type, v)) break;
+				F64s.push_back(v);
+			}
+			Index(F64s, num_allele, R_NaN);
+			break;
+		case FIELD_TYPE_FLAG:
+			break;
+		case FIELD_TYPE_STRING:
+			throw ErrSeqArray("INFO ID '%s' should be a string.", name.c_str());
+		default:
+			throw ErrSeqArray("Invalid INFO Type.");
+		}
+	}
 
+	/// save the parsed value, or missing value if it is not used, to the
+	///   buffers which are appended to the GDS nodes in batches
+	void SaveToGDS(TVCF_FieldAppend &A)
+	{
+		if (used)
+		{
+			if (len >= 0)
+				A.Len.Push(len);
+			switch (type)
+			{
+			case FIELD_TYPE_INT:
+				A.I32.Push(I32s); break;
+			case FIELD_TYPE_FLOAT:
+				A.F64.Push(F64s); break;
+			case FIELD_TYPE_FLAG:
+				A.I32.Push(1); break;
+			case FIELD_TYPE_STRING:
+				A.S8.Push(S8s); break;
+			default:
+				throw ErrSeqArray("Invalid INFO Type.");
+			}
+		} else {
+			switch (type)
+			{
+			case FIELD_TYPE_INT:
+				Fill(A, A.I32, NA_INTEGER); break;
+			case FIELD_TYPE_FLOAT:
+				Fill(A, A.F64, R_NaN); break;
+			case FIELD_TYPE_FLAG:
+				A.I32.Push(0); break;
+			case FIELD_TYPE_STRING:
+				Fill(A, A.S8, BlankString); break;
+			default:
+				throw ErrSeqArray("Invalid INFO Type.");
+			}
+		}
+	}
+};
 /// the structure of FORMAT field
 struct COREARRAY_DLL_LOCAL TVCF_Format
 {
@@ -752,6 +1289,8 @@ public:
 	             // -1: variable-length (.), -2: # of alternate alleles (A)
 	             // -3: # of possible genotypes (G), -4: # of alleles (R)
 	bool used;   //< if TRUE, it has been parsed for the current line
+	size_t sample_num;  //< the total number of samples
+	bool raise_error;   //< raise conversion error if true
 
 private:
 
@@ -766,9 +1305,9 @@ private:
 		if (CellNum >= MaxCellNum)
 		{
 			MaxCellNum = CellNum + 1;
-			I32ss.resize(MaxCellNum * SampleNum, NA_INTEGER);
+			I32ss.resize(MaxCellNum * sample_num, NA_INTEGER);
 		}
-		I32ss[(CellNum++) * SampleNum + samp_idx] = val;
+		I32ss[(CellNum++) * sample_num + samp_idx] = val;
 	}
 
 	inline void Push_F64(double val, size_t samp_idx)
@@ -776,9 +1315,9 @@ private:
 		if (CellNum >= MaxCellNum)
 		{
 			MaxCellNum = CellNum + 1;
-			F64ss.resize(MaxCellNum * SampleNum, R_NaN);
+			F64ss.resize(MaxCellNum * sample_num, R_NaN);
 		}
-		F64ss[(CellNum++) * SampleNum + samp_idx] = val;
+		F64ss[(CellNum++) * sample_num + samp_idx] = val;
 	}
 
 	inline void Push_S8(const string &val, size_t samp_idx)
@@ -786,9 +1325,9 @@ private:
 		if (CellNum >= MaxCellNum)
 		{
 			MaxCellNum = CellNum + 1;
-			S8ss.resize(MaxCellNum * SampleNum, BlankString);
+			S8ss.resize(MaxCellNum * sample_num, BlankString);
 		}
-		S8ss[(CellNum++) * SampleNum + samp_idx] = val;
+		S8ss[(CellNum++) * sample_num + samp_idx] = val;
 	}
 
 public:
@@ -799,6 +1338,8 @@ public:
 		import_flag = used = false;
 		data_obj = len_obj = NULL;
 		number = 0;
+		sample_num = 0;
+		raise_error = true;
 		MaxCellNum = CellNum = 0;
 	}
 
@@ -815,65 +1356,7 @@ public:
 	{
 		CellNum = 0;
 		while (p < end)
-		{
-			while ((p < end) && (*p == ' ')) p ++;
-			const char *start = p;
-
-			if ((p < end) && (*p == '.'))
-			{
-				p ++;
-				while ((p < end) && (*p == ' ')) p ++;
-				if ((p < end) && (*p != ','))
-				{
-					if (VCF_RaiseError)
-						throw ErrSeqArray(ERR_INT_CONV, SHORT(start, end).c_str());
-					while ((p < end) && (*p != ',')) p ++;
-				}
-				Push_I32(NA_INTEGER, samp_idx);
-				if ((p < end) && (*p == ',')) p ++;
-				continue;
-			}
-
-			bool sign = ((p < end) && (*p == '-'));
-			if (sign) p ++;
-
-			C_Int64 val = 0;
-			while (p < end)
-			{
-				char ch = *p;
-				if ('0' <= ch && ch <= '9')
-				{
-					val = val*10 + (ch - '0');
-					if (VCF_RaiseError && (val > INT_MAX))
-						throw ErrSeqArray(ERR_INT_OUT_RANGE, SHORT(start, end).c_str());
-					p ++;
-				} else {
-					if (ch == ' ')
-					{
-						while ((p < end) && (*p == ' ')) p ++;
-						if (p >= end) break;
-						ch = *p;
-					}
-
-					if (ch == ',')
-					{
-						p ++;
-						break;
-					} else {
-						if (VCF_RaiseError)
-							throw ErrSeqArray(ERR_INT_CONV, SHORT(start, end).c_str());
-						else
-							while ((p < end) && (*p != ',')) p ++;
-					}
-
-					val = NA_INTEGER; sign = false;
-					if ((p < end) && (*p == ',')) p ++;
-					break;
-				}
-			}
-
-			Push_I32(sign ? -val : val, samp_idx);
-		}
+			Push_I32(getInt32Elm(p, end, raise_error), samp_idx);
 	}
 
 	/// get multiple real numbers from a string
@@ -882,49 +1365,8 @@ public:
 		while ((p < end) && (*(end-1) == ' ')) end --;
 		*end = 0;  // no worry, see VCF_BUFFER_SIZE_PLUS
 		CellNum = 0;
-
 		while (p < end)
-		{
-			while ((p < end) && (*p == ' ')) p ++;
-			const char *start = p;
-			double val;
-
-			bool is_dot = false;
-			if ((p < end) && (*p == '.'))
-			{
-				char *s = p + 1;
-				while ((s < end) && (*s == ' ')) s ++;
-				is_dot = (s >= end) || (*s == ',');
-				if (is_dot) p = s;
-			}
-
-			if (!is_dot)
-			{
-				char *endptr = (char*)p;
-				val = strtod(p, &endptr);
-				if (endptr == p)
-				{
-					if (VCF_RaiseError)
-						throw ErrSeqArray(ERR_FLOAT_CONV, SHORT(start, end).c_str());
-					val = R_NaN;
-					while ((p < end) && (*p != ',')) p ++;
-				} else {
-					p = endptr;
-					while ((p < end) && (*p == ' ')) p ++;
-					if ((p < end) && (*p != ','))
-					{
-						if (VCF_RaiseError)
-							throw ErrSeqArray(ERR_FLOAT_CONV, SHORT(start, end).c_str());
-						val = R_NaN;
-						while ((p < end) && (*p != ',')) p ++;
-					}
-				}
-			} else
-				val = R_NaN;
-
-			Push_F64(val, samp_idx);
-			if ((p < end) && (*p == ',')) p ++;
-		}
+			Push_F64(getFloatElm(p, end, raise_error), samp_idx);
 	}
 
 	/// get an integer from a string
@@ -936,7 +1378,7 @@ public:
 			while ((p < end) && (*p == ' ')) p ++;
 			const char *s = p;
 
-			while ((p < end) && (*p != ',')) p ++;
+			p = find_char(p, end, ',');
 			const char *e = p;
 			while ((s < e) && (*(e-1) == ' ')) e --;
 
@@ -945,6 +1387,64 @@ public:
 		}
 	}
 
+	/// get the values of all samples from a BCF typed vector, 'num' values
+	///   per sample
+	void GetBCF(int bcf_type, size_t num, const C_UInt8 *p, size_t num_allele)
+	{
+		const int sz = BCF_TypeSize(bcf_type);
+		if ((bcf_type != BCF_BT_CHAR) && (type == FIELD_TYPE_STRING))
+			throw ErrSeqArray("FORMAT ID '%s' should be a string.", name.c_str());
+		if ((bcf_type == BCF_BT_FLOAT) && (type == FIELD_TYPE_INT))
+			throw ErrSeqArray("FORMAT ID '%s' should be integers.", name.c_str());
+
+		string s;
+		for (size_t si=0; si < sample_num; si++, p += num*sz)
+		{
+			if (bcf_type == BCF_BT_CHAR)
+			{
+				// parse it as the text in VCF
+				s.assign((const char*)p, BCF_StrLen(p, num));
+				char *b = &s[0], *e = b + s.size();
+				switch (type)
+				{
+				case FIELD_TYPE_INT:
+					GetInt32s(b, e, si); break;
+				case FIELD_TYPE_FLOAT:
+					GetFloats(b, e, si); break;
+				case FIELD_TYPE_STRING:
+					GetStrings(b, e, si); break;
+				default:
+					throw ErrSeqArray("Invalid FORMAT Type.");
+				}
+			} else {
+				CellNum = 0;
+				const C_UInt8 *v = p;
+				switch (type)
+				{
+				case FIELD_TYPE_INT:
+					for (size_t k=0; k < num; k++, v += sz)
+					{
+						C_Int32 I32 = BCF_GetInt(v, bcf_type);
+						if (I32 == BCF_INT_END) break;
+						Push_I32(I32, si);
+					}
+					break;
+				case FIELD_TYPE_FLOAT:
+					for (size_t k=0; k < num; k++, v += sz)
+					{
+						double F64;
+						if (!BCF_GetNum(v, bcf_type, F64)) break;
+						Push_F64(F64, si);
+					}
+					break;
+				default:
+					throw ErrSeqArray("Invalid FORMAT Type.");
+				}
+			}
+			Check(num_allele);
+		}
+	}
+
 	/// checking
 	inline void Check(size_t num_allele)
 	{
@@ -996,195 +1496,1047 @@ public:
 		}
 	}
 
-	/// Save
-	inline void SaveToGDS()
+	/// save to the buffers which are appended to the GDS nodes in batches
+	inline void SaveToGDS(TVCF_FieldAppend &A)
 	{
 		if (used)
 		{
-			size_t n = MaxCellNum * SampleNum;
+			size_t n = MaxCellNum * sample_num;
 			switch (type)
 			{
 			case FIELD_TYPE_INT:
-				GDS_Array_AppendData(data_obj, n, &I32ss[0], svInt32);
+				if (n > 0) A.I32.Push(&I32ss[0], n);
 				break;
 			case FIELD_TYPE_FLOAT:
-				GDS_Array_AppendData(data_obj, n, &F64ss[0], svFloat64);
+				if (n > 0) A.F64.Push(&F64ss[0], n);
 				break;
 			case FIELD_TYPE_STRING:
-				GDS_Array_AppendData(data_obj, n, &S8ss[0], svStrUTF8);
+				if (n > 0) A.S8.Push(&S8ss[0], n);
 				break;
 			default:
 				throw ErrSeqArray("Invalid FORMAT Type.");
 			}
-
-			C_Int32 I32 = MaxCellNum;
-			GDS_Array_AppendData(len_obj, 1, &I32, svInt32);
-
+			A.Len.Push(MaxCellNum);
 		} else {
-			C_Int32 I32 = 0;
-			GDS_Array_AppendData(len_obj, 1, &I32, svInt32);
+			A.Len.Push(0);
 		}
 	}
 };
 
-}
-
 
-extern "C"
-{
-using namespace SeqArray;
 
 // ===========================================================
-// Get the number of lines in a VCF file
+// Parsing VCF lines in parallel
 // ===========================================================
 
-COREARRAY_DLL_EXPORT SEXP SEQ_VCF_NumLines(SEXP File, SEXP SkipHead)
+static const size_t VCF_CHUNK_LINE = 256;  ///< the maximum number of lines in a chunk
+static const size_t VCF_CHUNK_SIZE = 64*1024*1024;  ///< the maximum text size of a chunk
+
+/// return true, if matching
+inline static bool StrCaseCmp(const char *prefix, const char *txt, size_t nmax)
+{
+	while (*prefix && *txt && nmax>0)
+	{
+		if (toupper(*prefix) != toupper(*txt))
+			return false;
+		prefix ++; txt ++; nmax --;
+	}
+	return (*prefix == 0);
+}
+
+
+/// an open-addressing hash table from INFO/FORMAT IDs to the list indices
+class COREARRAY_DLL_LOCAL CVCF_KeyHash
 {
-	Init_VCF_Buffer(File);
+public:
+	CVCF_KeyHash() { Mask = 0; }
 
-	if (Rf_asLogical(SkipHead) == TRUE)
+	/// initialize with the IDs in the list of TVCF_Info or TVCF_Format
+	template<typename TYPE> void Init(const vector<TYPE> &list)
 	{
-		InitText();
-		// get the starting line
-		while (!VCF_EOF())
+		size_t n = 16;
+		while (n < 2*list.size()) n <<= 1;
+		Table.assign(n, -1);
+		Mask = n - 1;
+		Names.clear();
+		for (size_t i=0; i < list.size(); i++)
 		{
-			GetText(NA_INTEGER);
-			if (strncmp(Text_pBegin, "#CHROM", 6) == 0)
+			const string &s = list[i].name;
+			Names.push_back(s);
+			size_t h = Hash(s.data(), s.size()) & Mask;
+			while (Table[h] >= 0)
 			{
-				SkipLine();
-				break;
+				// the first one is used for a duplicated ID
+				if (Names[Table[h]] == s) break;
+				h = (h + 1) & Mask;
 			}
+			if (Table[h] < 0) Table[h] = i;
 		}
-		DoneText();
 	}
 
-	// get the number of left lines
-	C_Int64 n = 0;
-	while (!VCF_EOF())
+	/// return the index of ID [s, s+n) in the list, or -1 if not found
+	inline int Find(const char *s, size_t n) const
 	{
-		n ++;
-		SkipLine();
+		if (Table.empty()) return -1;
+		size_t h = Hash(s, n) & Mask;
+		int i;
+		while ((i = Table[h]) >= 0)
+		{
+			const string &nm = Names[i];
+			if ((nm.size() == n) && (memcmp(nm.data(), s, n) == 0))
+				return i;
+			h = (h + 1) & Mask;
+		}
+		return -1;
 	}
 
-	Done_VCF_Buffer();
-	return ScalarReal(n);
-}
+private:
+	vector<string> Names;  //< the IDs
+	vector<int> Table;     //< the hash table, -1 for an empty slot
+	size_t Mask;           //< the table size minus one
 
+	/// FNV-1a
+	inline static size_t Hash(const char *s, size_t n)
+	{
+		C_UInt32 h = 2166136261U;
+		for (; n > 0; n--, s++)
+			h = (h ^ (C_UInt8)(*s)) * 16777619U;
+		return h;
+	}
+};
 
 
-// ===========================================================
-// Split VCF files
-// ===========================================================
+/// the parameters shared by all parsing threads (read-only)
+struct COREARRAY_DLL_LOCAL TVCF_Param
+{
+	string geno_id;      //< the ID for genotypic data in the FORMAT column
+	size_t num_ploidy;   //< the number of ploidy
+	vector<const char *> chr_prefix;  //< chromosome prefix to be removed
+	size_t sample_num;   //< the total number of samples
+	bool raise_error;    //< raise conversion error if true
+	CVCF_KeyHash info_hash;    //< the IDs in the INFO list
+	CVCF_KeyHash format_hash;  //< the IDs in the FORMAT list
+
+	TVCF_Param() { num_ploidy = sample_num = 0; raise_error = true; }
+};
 
-COREARRAY_DLL_EXPORT SEXP SEQ_VCF_Split(SEXP start, SEXP count, SEXP pnum,
-	SEXP multiple)
+
+static const size_t VCF_FORMAT_PLAN_MAX = 16;  ///< the maximum number of cached FORMAT plans
+
+/// the parsed FORMAT column, shared by the lines with the same FORMAT text
+struct COREARRAY_DLL_LOCAL TVCF_FmtPlan
 {
-	int num = Rf_asInteger(pnum);
-	if (num <= 0) error("'pnum' should be > 0.");
-	int multi = Rf_asInteger(multiple);
-	if (multi <= 0) error("'multiple' should be > 0.");
-	SEXP ans = PROTECT(NEW_LIST(2));
-	SEXP start_array = PROTECT(NEW_NUMERIC(num));
-	SEXP count_array = PROTECT(NEW_NUMERIC(num));
-	SET_ELEMENT(ans, 0, start_array);
-	SET_ELEMENT(ans, 1, count_array);
+	string Text;        //< the text of FORMAT column
+	bool HasGeno;       //< true if the first FORMAT ID is genotype
+	vector<int> FmtIdx; //< the indices in the FORMAT list
+	vector<int> FmtField;  //< the index for each field after GT, -1 if unknown
+	vector<string> UnknownFmt;  //< FORMAT IDs not in the meta-information
 
-	double cnt = Rf_asReal(count);
-	double scale = cnt / num;
-	double st = Rf_asReal(start);
-	for (int i=0; i < num; i++)
+	TVCF_FmtPlan() { HasGeno = false; }
+};
+
+
+/// the dictionaries of a BCF2 file mapped to the INFO and FORMAT lists
+struct COREARRAY_DLL_LOCAL TBCF_Dict
+{
+	vector<string> Str;     //< the string dictionary, FILTER/INFO/FORMAT IDs
+	vector<string> Contig;  //< the contig dictionary, without chromosome prefix
+	vector<int> Info;       //< the index in the INFO list for each string, or -1
+	vector<int> Format;     //< the index in the FORMAT list for each string, or -1
+	int Geno;               //< the index of genotype ID in 'Str', or -1
+
+	TBCF_Dict() { Geno = -1; }
+};
+
+
+/// a data line in the VCF file and its parsed values
+struct COREARRAY_DLL_LOCAL TVCF_Line
+{
+	C_Int64 LineNum;   //< the line number in the VCF file
+	size_t TextStart;  //< the starting position in the chunk text
+	size_t TextLen;    //< the length of line text
+	size_t SharedLen;  //< BCF only, the length of shared data in the record
+
+	string Chrom;      //< CHROM without prefix
+	C_Int32 Pos;       //< POS
+	string RSID;       //< ID
+	string Allele;     //< REF and ALT separated by ','
+	C_Float64 Qual;    //< QUAL
+	string Filter;     //< FILTER, empty for missing
+	int NumAllele;     //< the number of alleles, INT_MAX if unknown
+
+	vector<TVCF_Info> Info;      //< INFO values, a copy of the INFO list
+	vector<TVCF_Format> Format;  //< FORMAT values, a copy of the FORMAT list
+	vector<int> FmtIdx;  //< the indices in 'Format' for the FORMAT column
+	vector<string> UnknownInfo;  //< INFO IDs not in the meta-information
+	vector<string> UnknownFmt;   //< FORMAT IDs not in the meta-information
+	vector<string> Warnings;     //< warning messages
+
+	bool HasGeno;      //< true if the first FORMAT ID is genotype
+	C_Int32 NumGenoBits;  //< the number of bits for genotypes
+	vector<C_Int16> Geno;       //< genotypes, sample x ploidy
+	vector<C_UInt8> GenoBits;   //< 2-bit planes of genotypes to be stored
+	vector<C_Int8> Phase;       //< phase, sample x (ploidy - 1)
+	vector<C_Int32> GenoExtra;  //< genotypes beyond the ploidy
+	vector<C_Int32> GenoExtraIdx;  //< pairs of (sample index + 1, length)
+	vector<C_Int8> PhaseExtra;     //< phase beyond the ploidy
+	vector<C_Int32> PhaseExtraIdx; //< pairs of (sample index + 1, length)
+
+	bool HasError;     //< true if parsing fails
+	string ErrMsg;     //< the error message
+	string ErrText;    //< the text of column which fails
+	int ColumnNum;     //< the current column number
+
+	TVCF_Line()
 	{
-		double old_st = REAL(start_array)[i] = round(st);
-		st += scale;
-		C_Int64 n = (C_Int64)(round(st) - old_st);
-		if (n % multi)  // should be a multiple of 'multi'
+		LineNum = 0; TextStart = TextLen = SharedLen = 0;
+		Pos = 0; Qual = 0; NumAllele = 0;
+		HasGeno = false; NumGenoBits = 0;
+		HasError = false; ColumnNum = 0;
+		pNext = pLineEnd = pBegin = pEnd = save_pBegin = save_pEnd = NULL;
+		FmtPlanLast = 0;
+	}
+
+	/// parse the line without throwing an exception, called in parallel,
+	///   'dict' is given if it is a BCF record
+	void Parse(char *text, const TVCF_Param &param, const TBCF_Dict *dict=NULL)
+	{
+		HasError = false;
+		try {
+			if (dict)
+				DoParseBCF((const C_UInt8*)(text + TextStart), param, *dict);
+			else
+				DoParse(text + TextStart, param);
+		}
+		catch (std::exception &E) {
+			HasError = true;
+			ErrMsg = E.what();
+		}
+		catch (...) {
+			HasError = true;
+			ErrMsg = "unknown error!";
+		}
+		if (HasError)
 		{
-			int m = ((n / multi) + 1) * multi;
-			st += m - n;
-			n = m;
+			if (save_pBegin < save_pEnd)
+				ErrText.assign(save_pBegin, save_pEnd);
+			else
+				ErrText.clear();
 		}
-		if ((old_st + n) > (cnt + 1))
-			n = round(cnt + 1 - old_st);
-		REAL(count_array)[i] = (n >= 0) ? n : 0;
 	}
 
-	UNPROTECT(3);
-	return ans;
-}
+private:
+	char *pNext;      //< the pointer to the next column
+	char *pLineEnd;   //< the end of line
+	char *pBegin, *pEnd;  //< the current column text
+	char *save_pBegin, *save_pEnd;  //< the unmodified column text
+	vector<TVCF_FmtPlan> FmtPlan;  //< the cached plans for FORMAT strings
+	size_t FmtPlanLast;  //< the index of the last used plan
+	vector<C_Int32> I32s;  //< genotype extra data of a sample
+	vector<C_Int8> I8s;    //< phase extra data of a sample
+
+	/// get the next column with a seperator '\t'
+	inline void GetText(bool last_column)
+	{
+		ColumnNum ++;
+		pBegin = pNext;
+		char *p = (char*)memchr(pNext, '\t', pLineEnd - pNext);
+		if (p)
+		{
+			if (last_column)
+				throw ErrSeqArray("more columns than what expected.");
+			pEnd = p; pNext = p + 1;
+		} else {
+			if (!last_column)
+				throw ErrSeqArray("fewer columns than what expected.");
+			pEnd = pNext = pLineEnd;
+		}
+		save_pBegin = pBegin;
+		save_pEnd = pEnd;
+	}
 
+	/// get the plan for the current FORMAT text, build it if not cached
+	const TVCF_FmtPlan &GetFmtPlan(const TVCF_Param &param)
+	{
+		const size_t len = pEnd - pBegin;
+		// the last one is most likely reused
+		if (FmtPlanLast < FmtPlan.size())
+		{
+			const TVCF_FmtPlan &p = FmtPlan[FmtPlanLast];
+			if (p.Text.size()==len && memcmp(p.Text.data(), pBegin, len)==0)
+				return p;
+		}
+		for (size_t i=0; i < FmtPlan.size(); i++)
+		{
+			const TVCF_FmtPlan &p = FmtPlan[i];
+			if (p.Text.size()==len && memcmp(p.Text.data(), pBegin, len)==0)
+				{ FmtPlanLast = i; return p; }
+		}
 
+		// a new plan, replacing the oldest one if the cache is full
+		if (FmtPlan.size() < VCF_FORMAT_PLAN_MAX)
+		{
+			FmtPlanLast = FmtPlan.size();
+			FmtPlan.push_back(TVCF_FmtPlan());
+		} else {
+			FmtPlanLast = (FmtPlanLast + 1) % VCF_FORMAT_PLAN_MAX;
+		}
+		TVCF_FmtPlan &plan = FmtPlan[FmtPlanLast];
+		plan.Text.assign(pBegin, pEnd);
+		plan.HasGeno = false;
+		plan.FmtIdx.clear();
+		plan.FmtField.clear();
+		plan.UnknownFmt.clear();
+
+		// parse the IDs
+		bool first_fmt_id_flag = true;
+		const char *p = pBegin;
+		while (p < pEnd)
+		{
+			while ((p < pEnd) && (*p == ' ')) p ++;
+			const char *start = p;
+			p = find_char(p, pEnd, ':');
+			const char *end = p;
+			while ((start < end) && (*(end-1) == ' ')) end --;
+			if (p < pEnd) p ++;
+			const size_t n = end - start;
 
-// ===========================================================
-// Conversion: VCF --> GDS
-// ===========================================================
+			if (first_fmt_id_flag)
+			{
+				first_fmt_id_flag = false;
+				// genotype ID
+				plan.HasGeno = (param.geno_id.size() == n) &&
+					(memcmp(param.geno_id.data(), start, n) == 0);
+				if (plan.HasGeno) continue;
+			}
 
-/// return true, if matching
-inline static bool StrCaseCmp(const char *prefix, const char *txt, size_t nmax)
-{
-	while (*prefix && *txt && nmax>0)
+			// find ID
+			const int idx = param.format_hash.Find(start, n);
+			if (idx >= 0)
+				plan.FmtIdx.push_back(idx);
+			else
+				plan.UnknownFmt.push_back(string(start, end));
+			plan.FmtField.push_back(idx);
+		}
+		// no need to scan the trailing unknown fields
+		while (!plan.FmtField.empty() && plan.FmtField.back() < 0)
+			plan.FmtField.pop_back();
+
+		return plan;
+	}
+
+	/// skip white space
+	inline void SkipWhiteSpace()
 	{
-		if (toupper(*prefix) != toupper(*txt))
-			return false;
-		prefix ++; txt ++; nmax --;
+		while ((pBegin < pEnd) && (*pBegin == ' '))
+			pBegin ++;
+		while ((pBegin < pEnd) && (*(pEnd-1) == ' '))
+			pEnd --;
 	}
-	return (*prefix == 0);
-}
 
+	/// skip a dot
+	inline void SkipTextWithDot()
+	{
+		SkipWhiteSpace();
+		if ((pEnd-pBegin == 1) && (*pBegin == '.'))
+			pBegin ++;
+	}
 
-/// VCF format --> SeqArray GDS format
-COREARRAY_DLL_EXPORT SEXP SEQ_VCF_Parse(SEXP vcf_fn, SEXP header,
-	SEXP gds_root, SEXP param, SEXP line_cnt, SEXP rho)
-{
-	const char *fn = CHAR(STRING_ELT(vcf_fn, 0));
+	/// parse the line text which is ended with '\0'
+	void DoParse(char *text, const TVCF_Param &param)
+	{
+		pNext = text;
+		pLineEnd = text + TextLen;
+		ColumnNum = 0;
+		const size_t SampleNum = param.sample_num;
+		save_pBegin = save_pEnd = NULL;
+		UnknownInfo.clear();
+		UnknownFmt.clear();
+		Warnings.clear();
+		HasGeno = false;
+
+		// -----------------------------------------------------
+		// column 1: CHROM
+		GetText(false);
+		for (vector<const char *>::const_iterator p=param.chr_prefix.begin();
+			p != param.chr_prefix.end(); p++)
+		{
+			if (StrCaseCmp(*p, pBegin, pEnd-pBegin))
+			{
+				pBegin += strlen(*p);
+				break;
+			}
+		}
+		Chrom.assign(pBegin, pEnd);
+
+		// -----------------------------------------------------
+		// column 2: POS
+		GetText(false);
+		Pos = getInt32(pBegin, pEnd, param.raise_error);
+
+		// -----------------------------------------------------
+		// column 3: ID
+		GetText(false);
+		SkipTextWithDot();
+		RSID.assign(pBegin, pEnd);
+
+		// -----------------------------------------------------
+		// column 4 & 5: REF + ALT
+		GetText(false);  // REF
+		SkipWhiteSpace();
+		Allele.assign(pBegin, pEnd);
+
+		GetText(false);  // ALT
+		SkipTextWithDot();
+		if (pEnd > pBegin)
+		{
+			Allele.push_back(',');
+			Allele.append(pBegin, pEnd);
+		}
 
-	COREARRAY_TRY
+		// determine how many alleles
+		if (Allele != "." && Allele != ".,.")
+		{
+			NumAllele = 0;
+			for (const char *p = Allele.c_str(); *p; )
+			{
+				NumAllele ++;
+				while (*p && (*p != ',')) p ++;
+				if (*p == ',') p ++;
+			}
+		} else {
+			NumAllele = INT_MAX;
+		}
 
-	#if (GDS_TIMING > 0)
-		_timing_ = 0;
-		clock_t _start_time = clock();
+		// -----------------------------------------------------
+		// column 6: QUAL
+		GetText(false);
+		Qual = getFloat(pBegin, pEnd, param.raise_error);
+
+		// -----------------------------------------------------
+		// column 7: FILTER
+		GetText(false);
+		SkipTextWithDot();
+		Filter.assign(pBegin, pEnd);
+
+		// -----------------------------------------------------
+		// column 8: INFO
+
+	#if (GDS_TIMING == 3)
+		start_timing();
 	#endif
 
-		// the number of calling PROTECT
-		int nProtected = 0;
+		// initialize
+		for (vector<TVCF_Info>::iterator p = Info.begin(); p != Info.end(); p++)
+			p->used = false;
+		GetText(SampleNum<=0);
+		SkipTextWithDot();
 
-		// =========================================================
-		// initialize variables		
+		// parse
+		while (pBegin < pEnd)
+		{
+			// format: name=val | name
+			char *s, *p;
+			s = p = pBegin;
+			while ((p < pEnd) && (*p != ';') && (*p != '='))
+				p ++;
+			pBegin = p;
+
+			// variable name
+			while ((s < p) && (*(p-1) == ' ')) p --;
+			const char *NameBegin = s;
+			const size_t NameLen = p - s;
+
+			// variable value
+			char *ValBegin, *ValEnd;
+			ValBegin = ValEnd = p = pBegin;
+			if (p < pEnd)
+			{
+				if (*p == '=')
+				{
+					p ++;
+					while ((p < pEnd) && (*p == ' ')) p ++;
+					ValBegin = p;
+					while ((p < pEnd) && (*p != ';')) p ++;
+					pBegin = p;
+					if (p < pEnd) pBegin ++;
+					while ((ValBegin < p) && (*(p-1) == ' ')) p --;
+					ValEnd = p;
+				} else if (*p == ';')
+					pBegin = p + 1;
+				else
+					pBegin = p;
+			}
+
+			const int idx = param.info_hash.Find(NameBegin, NameLen);
+			if (idx >= 0)
+			{
+				// it is in the list of INFO variables
+				TVCF_Info *pI = &Info[idx];
+				if (pI->used)
+				{
+					char buf[1024];
+					snprintf(buf, sizeof(buf),
+						"LINE: %lld, ignore duplicated INFO ID (%s).",
+						(long long int)LineNum, pI->name.c_str());
+					Warnings.push_back(buf);
+					continue;
+				}
+				if (pI->import_flag)
+					pI->Parse(ValBegin, ValEnd, NumAllele, param.raise_error);
+				pI->used = true;
+			} else
+				UnknownInfo.push_back(string(NameBegin, NameLen));
+		}
+
+	#if (GDS_TIMING == 3)
+		end_timing();
+	#endif
+
+		// -----------------------------------------------------
+		// column 9: FORMAT
+
+		if (SampleNum <= 0) return;
+
+		// initialize
+		for (vector<int>::iterator p = FmtIdx.begin(); p != FmtIdx.end(); p++)
+			Format[*p].Init();
+		GetText(false);
+
+		// the plan for the FORMAT text, most lines share a few FORMAT strings
+		const TVCF_FmtPlan &plan = GetFmtPlan(param);
+		HasGeno = plan.HasGeno;
+		FmtIdx = plan.FmtIdx;
+		UnknownFmt = plan.UnknownFmt;
+		for (vector<int>::iterator p = FmtIdx.begin(); p != FmtIdx.end(); p++)
+			Format[*p].used = true;
+		pBegin = pEnd;
+
+		// -----------------------------------------------------
+		// Columns for samples
+
+		const size_t num_ploidy = param.num_ploidy;
+		const size_t num_ploidy_less = num_ploidy - 1;
+		Geno.resize(SampleNum * num_ploidy);
+		Phase.resize(SampleNum * num_ploidy_less);
+		GenoExtra.clear(); GenoExtraIdx.clear();
+		PhaseExtra.clear(); PhaseExtraIdx.clear();
+
+		// pointer to genotype buffer
+		C_Int16 *pGeno = &Geno[0];
+		// pointer to phase buffer
+		C_Int8 *pPhase = Phase.empty() ? NULL : &Phase[0];
+
+		// for-loop
+		for (size_t si=0; si < SampleNum; si ++)
+		{
+			// read
+			GetText(si >= (SampleNum-1));
+
+			// skip whitespace
+			while ((pBegin<pEnd) && (*pBegin==' '))
+				pBegin ++;
+
+			if (HasGeno)
+			{
+				// -------------------------------------------------
+				// the first field -- genotypes (GT)
+
+				const char *p = pBegin;
+				pBegin = find_char(pBegin, pEnd, ':');
+				const char *end = pBegin;
+
+				if ((pBegin<pEnd) && (*pBegin==':'))
+					pBegin ++;
+
+				I32s.clear(); // genotype extra data
+				I8s.clear(); // phase extra data
+
+				// fast path, diploid with single-character alleles, e.g., 0|1
+				int g1, g2;
+				if ((num_ploidy == 2) && (end - p == 3) &&
+					((g1 = GENO_CHAR.Code[(C_UInt8)p[0]]) >= -1) &&
+					((g2 = GENO_CHAR.Code[(C_UInt8)p[2]]) >= -1) &&
+					(g1 < NumAllele) && (g2 < NumAllele) &&
+					((p[1] == '|') || (p[1] == '/')))
+				{
+					*pGeno ++ = g1;
+					*pGeno ++ = g2;
+					*pPhase ++ = (p[1] == '|') ? 1 : 0;
+				} else {
+					size_t tmp_num_ploidy = 0, tmp_num_phase = 0;
+
+					while (p < end)
+					{
+						const char *start = p;
+						while ((p<end) && (*p!='|') && (*p!='/'))
+							p ++;
+						C_Int16 g = getGeno(start, p, NumAllele, param.raise_error);
+
+						tmp_num_ploidy ++;
+						if (tmp_num_ploidy <= num_ploidy)
+							*pGeno ++ = g;
+						else
+							I32s.push_back(g);
+
+						if (p < end)
+						{
+							C_Int8 v = 0;
+							if (*p == '|')
+							{
+								v = 1; p ++;
+							} else if (*p == '/')
+							{
+								v = 0; p ++;
+							}
+							if (++tmp_num_phase <= num_ploidy_less)
+								*pPhase ++ = v;
+							else
+								I8s.push_back(v);
+						}
+					}
+
+					for (size_t m=tmp_num_ploidy; m < num_ploidy; m++)
+						*pGeno ++ = -1;
+					for (size_t m=tmp_num_phase; m < num_ploidy_less; m++)
+						*pPhase ++ = 0;
+				}
+
+				// "genotype/extra", e.g., triploid call: 0/0/1
+				if (!I32s.empty())
+				{
+					GenoExtra.insert(GenoExtra.end(), I32s.begin(), I32s.end());
+					GenoExtraIdx.push_back(si + 1);
+					GenoExtraIdx.push_back(I32s.size());
+				}
+
+				// "phase/extra", e.g., triploid call: 0/0/1
+				if (!I8s.empty())
+				{
+					PhaseExtra.insert(PhaseExtra.end(), I8s.begin(), I8s.end());
+					PhaseExtraIdx.push_back(si + 1);
+					PhaseExtraIdx.push_back(I8s.size());
+				}
+			}
+
+			// -------------------------------------------------
+			// the other field -- format id
+			for (size_t i=0; i < plan.FmtField.size(); i++)
+			{
+				char *start = pBegin;
+				pBegin = find_char(pBegin, pEnd, ':');
+				char *end = pBegin;
+
+				if ((pBegin<pEnd) && (*pBegin==':'))
+					pBegin ++;
+
+				// skip the field not in the meta-information
+				if (plan.FmtField[i] < 0) continue;
+				TVCF_Format *pFmt = &Format[plan.FmtField[i]];
+
+				// parse the field
+				if (pFmt->import_flag)
+				{
+				#if (GDS_TIMING == 1)
+					start_timing();
+				#endif
+
+					switch (pFmt->type)
+					{
+					case FIELD_TYPE_INT:
+						pFmt->GetInt32s(start, end, si); break;
+					case FIELD_TYPE_FLOAT:
+						pFmt->GetFloats(start, end, si); break;
+					case FIELD_TYPE_STRING:
+						pFmt->GetStrings(start, end, si); break;
+					default:
+						throw ErrSeqArray("Invalid FORMAT Type.");
+					}
+					pFmt->Check(NumAllele);
 
+				#if (GDS_TIMING == 1)
+					end_timing();
+				#endif
+				}
+			}
+		}
+
+		if (HasGeno) SetGenoBits();
+	}
+
+	/// parse a BCF record, the shared data followed by the data of samples
+	void DoParseBCF(const C_UInt8 *p, const TVCF_Param &param,
+		const TBCF_Dict &dict)
+	{
+		const C_UInt8 *end = p + SharedLen;
+		ColumnNum = 0;
+		const size_t SampleNum = param.sample_num;
+		save_pBegin = save_pEnd = NULL;
+		UnknownInfo.clear();
+		UnknownFmt.clear();
+		Warnings.clear();
+		HasGeno = false;
+		if ((SharedLen < 24) || (TextLen < SharedLen))
+			throw ErrSeqArray(ERR_BCF_TRUNCATED);
+
+		const size_t n_info = get_u32(p + 16) & 0xFFFF;
+		const size_t n_allele = get_u32(p + 16) >> 16;
+		const size_t n_sample = get_u32(p + 20) & 0xFFFFFF;
+		const size_t n_fmt = get_u32(p + 20) >> 24;
+		size_t num;
+		const C_UInt8 *v;
+		int type;
+
+		// -----------------------------------------------------
+		// CHROM
+		ColumnNum = 1;
+		const C_UInt32 chr = get_u32(p);
+		if (chr >= dict.Contig.size())
+			throw ErrSeqArray("Invalid contig index (%d).", (int)chr);
+		Chrom = dict.Contig[chr];
+
+		// -----------------------------------------------------
+		// POS, 0-based
+		ColumnNum = 2;
+		Pos = (C_Int32)get_u32(p + 4) + 1;
+
+		// -----------------------------------------------------
+		// QUAL
+		ColumnNum = 6;
+		if (!BCF_GetNum(p + 12, BCF_BT_FLOAT, Qual))
+			Qual = R_NaN;
+		p += 24;
+
+		// -----------------------------------------------------
+		// ID
+		ColumnNum = 3;
+		type = BCF_TypedVec(p, end, num, v);
+		if ((type != BCF_BT_CHAR) && (num > 0))
+			throw ErrSeqArray("Invalid ID.");
+		RSID.assign((const char*)v, BCF_StrLen(v, num));
+		if (RSID == ".") RSID.clear();
+
+		// -----------------------------------------------------
+		// REF + ALT
+		ColumnNum = 4;
+		Allele.clear();
+		NumAllele = 0;
+		for (size_t i=0; i < n_allele; i++)
+		{
+			type = BCF_TypedVec(p, end, num, v);
+			if ((type != BCF_BT_CHAR) && (num > 0))
+				throw ErrSeqArray("Invalid allele.");
+			num = BCF_StrLen(v, num);
+			if ((i > 0) && (num == 1) && (v[0] == '.'))
+				continue;  // missing ALT
+			if (i > 0) Allele.push_back(',');
+			Allele.append((const char*)v, num);
+			NumAllele ++;
+		}
+		if (Allele.empty() || Allele == ".")
+		{
+			Allele = ".";
+			NumAllele = INT_MAX;
+		}
+
+		// -----------------------------------------------------
+		// FILTER
+		ColumnNum = 7;
+		type = BCF_TypedVec(p, end, num, v);
+		Filter.clear();
+		if (num > 0)
+		{
+			if ((type < BCF_BT_INT8) || (type > BCF_BT_INT32))
+				throw ErrSeqArray("Invalid FILTER.");
+			const int sz = BCF_TypeSize(type);
+			for (; num > 0; num--, v += sz)
+			{
+				C_Int32 k = BCF_GetInt(v, type);
+				if (k == BCF_INT_END) break;
+				if (k == NA_INTEGER) continue;
+				if ((k < 0) || ((size_t)k >= dict.Str.size()))
+					throw ErrSeqArray("Invalid FILTER index (%d).", k);
+				if (!Filter.empty()) Filter.push_back(';');
+				Filter.append(dict.Str[k]);
+			}
+		}
+
+		// -----------------------------------------------------
+		// INFO
+		ColumnNum = 8;
+		for (vector<TVCF_Info>::iterator it = Info.begin(); it != Info.end(); it++)
+			it->used = false;
+		for (size_t i=0; i < n_info; i++)
+		{
+			const C_Int32 key = BCF_TypedInt(p, end);
+			type = BCF_TypedVec(p, end, num, v);
+			if ((key < 0) || ((size_t)key >= dict.Str.size()))
+				throw ErrSeqArray("Invalid INFO key (%d).", key);
+			const int idx = dict.Info[key];
+			if (idx >= 0)
+			{
+				// it is in the list of INFO variables
+				TVCF_Info *pI = &Info[idx];
+				if (pI->used)
+				{
+					char buf[1024];
+					snprintf(buf, sizeof(buf),
+						"RECORD: %lld, ignore duplicated INFO ID (%s).",
+						(long long int)LineNum, pI->name.c_str());
+					Warnings.push_back(buf);
+					continue;
+				}
+				if (pI->import_flag)
+					pI->ParseBCF(type, num, v, NumAllele, param.raise_error);
+				pI->used = true;
+			} else
+				UnknownInfo.push_back(dict.Str[key]);
+		}
+
+		// -----------------------------------------------------
+		// FORMAT and samples
+
+		if (SampleNum <= 0) return;
+		ColumnNum = 9;
+		if ((n_fmt > 0) && (n_sample != SampleNum))
+		{
+			throw ErrSeqArray("The number of samples (%d) should be %d.",
+				(int)n_sample, (int)SampleNum);
+		}
+
+		// initialize
+		for (vector<int>::iterator it = FmtIdx.begin(); it != FmtIdx.end(); it++)
+			Format[*it].Init();
+		FmtIdx.clear();
+		const size_t num_ploidy = param.num_ploidy;
+		Geno.resize(SampleNum * num_ploidy);
+		Phase.resize(SampleNum * (num_ploidy - 1));
+		GenoExtra.clear(); GenoExtraIdx.clear();
+		PhaseExtra.clear(); PhaseExtraIdx.clear();
+
+		p = end;
+		end = p + (TextLen - SharedLen);
+		for (size_t i=0; i < n_fmt; i++)
+		{
+			const C_Int32 key = BCF_TypedInt(p, end);
+			type = BCF_TypedVec(p, end, num, v, SampleNum);
+			if ((key < 0) || ((size_t)key >= dict.Str.size()))
+				throw ErrSeqArray("Invalid FORMAT key (%d).", key);
+			if (key == dict.Geno)
+			{
+				if (HasGeno) continue;
+				if ((type < BCF_BT_INT8) || (type > BCF_BT_INT32))
+					throw ErrSeqArray("Invalid genotypes.");
+				GetBCFGeno(type, num, v, param);
+				HasGeno = true;
+				continue;
+			}
+			const int idx = dict.Format[key];
+			if (idx >= 0)
+			{
+				TVCF_Format *pFmt = &Format[idx];
+				if (pFmt->used) continue;
+				FmtIdx.push_back(idx);
+				pFmt->used = true;
+				if (pFmt->import_flag)
+					pFmt->GetBCF(type, num, v, NumAllele);
+			} else
+				UnknownFmt.push_back(dict.Str[key]);
+		}
+
+		if (HasGeno) SetGenoBits();
+	}
+
+	/// get the genotypes from a BCF typed vector, 'num' values per sample,
+	///   each value is (allele + 1) << 1 | phased
+	void GetBCFGeno(int type, size_t num, const C_UInt8 *p,
+		const TVCF_Param &param)
+	{
+		const size_t num_ploidy = param.num_ploidy;
+		const size_t num_ploidy_less = num_ploidy - 1;
+		const int sz = BCF_TypeSize(type);
+		C_Int16 *pGeno = &Geno[0];
+		C_Int8 *pPhase = Phase.empty() ? NULL : &Phase[0];
+
+		for (size_t si=0; si < param.sample_num; si++, p += num*sz)
+		{
+			I32s.clear(); // genotype extra data
+			I8s.clear(); // phase extra data
+			size_t m = 0;
+			const C_UInt8 *s = p;
+			for (; m < num; m++, s += sz)
+			{
+				C_Int32 v = BCF_GetInt(s, type);
+				if (v == BCF_INT_END) break;
+				if (v == NA_INTEGER) v = 0;
+				C_Int32 g = (v >> 1) - 1;
+				if ((g >= NumAllele) || (g > 32767))
+				{
+					if (param.raise_error)
+						throw ErrSeqArray("Genotype is out of range '%d'", g);
+					g = -1;
+				} else if (g < -1)
+					g = -1;
+				// the phase of the separator before the allele
+				if (m > 0)
+				{
+					if (m <= num_ploidy_less)
+						*pPhase ++ = v & 0x01;
+					else
+						I8s.push_back(v & 0x01);
+				}
+				if (m < num_ploidy)
+					*pGeno ++ = g;
+				else
+					I32s.push_back(g);
+			}
+			for (size_t k=m; k < num_ploidy; k++)
+				*pGeno ++ = -1;
+			for (size_t k=(m > 0) ? m-1 : 0; k < num_ploidy_less; k++)
+				*pPhase ++ = 0;
+
+			// "genotype/extra", e.g., triploid call: 0/0/1
+			if (!I32s.empty())
+			{
+				GenoExtra.insert(GenoExtra.end(), I32s.begin(), I32s.end());
+				GenoExtraIdx.push_back(si + 1);
+				GenoExtraIdx.push_back(I32s.size());
+			}
+			// "phase/extra"
+			if (!I8s.empty())
+			{
+				PhaseExtra.insert(PhaseExtra.end(), I8s.begin(), I8s.end());
+				PhaseExtraIdx.push_back(si + 1);
+				PhaseExtraIdx.push_back(I8s.size());
+			}
+		}
+	}
+
+	/// determine the number of bits and the 2-bit planes of genotypes
+	void SetGenoBits()
+	{
+		// need to identify the number of alleles if missing
+		int num_allele = NumAllele;
+		if (num_allele == INT_MAX)
+		{
+			num_allele = 0;
+			C_Int16 *p = &Geno[0];
+			for (size_t n=Geno.size(); n > 0; n--, p++)
+			{
+				if ((*p >= 0) && (*p > num_allele))
+					num_allele = *p;
+			}
+			num_allele ++;
+		}
+
+		// determine how many bits
+		NumGenoBits = 2;
+		// plus ONE for missing value
+		while ((num_allele + 1) > (1 << NumGenoBits))
+			NumGenoBits += 2;
+
+		// 2-bit planes, one value per byte, missing value is 3 in all planes
+		const size_t n = Geno.size();
+		GenoBits.resize(n * (NumGenoBits >> 1));
+		C_UInt8 *s = &GenoBits[0];
+		const C_Int16 *g = &Geno[0];
+		for (size_t i=0; i < n; i++)
+			*s++ = g[i] & 0x03;
+		for (int shr=2; shr < NumGenoBits; shr += 2)
+		{
+			for (size_t i=0; i < n; i++)
+				*s++ = (g[i] >> shr) & 0x03;
+		}
+	}
+};
+
+
+/// a chunk of VCF data lines
+struct COREARRAY_DLL_LOCAL TVCF_Chunk
+{
+	vector<char> Text;  //< the text of lines, each line is ended with '\0'
+	vector<TVCF_Line> Lines;  //< the lines, reused for the next chunk
+	size_t NumLine;     //< the number of lines in the chunk
+
+	TVCF_Chunk() { NumLine = 0; }
+};
+
+
+/// read at most 'max_line' lines to the chunk
+static void Read_VCF_Chunk(CVCF_Reader &VCF, TVCF_Chunk &chunk,
+	C_Int64 max_line, const vector<TVCF_Info> &info_list,
+	const vector<TVCF_Format> &format_list)
+{
+	chunk.Text.clear();
+	chunk.NumLine = 0;
+	while (((C_Int64)chunk.NumLine < max_line) && !VCF.IsEOF())
+	{
+		if (chunk.NumLine >= chunk.Lines.size())
+		{
+			chunk.Lines.push_back(TVCF_Line());
+			chunk.Lines.back().Info = info_list;
+			chunk.Lines.back().Format = format_list;
+		}
+		TVCF_Line &L = chunk.Lines[chunk.NumLine ++];
+		L.LineNum = VCF.NextLine();
+		L.TextStart = chunk.Text.size();
+		L.TextLen = VCF.ReadLine(chunk.Text);
+		chunk.Text.push_back(0);  // getFloat() might revise the end of text
+		if (chunk.Text.size() >= VCF_CHUNK_SIZE) break;
+	}
+}
+
+
+
+// ===========================================================
+// Writing the parsed lines to the GDS file
+// ===========================================================
+
+/// the GDS nodes and the states for writing the parsed lines in order
+class COREARRAY_DLL_LOCAL CVCF_GDSWriter
+{
+public:
+	vector<TVCF_Info> InfoList;      ///< the INFO variables in the header
+	vector<TVCF_Format> FormatList;  ///< the FORMAT variables in the header
+	C_Int64 VariantIndex;  ///< the variant id of the last line written
+
+	CVCF_GDSWriter()
+	{
+		VariantIndex = VariantStartIndex = 0;
+		SampleNum = 0;
+		varPhase = NULL;
+		MaxAppendLine = 1;
+	}
+
+	/// initialize the GDS nodes and the parameters for parsing
+	void Init(SEXP header, SEXP gds_root, SEXP param, TVCF_Param &Param,
+		C_Int64 variant_index)
+	{
 		// the total number of samples
-		SampleNum = Rf_asInteger(RGetListElement(param, "sample.num"));
+		Param.sample_num = Rf_asInteger(RGetListElement(param, "sample.num"));
+		SampleNum = Param.sample_num;
 		// the variable name for genotypic data
-		string geno_id = CHAR(STRING_ELT(RGetListElement(param, "genotype.var.name"), 0));
+		Param.geno_id = CHAR(STRING_ELT(RGetListElement(param, "genotype.var.name"), 0));
 		// raise an error
-		VCF_RaiseError = (Rf_asLogical(RGetListElement(param, "raise.error")) == TRUE);
-		// variant start
-		C_Int64 variant_start = (C_Int64)Rf_asReal(RGetListElement(param, "start"));
-		// variant count
-		C_Int64 variant_count = (C_Int64)Rf_asReal(RGetListElement(param, "count"));
-		// input file
-		Init_VCF_Buffer(RGetListElement(param, "infile"));
+		Param.raise_error = (Rf_asLogical(RGetListElement(param, "raise.error")) == TRUE);
 		// chromosome prefix
 		SEXP ChrPrefix = RGetListElement(param, "chr.prefix");
-		// progress file
-		SEXP progfile = RGetListElement(param, "progfile");
-		// verbose
-		// bool Verbose = (LOGICAL(RGetListElement(param, "verbose"))[0] == TRUE);
+		for (size_t i=0; i < RLength(ChrPrefix); i++)
+			Param.chr_prefix.push_back(CHAR(STRING_ELT(ChrPrefix, i)));
 
 		// the number of ploidy
 		size_t num_ploidy = Rf_asInteger(RGetListElement(header, "ploidy"));
 		if (num_ploidy <= 0)
 			throw ErrSeqArray("Invalid header$ploidy: %d.", (int)num_ploidy);
-
-		size_t num_ploidy_less = num_ploidy - 1;
-		size_t num_samp_ploidy = SampleNum * num_ploidy;
-		size_t num_samp_ploidy_less = SampleNum * num_ploidy_less;
+		Param.num_ploidy = num_ploidy;
 
 		// filter level list
-		vector<string> filter_list;
+		FilterList.clear();
 		{
 			SEXP level = RGetListElement(param, "filter.levels");
 			const int n = RLength(level);
 			for (int i=0; i < n; i++)
-				filter_list.push_back(CHAR(STRING_ELT(level, i)));
+				FilterList.push_back(CHAR(STRING_ELT(level, i)));
 		}
 
 		// GDS nodes
@@ -1208,7 +2560,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_VCF_Parse(SEXP vcf_fn, SEXP header,
 		if (GenoNumBits != 2)
 			throw ErrSeqArray("Invalid data type in genotype/data, it should be bit2.");
 
-		PdAbstractArray varPhase, varPhaseExtraIdx, varPhaseExtra;
+		PdAbstractArray varPhaseExtraIdx, varPhaseExtra;
 		if (num_ploidy > 1)
 		{
 			varPhase = GDS_Node_Path(Root, "phase/data", FALSE);
@@ -1219,8 +2571,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_VCF_Parse(SEXP vcf_fn, SEXP header,
 		}
 
 		// INFO
-		vector<TVCF_Info> info_list;
-		set<string> info_missing;
+		InfoList.clear();
 		{
 			SEXP info = RGetListElement(header, "info");
 			SEXP info_ID = RGetListElement(info, "ID");
@@ -1240,13 +2591,12 @@ COREARRAY_DLL_EXPORT SEXP SEQ_VCF_Parse(SEXP vcf_fn, SEXP header,
 				val.len_obj = GDS_Node_Path(Root,
 					(string("annotation/info/@") + val.name).c_str(), FALSE);
 
-				info_list.push_back(val);
+				InfoList.push_back(val);
 			}
 		}
 
 		// FORMAT
-		vector<TVCF_Format> format_list;
-		set<string> format_missing;
+		FormatList.clear();
 		{
 			SEXP fmt = RGetListElement(header, "format");
 			SEXP fmt_ID = RGetListElement(fmt, "ID");
@@ -1261,620 +2611,1391 @@ COREARRAY_DLL_EXPORT SEXP SEQ_VCF_Parse(SEXP vcf_fn, SEXP header,
 				val.type = INTEGER(fmt_inttype)[i];
 				val.import_flag = (LOGICAL(fmt_flag)[i] == TRUE);
 				val.number = INTEGER(fmt_intnum)[i];
+				val.sample_num = SampleNum;
+				val.raise_error = Param.raise_error;
 				val.data_obj = GDS_Node_Path(Root,
 					(string("annotation/format/") + val.name + "/data").c_str(), FALSE);
 				val.len_obj = GDS_Node_Path(Root,
 					(string("annotation/format/") + val.name + "/@data").c_str(), FALSE);
-				format_list.push_back(val);
+				FormatList.push_back(val);
+			}
+		}
+
+		// the lookup of INFO and FORMAT IDs
+		Param.info_hash.Init(InfoList);
+		Param.format_hash.Init(FormatList);
+
+		// the buffers appended to the GDS nodes in batches
+		WB.Idx.Init(varIdx); WB.Chr.Init(varChr); WB.Pos.Init(varPos);
+		WB.RSID.Init(varRSID); WB.Allele.Init(varAllele);
+		WB.Qual.Init(varQual); WB.Filter.Init(varFilter);
+		WB.Geno.Init(varGeno); WB.GenoLen.Init(varGenoLen);
+		WB.GenoExtraIdx.Init(varGenoExtraIdx); WB.GenoExtra.Init(varGenoExtra);
+		WB.Phase.Init(varPhase); WB.PhaseExtraIdx.Init(varPhaseExtraIdx);
+		WB.PhaseExtra.Init(varPhaseExtra);
+		WB.Info.resize(InfoList.size());
+		for (size_t i=0; i < InfoList.size(); i++)
+			WB.Info[i].Init(InfoList[i].data_obj, InfoList[i].len_obj);
+		WB.Format.resize(FormatList.size());
+		for (size_t i=0; i < FormatList.size(); i++)
+			WB.Format[i].Init(FormatList[i].data_obj, FormatList[i].len_obj);
+		WB.NumLine = 0;
+
+		// the maximum number of buffered lines according to the line size
+		{
+			size_t sz = 64 + SampleNum * num_ploidy * sizeof(C_Int16) +
+				SampleNum * (num_ploidy - 1) * sizeof(C_Int8);
+			for (size_t i=0; i < FormatList.size(); i++)
+			{
+				if (!FormatList[i].import_flag) continue;
+				switch (FormatList[i].type)
+				{
+					case FIELD_TYPE_FLOAT:
+						sz += SampleNum * sizeof(C_Float64); break;
+					case FIELD_TYPE_STRING:
+						sz += SampleNum * sizeof(string); break;
+					default:
+						sz += SampleNum * sizeof(C_Int32);
+				}
+			}
+			MaxAppendLine = VCF_APPEND_SIZE / sz;
+			if (MaxAppendLine < 1) MaxAppendLine = 1;
+			if (MaxAppendLine > VCF_APPEND_LINE)
+				MaxAppendLine = VCF_APPEND_LINE;
+		}
+
+		// variant id (integer)
+		VariantIndex = VariantStartIndex = variant_index;
+		InfoMissing.clear(); FormatMissing.clear();
+		WarnList.clear();
+	}
+
+	/// write a parsed line to the buffers, no use of R API (called by the
+	///   main thread while the next lines are parsed in the parallel region)
+	void Write(TVCF_Line &L)
+	{
+		// variant id
+		VariantIndex ++;
+		WB.Idx.Push(C_Int32(VariantIndex));
+		// column 1: CHROM
+		WB.Chr.Push(L.Chrom);
+		// column 2: POS
+		WB.Pos.Push(L.Pos);
+		// column 3: ID
+		WB.RSID.Push(L.RSID);
+		// column 4 & 5: REF + ALT
+		WB.Allele.Push(L.Allele);
+		// column 6: QUAL
+		WB.Qual.Push(L.Qual);
+
+		// column 7: FILTER
+		C_Int32 I32;
+		if (!L.Filter.empty())
+		{
+			vector<string>::iterator p =
+				std::find(FilterList.begin(), FilterList.end(), L.Filter);
+			if (p == FilterList.end())
+			{
+				FilterList.push_back(L.Filter);
+				I32 = FilterList.size();
+			} else
+				I32 = p - FilterList.begin() + 1;
+		} else
+			I32 = NA_INTEGER;
+		WB.Filter.Push(I32);
+
+		// column 8: INFO
+		for (size_t i=0; i < L.Info.size(); i++)
+		{
+			if (L.Info[i].import_flag)
+				L.Info[i].SaveToGDS(WB.Info[i]);
+		}
+
+		// warnings
+		WarnList.insert(WarnList.end(), L.Warnings.begin(), L.Warnings.end());
+		for (size_t i=0; i < L.UnknownInfo.size(); i++)
+		{
+			const string &s = L.UnknownInfo[i];
+			if (InfoMissing.insert(s).second)
+			{
+				WarnList.push_back("Unknown INFO ID '" + s +
+					"' is ignored (it should be defined in the meta-information lines).");
+			}
+		}
+		for (size_t i=0; i < L.UnknownFmt.size(); i++)
+		{
+			const string &s = L.UnknownFmt[i];
+			if (FormatMissing.insert(s).second)
+			{
+				WarnList.push_back("Unknown FORMAT ID '" + s +
+					"' is ignored (it should be defined in the meta-information lines).");
+			}
+		}
+
+		if (SampleNum > 0)
+		{
+			// columns for samples
+			if (L.HasGeno)
+			{
+				// genotype/extra
+				WB.GenoExtra.Push(L.GenoExtra);
+				for (size_t i=0; i < L.GenoExtraIdx.size(); i+=2)
+				{
+					C_Int32 v[3] = { L.GenoExtraIdx[i],
+						C_Int32(VariantIndex - VariantStartIndex),
+						L.GenoExtraIdx[i+1] };
+					WB.GenoExtraIdx.Push(v, 3);
+				}
+
+				// phase/extra
+				if (varPhase && !L.PhaseExtra.empty())
+				{
+					WB.PhaseExtra.Push(L.PhaseExtra);
+					for (size_t i=0; i < L.PhaseExtraIdx.size(); i+=2)
+					{
+						C_Int32 v[3] = { L.PhaseExtraIdx[i],
+							C_Int32(VariantIndex - VariantStartIndex),
+							L.PhaseExtraIdx[i+1] };
+						WB.PhaseExtraIdx.Push(v, 3);
+					}
+				}
+
+				// write genotypes, the 2-bit planes
+				WB.GenoLen.Push(L.NumGenoBits >> 1);
+				WB.Geno.Push(L.GenoBits);
+
+				// write phase information
+				if (varPhase)
+					WB.Phase.Push(L.Phase);
+			}
+
+			// for-loop all format IDs: write
+		#if (GDS_TIMING == 2)
+			start_timing();
+		#endif
+			for (size_t i=0; i < L.Format.size(); i++)
+			{
+				if (L.Format[i].import_flag)
+					L.Format[i].SaveToGDS(WB.Format[i]);
+			}
+		#if (GDS_TIMING == 2)
+			end_timing();
+		#endif
+		}
+
+		// append to the GDS nodes in batches
+		if (++WB.NumLine >= MaxAppendLine)
+			WB.Flush();
+	}
+
+	/// append the remaining buffered values to the GDS nodes
+	void Flush() { WB.Flush(); }
+
+	/// raise the warnings in R
+	void RaiseWarnings()
+	{
+		for (size_t i=0; i < WarnList.size(); i++)
+			Rf_warning("%s", WarnList[i].c_str());
+		WarnList.clear();
+	}
+
+	/// return the levels of FILTER, a character vector (unprotected)
+	SEXP FilterLevels() const
+	{
+		SEXP rv = NEW_CHARACTER(FilterList.size());
+		for (int i=0; i < (int)FilterList.size(); i++)
+			SET_STRING_ELT(rv, i, mkChar(FilterList[i].c_str()));
+		return rv;
+	}
+
+private:
+	size_t SampleNum;            ///< the total number of samples
+	C_Int64 VariantStartIndex;   ///< the variant id before the first line
+	PdAbstractArray varPhase;    ///< phase/data, or NULL
+	vector<string> FilterList;   ///< the levels of FILTER
+	set<string> InfoMissing;     ///< the unknown INFO IDs
+	set<string> FormatMissing;   ///< the unknown FORMAT IDs
+	vector<string> WarnList;     ///< the warnings raised after a chunk
+	TVCF_WriteBuffer WB;         ///< the buffers appended in batches
+	size_t MaxAppendLine;        ///< the maximum number of buffered lines
+};
+
+
+/// load at most the next 'max_line' lines within the range of variants
+template<class TSOURCE> static void VCF_ReadChunk(TSOURCE &Src,
+	TVCF_Chunk &Chunk, C_Int64 max_line, C_Int64 variant_start,
+	C_Int64 variant_count, C_Int64 &variant_read_index,
+	const CVCF_GDSWriter &Writer)
+{
+	C_Int64 n = max_line;
+	if ((variant_count >= 0) &&
+			(variant_start + variant_count - 1 - variant_read_index < n))
+		n = variant_start + variant_count - 1 - variant_read_index;
+	Src.ReadChunk(Chunk, n, Writer);
+	variant_read_index += Chunk.NumLine;
+}
+
+
+/// parse the lines in parallel and write them to the GDS file in order,
+///   TSOURCE provides the data lines (VCF text or BCF records) with
+///   ReadChunk(), Parse() and SetLine() (for the error message), and
+///   THREAD_READ (whether ReadChunk() can be called by a worker thread)
+template<class TSOURCE> static void VCF_ParseWrite(TSOURCE &Src,
+	CVCF_GDSWriter &Writer, const TVCF_Param &Param, int NumThread,
+	C_Int64 variant_start, C_Int64 variant_count, CProgress &Progress)
+{
+	// the maximum number of lines in a chunk, no extra memory if serial
+	const C_Int64 max_chunk_line = (NumThread > 1) ? VCF_CHUNK_LINE : 1;
+	// the index of the last line loaded
+	C_Int64 variant_read_index = Writer.VariantIndex;
+	// whether the next chunk is loaded by a worker thread
+	const bool thread_read = TSOURCE::THREAD_READ && (NumThread > 1);
+
+	// a pipeline of three chunks: in each round, the next chunk is loaded
+	//   by a worker thread (or by the main thread before the parallel region
+	//   for an R connection), the current chunk is parsed by the other
+	//   threads, and the previous chunk is written to the GDS file by the
+	//   main thread; warnings and progress are reported after the parallel
+	//   region since the R API is not thread-safe
+	TVCF_Chunk Chunk[3];
+	TVCF_Chunk *pRead = &Chunk[0], *pParse = &Chunk[1], *pWrite = &Chunk[2];
+	bool read_end = false;
+	string read_error;
+
+	try {
+		VCF_ReadChunk(Src, *pParse, max_chunk_line, variant_start,
+			variant_count, variant_read_index, Writer);
+		read_end = (pParse->NumLine <= 0);
+
+		while ((pParse->NumLine > 0) || (pWrite->NumLine > 0))
+		{
+			// -----------------------------------------------------
+			// load the next lines by the main thread if not thread-safe
+			pRead->NumLine = 0;
+			if (!read_end && !thread_read)
+			{
+				try {
+					VCF_ReadChunk(Src, *pRead, max_chunk_line, variant_start,
+						variant_count, variant_read_index, Writer);
+				}
+				catch (std::exception &E) {
+					pRead->NumLine = 0;
+					read_error = E.what();
+				}
+			}
+
+			const int num_parse = pParse->NumLine;
+			char *parse_text = pParse->Text.empty() ? NULL : &pParse->Text[0];
+			const int num_write = pWrite->NumLine;
+			bool write_fail = false;
+			string write_error;
+
+		#ifdef _OPENMP
+			#pragma omp parallel num_threads(NumThread) if (NumThread > 1)
+		#endif
+			{
+				// write the previous lines in order
+			#ifdef _OPENMP
+				#pragma omp master
+			#endif
+				{
+					try {
+						for (int k=0; k < num_write; k++)
+						{
+							TVCF_Line &L = pWrite->Lines[k];
+							Src.SetLine(L);
+							if (L.HasError)
+								throw ErrSeqArray(L.ErrMsg);
+							Writer.Write(L);
+						}
+					}
+					catch (std::exception &E) {
+						write_fail = true;
+						write_error = E.what();
+					}
+				}
+
+				// load the next lines
+				if (thread_read && !read_end)
+				{
+				#ifdef _OPENMP
+					#pragma omp single nowait
+				#endif
+					{
+						try {
+							VCF_ReadChunk(Src, *pRead, max_chunk_line,
+								variant_start, variant_count,
+								variant_read_index, Writer);
+						}
+						catch (std::exception &E) {
+							pRead->NumLine = 0;
+							read_error = E.what();
+						}
+					}
+				}
+
+				// parse the current lines
+			#ifdef _OPENMP
+				#pragma omp for schedule(dynamic) nowait
+			#endif
+				for (int k=0; k < num_parse; k++)
+					Src.Parse(pParse->Lines[k], parse_text, Param);
 			}
+
+			if (write_fail)
+				throw ErrSeqArray(write_error);
+			// raise warnings and update progress
+			Writer.RaiseWarnings();
+			if (num_write > 0)
+				Progress.Forward(num_write);
+
+			// the lines before a reading error are written first
+			if (pRead->NumLine <= 0) read_end = true;
+			TVCF_Chunk *p = pWrite;
+			pWrite = pParse; pParse = pRead; pRead = p;
 		}
+		if (!read_error.empty())
+			throw ErrSeqArray(read_error);
+	}
+	catch (...) {
+		// the lines before the error are kept in the GDS file
+		try { Writer.Flush(); } catch (...) { }
+		throw;
+	}
 
-		// variant id (integer)
-		C_Int64 variant_index = (C_Int64)Rf_asReal(line_cnt);
-		C_Int64 variant_start_index = variant_index;
+	// the remaining buffered values
+	Writer.Flush();
+}
 
-		// the string buffer
-		string cell;
-		cell.reserve(1024);
 
-		// the numeric buffer
-		vector<C_Int8> I8s;
-		I8s.reserve(SampleNum);
+/// the data lines from a VCF text file, used in VCF_ParseWrite()
+struct COREARRAY_DLL_LOCAL TVCF_TextSource
+{
+	/// the lines are read from an R connection by the main thread
+	static const bool THREAD_READ = false;
 
-		C_Int32 I32;
-		vector<C_Int32> I32s;
-		I32s.reserve(SampleNum);
+	CVCF_Reader &VCF;
+	TVCF_TextSource(CVCF_Reader &vcf): VCF(vcf) { }
 
-		C_Float64 F64;
-		vector<C_Float64> F64s;
-		F64s.reserve(SampleNum);
+	inline void ReadChunk(TVCF_Chunk &chunk, C_Int64 max_line,
+		const CVCF_GDSWriter &W)
+	{
+		Read_VCF_Chunk(VCF, chunk, max_line, W.InfoList, W.FormatList);
+	}
+	inline void Parse(TVCF_Line &L, char *text, const TVCF_Param &param) const
+	{
+		L.Parse(text, param);
+	}
+	inline void SetLine(const TVCF_Line &L)
+	{
+		VCF.LineNum = L.LineNum;
+		VCF.ColumnNum = 0;
+		if (L.HasError)
+			VCF.SetErrorPos(L.LineNum, L.ColumnNum, L.ErrText);
+	}
+};
 
-		// the string buffer
-		vector<string> S8s;
-		S8s.reserve(SampleNum);
 
-		// genotypes
-		vector<C_Int16> Genotypes;
-		Genotypes.resize(num_samp_ploidy);
+// ===========================================================
+// BGZF-compressed VCF files
+// ===========================================================
 
-		// phase
-		vector<C_Int8> Phases;
-		Phases.resize(num_samp_ploidy_less);
+#ifdef _WIN32
+#   define SEQ_FSEEK    fseeko64
+#   define SEQ_FTELL    ftello64
+#else
+#   define SEQ_FSEEK    fseeko
+#   define SEQ_FTELL    ftello
+#endif
 
-		vector< TVCF_Info >::iterator pI;
-		vector< TVCF_Format* >::iterator pF;
-		vector< TVCF_Format* > fmt_ptr;
-		fmt_ptr.reserve(format_list.size());
+static const size_t BGZF_BLOCK_SIZE = 65536;  ///< the maximum size of a BGZF block
+static const size_t BGZF_HEADER_SIZE = 18;    ///< the size of a BGZF header without additional subfields
 
-		// chromosome prefix
-		vector<const char *> ChrPref;
-		for (size_t i=0; i < RLength(ChrPrefix); i++)
-			ChrPref.push_back(CHAR(STRING_ELT(ChrPrefix, i)));
+/// return the size of a BGZF block according to its header, or 0 if invalid
+inline static size_t BGZF_BlockSize(const C_UInt8 *h, size_t n)
+{
+	if (n < 12) return 0;
+	if (h[0]!=31 || h[1]!=139 || h[2]!=8 || (h[3] & 4)==0) return 0;
+	size_t xlen = get_u16(h + 10);
+	if (n < 12 + xlen) return 0;
+	// find the subfield 'BC'
+	for (const C_UInt8 *p=h+12, *e=h+12+xlen; p+4 <= e; )
+	{
+		size_t slen = get_u16(p + 2);
+		if (p[0]=='B' && p[1]=='C' && slen==2 && p+6 <= e)
+			return size_t(get_u16(p + 4)) + 1;
+		p += 4 + slen;
+	}
+	return 0;
+}
 
 
-		// =========================================================
-		// skip the header and data rows
+/// a file compressed with BGZF (a series of gzip blocks, at most 64KB each)
+class COREARRAY_DLL_LOCAL CBGZF_File
+{
+public:
+	vector<char> Block;  ///< the uncompressed block
+	size_t BlockLen;     ///< the length of uncompressed block
+
+	CBGZF_File(const char *fn)
+	{
+		BlockLen = 0;
+		fp = fopen(fn, "rb");
+		if (!fp)
+			throw ErrSeqArray("Cannot open '%s'.", fn);
+		memset(&zs, 0, sizeof(zs));
+		if (inflateInit2(&zs, -15) != Z_OK)
+		{
+			fclose(fp);
+			throw ErrSeqArray("Fails to initialize zlib.");
+		}
+		Block.resize(BGZF_BLOCK_SIZE);
+		CBlock.resize(BGZF_BLOCK_SIZE);
+	}
+
+	~CBGZF_File()
+	{
+		inflateEnd(&zs);
+		if (fp) fclose(fp);
+	}
+
+	/// return the file size
+	C_Int64 FileSize()
+	{
+		SEQ_FSEEK(fp, 0, SEEK_END);
+		return SEQ_FTELL(fp);
+	}
+
+	/// decompress the block at 'coffset', return the compressed block size,
+	///   0 for the end of file, -1 for an invalid block if 'raise' is false
+	int ReadBlock(C_Int64 coffset, bool raise=true)
+	{
+		BlockLen = 0;
+		C_UInt8 *h = (C_UInt8*)&CBlock[0];
+		if (SEQ_FSEEK(fp, coffset, SEEK_SET) != 0)
+			return Invalid(raise, coffset);
+		size_t n = fread(h, 1, BGZF_HEADER_SIZE, fp);
+		if (n == 0) return 0;
+		if (n < 12) return Invalid(raise, coffset);
+		size_t xlen = get_u16(h + 10);
+		if (12 + xlen > n)
+		{
+			if (12 + xlen > BGZF_BLOCK_SIZE) return Invalid(raise, coffset);
+			n += fread(h + n, 1, 12 + xlen - n, fp);
+		}
+		size_t bsize = BGZF_BlockSize(h, n);
+		size_t hsize = 12 + xlen;
+		if (bsize < hsize + 8 || bsize > BGZF_BLOCK_SIZE)
+			return Invalid(raise, coffset);
+		if (n < bsize)
+		{
+			if (fread(h + n, 1, bsize - n, fp) != bsize - n)
+				return Invalid(raise, coffset);
+		}
 
-		InitText();
+		// inflate
+		inflateReset(&zs);
+		zs.next_in = h + hsize;
+		zs.avail_in = bsize - hsize - 8;
+		zs.next_out = (Bytef*)&Block[0];
+		zs.avail_out = BGZF_BLOCK_SIZE;
+		if (inflate(&zs, Z_FINISH) != Z_STREAM_END)
+			return Invalid(raise, coffset);
+		size_t len = BGZF_BLOCK_SIZE - zs.avail_out;
+		// check CRC32 and ISIZE
+		if (get_u32(h + bsize - 4) != len ||
+				get_u32(h + bsize - 8) != crc32(0L, (Bytef*)&Block[0], len))
+			return Invalid(raise, coffset);
+
+		BlockLen = len;
+		return bsize;
+	}
 
-		if (!Rf_isNull(progfile))
+	/// return the offset of the first valid block at or after 'coffset',
+	///   or the file size if no block is found
+	C_Int64 FindBlock(C_Int64 coffset, C_Int64 file_size)
+	{
+		vector<C_UInt8> buf(BGZF_BLOCK_SIZE + BGZF_HEADER_SIZE);
+		while (coffset < file_size)
 		{
-			while (!VCF_EOF())
+			SEQ_FSEEK(fp, coffset, SEEK_SET);
+			size_t n = fread(&buf[0], 1, buf.size(), fp);
+			if (n < BGZF_HEADER_SIZE) break;
+			for (size_t i=0; i+BGZF_HEADER_SIZE <= n; i++)
 			{
-				GetText(NA_INTEGER);
-				if (strncmp(Text_pBegin, "#CHROM", 6) == 0)
+				if (buf[i]==31 && buf[i+1]==139 &&
+					BGZF_BlockSize(&buf[i], n-i) > 0)
 				{
-					SkipLine();
-					break;
+					// a random match in the compressed data is excluded by
+					//   decompression, CRC32 and the next block header
+					int sz = ReadBlock(coffset + i, false);
+					if (sz > 0)
+					{
+						C_Int64 next = coffset + i + sz;
+						if (next >= file_size) return coffset + i;
+						C_UInt8 h[BGZF_HEADER_SIZE];
+						SEQ_FSEEK(fp, next, SEEK_SET);
+						size_t m = fread(h, 1, BGZF_HEADER_SIZE, fp);
+						if (BGZF_BlockSize(h, m) > 0) return coffset + i;
+					}
 				}
 			}
+			coffset += n - BGZF_HEADER_SIZE + 1;
+		}
+		return file_size;
+	}
+
+private:
+	FILE *fp;
+	z_stream zs;
+	vector<char> CBlock;  ///< the compressed block
+
+	inline int Invalid(bool raise, C_Int64 coffset)
+	{
+		if (raise)
+			throw ErrSeqArray("Invalid BGZF block at the offset %lld.",
+				(long long)coffset);
+		return -1;
+	}
+};
+
+
+/// a BGZF file read from a starting virtual offset to an ending virtual
+///   offset, a virtual offset is (compressed block offset, uncompressed offset)
+class COREARRAY_DLL_LOCAL CBGZF_Stream: public CBGZF_File
+{
+public:
+	/// end_coffset < 0 for the end of file
+	CBGZF_Stream(const char *fn, C_Int64 start_coffset, int start_uoffset,
+		C_Int64 end_coffset, int end_uoffset): CBGZF_File(fn)
+	{
+		StartCOff = start_coffset; StartUOff = start_uoffset;
+		EndCOff = end_coffset; EndUOff = end_uoffset;
+		CurCOff = start_coffset; CurSize = 0;
+		Pos = Limit = 0;
+		Finished = false;
+	}
+
+	string ErrMsg;  ///< the error message when reading
+
+	/// read at most 'n' bytes without throwing an exception, since it is
+	///   called from R connections, the error is raised when closing
+	size_t SafeRead(char *buf, size_t n)
+	{
+		if (!ErrMsg.empty()) return 0;
+		try {
+			return Read(buf, n);
+		} catch (std::exception &E) {
+			ErrMsg = E.what();
+		}
+		return 0;
+	}
+
+	/// read at most 'n' bytes, return the number of bytes
+	size_t Read(char *buf, size_t n)
+	{
+		size_t rv = 0;
+		while (n > 0)
+		{
+			if (Pos >= Limit)
+			{
+				if (!NextBlock()) break;
+				continue;
+			}
+			size_t m = Limit - Pos;
+			if (m > n) m = n;
+			memcpy(buf, &Block[Pos], m);
+			buf += m; n -= m; Pos += m; rv += m;
 		}
+		return rv;
+	}
 
-		while (!VCF_EOF() && (variant_index+1 < variant_start))
+private:
+	C_Int64 StartCOff;  ///< the starting block offset
+	int StartUOff;      ///< the starting offset in the uncompressed block
+	C_Int64 EndCOff;    ///< the ending block offset, -1 for the end of file
+	int EndUOff;        ///< the ending offset in the uncompressed block
+	C_Int64 CurCOff;    ///< the offset of the current block
+	int CurSize;        ///< the compressed size of the current block
+	size_t Pos;         ///< the position in the current block
+	size_t Limit;       ///< the end position in the current block
+	bool Finished;      ///< true if reaching the end
+
+	bool NextBlock()
+	{
+		if (Finished) return false;
+		C_Int64 c = StartCOff;
+		if (CurSize > 0)
 		{
-			variant_index ++;
-			SkipLine();
+			if ((EndCOff >= 0) && (CurCOff >= EndCOff))
+				{ Finished = true; return false; }
+			c = CurCOff + CurSize;
 		}
+		int sz = ReadBlock(c);
+		if (sz <= 0)
+			{ Finished = true; return false; }
+		Pos = (CurSize > 0) ? 0 : StartUOff;
+		CurCOff = c; CurSize = sz;
+		Limit = BlockLen;
+		if ((EndCOff >= 0) && (CurCOff >= EndCOff) && (Limit > (size_t)EndUOff))
+			Limit = EndUOff;
+		if (Pos > Limit) Pos = Limit;
+		return true;
+	}
+};
 
 
-		// =========================================================
-		// parse the context
+/// get the virtual offsets of records from a tabix (.tbi) or CSI (.csi) index
+static void BGZF_IndexOffset(const char *fn, vector<C_UInt64> &voff)
+{
+	// load the whole index file
+	vector<C_UInt8> buf;
+	{
+		CBGZF_File f(fn);
+		C_Int64 coff = 0;
+		int sz;
+		while ((sz = f.ReadBlock(coff)) > 0)
+		{
+			buf.insert(buf.end(), f.Block.begin(), f.Block.begin() + f.BlockLen);
+			coff += sz;
+		}
+	}
 
-		// progress information
-		CProgress Progress(variant_index - variant_start + 1, variant_count,
-			progfile, true);
+	const C_UInt8 *p = buf.empty() ? NULL : &buf[0], *e = p + buf.size();
+	#define NEED(n)    if ((size_t)(e - p) < (size_t)(n)) throw ErrSeqArray("Invalid index file '%s'.", fn);
+	NEED(8);
+	bool is_tbi = (memcmp(p, "TBI\1", 4) == 0);
+	bool is_csi = (memcmp(p, "CSI\1", 4) == 0);
+	if (!is_tbi && !is_csi)
+		throw ErrSeqArray("Invalid index file '%s'.", fn);
+	size_t n_ref;
+	if (is_tbi)
+	{
+		n_ref = get_u32(p + 4);
+		NEED(36);
+		p += 36 + get_u32(p + 32);  // skip the names
+	} else {
+		NEED(16);
+		p += 16 + get_u32(p + 12);  // skip the auxiliary data
+		NEED(4);
+		n_ref = get_u32(p); p += 4;
+	}
 
-		while (!VCF_EOF())
+	for (size_t r=0; r < n_ref; r++)
+	{
+		NEED(4);
+		size_t n_bin = get_u32(p); p += 4;
+		for (size_t b=0; b < n_bin; b++)
 		{
-			// -----------------------------------------------------
-			// column 1: CHROM
-			GetText(FALSE);
+			NEED(is_tbi ? 8 : 16);
+			p += is_tbi ? 4 : 12;  // bin and loffset
+			size_t n_chunk = get_u32(p); p += 4;
+			NEED(n_chunk * 16);
+			for (size_t k=0; k < n_chunk; k++, p += 16)
+				voff.push_back(get_u64(p));  // the beginning of chunk
+		}
+		if (is_tbi)
+		{
+			NEED(4);
+			size_t n_intv = get_u32(p); p += 4;
+			NEED(n_intv * 8);
+			for (size_t k=0; k < n_intv; k++, p += 8)
+				voff.push_back(get_u64(p));
+		}
+	}
+	#undef NEED
 
-			// -----------------------------------------------------
-			// variant id
-			variant_index ++;
-			if (variant_count >= 0)
+	std::sort(voff.begin(), voff.end());
+	voff.erase(std::unique(voff.begin(), voff.end()), voff.end());
+}
+
+
+/// return true, if the virtual offset is the start of a line
+static bool BGZF_IsLineStart(CBGZF_File &f, C_UInt64 voff)
+{
+	C_Int64 c = voff >> 16;
+	size_t u = voff & 0xFFFF;
+	if (f.ReadBlock(c, false) <= 0) return false;
+	if (u == 0) return true;
+	return (u <= f.BlockLen) && (f.Block[u-1] == '\n');
+}
+
+
+/// split the data lines of a BGZF file into 'num' parts by compressed blocks,
+///   return the starting virtual offsets of all parts
+static void BGZF_Split(const char *fn, int num, const char *index_fn,
+	vector<C_UInt64> &start)
+{
+	CBGZF_File f(fn);
+	const C_Int64 fsize = f.FileSize();
+	start.clear();
+
+	// the first data line after the header
+	{
+		C_Int64 coff = 0;
+		bool bol = true;
+		int sz;
+		while (start.empty() && (sz = f.ReadBlock(coff)) > 0)
+		{
+			for (size_t i=0; i < f.BlockLen; i++)
 			{
-				if (variant_index >= variant_start+variant_count)
+				char ch = f.Block[i];
+				if (bol && ch != '#')
 				{
-					variant_index --;
+					start.push_back((C_UInt64(coff) << 16) | i);
 					break;
 				}
+				bol = (ch == '\n');
 			}
-			I32 = variant_index;
-			GDS_Array_AppendData(varIdx, 1, &I32, svInt32);
+			coff += sz;
+		}
+	}
+	if (start.empty() || num <= 1) return;
+
+	// the starting positions of records in the index file
+	vector<C_UInt64> cand;
+	if (index_fn) BGZF_IndexOffset(index_fn, cand);
 
-			// column 1: CHROM
-			for (vector<const char *>::iterator p=ChrPref.begin(); p != ChrPref.end(); p++)
+	// split by the compressed size
+	const C_Int64 st = start[0] >> 16;
+	for (int k=1; k < num; k++)
+	{
+		const C_Int64 target = st + (C_Int64)((double)(fsize - st) * k / num);
+		const C_Int64 next_target = st + (C_Int64)((double)(fsize - st) * (k+1) / num);
+		const C_UInt64 last = start.back();
+		C_UInt64 v = 0;
+		bool ok = false;
+
+		// use the index if possible
+		vector<C_UInt64>::iterator it = std::lower_bound(cand.begin(),
+			cand.end(), C_UInt64(target) << 16);
+		while ((it != cand.end()) && (*it <= last)) it ++;
+		if ((it != cand.end()) && (C_Int64(*it >> 16) < next_target) &&
+				BGZF_IsLineStart(f, *it))
+			{ v = *it; ok = true; }
+
+		// find the next block and the first line in it
+		if (!ok)
+		{
+			C_Int64 c = f.FindBlock(target, fsize);
+			int sz;
+			while (!ok && (c < fsize) && (sz = f.ReadBlock(c)) > 0)
 			{
-				if (StrCaseCmp(*p, Text_pBegin, Text_pEnd-Text_pBegin))
+				const char *s = &f.Block[0];
+				const char *p = (const char*)memchr(s, '\n', f.BlockLen);
+				if (p)
 				{
-					Text_pBegin += strlen(*p);
-					break;
-				}
+					size_t u = p - s + 1;
+					v = (u < f.BlockLen) ? ((C_UInt64(c) << 16) | u) :
+						(C_UInt64(c + sz) << 16);
+					ok = true;
+				} else
+					c += sz;
 			}
-			GDS_Array_AppendStrLen(varChr, Text_pBegin, Text_pEnd-Text_pBegin);
-
-
-			// -----------------------------------------------------
-			// column 2: POS
-			GetText(FALSE);
-			I32 = getInt32(Text_pBegin, Text_pEnd);
-			GDS_Array_AppendData(varPos, 1, &I32, svInt32);
-
-
-			// -----------------------------------------------------
-			// column 3: ID
-			GetText(FALSE);
-			SkipTextWithDot();
-			GDS_Array_AppendStrLen(varRSID, Text_pBegin, Text_pEnd-Text_pBegin);
+		}
 
+		// not empty
+		if (ok && (v > last) && (C_Int64(v >> 16) < fsize) &&
+				(f.ReadBlock(v >> 16, false) > 0) && (f.BlockLen > (v & 0xFFFF)))
+			start.push_back(v);
+	}
+}
 
-			// -----------------------------------------------------
-			// column 4 & 5: REF + ALT 
-			GetText(FALSE);  // REF
-			SkipWhiteSpace();
-			cell.assign(Text_pBegin, Text_pEnd);
 
-			GetText(FALSE);  // ALT
-			SkipTextWithDot();
-			if (Text_pEnd > Text_pBegin)
-			{
-				cell.push_back(',');
-				cell.append(Text_pBegin, Text_pEnd);
-			}
 
-			GDS_Array_AppendData(varAllele, 1, &cell, svStrUTF8);
+// ===========================================================
+// BCF2 files
+// ===========================================================
 
-			// determine how many alleles
-			int num_allele;
-			if (cell != "." && cell != ".,.")
+/// get the value of 'key' in a structured meta-information line, e.g.,
+///   ##INFO=<ID=DP,Number=1,Type=Integer,Description="...">
+static bool BCF_HeaderValue(const char *s, const char *end, const char *key,
+	string &val)
+{
+	const char *p = (const char*)memchr(s, '<', end - s);
+	if (!p) return false;
+	p ++;
+	const size_t nk = strlen(key);
+	while (p < end)
+	{
+		const char *k = p;
+		while ((p < end) && (*p != '=') && (*p != ',') && (*p != '>')) p ++;
+		const bool hit = ((size_t)(p - k) == nk) && (memcmp(k, key, nk) == 0);
+		val.clear();
+		if ((p < end) && (*p == '='))
+		{
+			p ++;
+			if ((p < end) && (*p == '"'))
 			{
-				num_allele = 0;
-				for (const char *p = cell.c_str(); *p; )
+				// quoted text with escapes
+				for (p++; (p < end) && (*p != '"'); p++)
 				{
-					num_allele ++;
-					while (*p && (*p != ',')) p ++;
-					if (*p == ',') p ++;
+					if ((*p == '\\') && (p+1 < end)) p ++;
+					val.push_back(*p);
 				}
+				if (p < end) p ++;
 			} else {
-				num_allele = INT_MAX;
+				while ((p < end) && (*p != ',') && (*p != '>'))
+					val.push_back(*p++);
 			}
+		}
+		if (hit) return true;
+		if ((p < end) && (*p == ','))
+			p ++;
+		else
+			break;
+	}
+	return false;
+}
 
 
-			// -----------------------------------------------------
-			// column 6: QUAL
-			GetText(FALSE);
-			F64 = getFloat(Text_pBegin, Text_pEnd);
-			GDS_Array_AppendData(varQual, 1, &F64, svFloat64);
-
-
-			// -----------------------------------------------------
-			// column 7: FILTER
-			GetText(FALSE);
-			SkipTextWithDot();
-			if (Text_pBegin < Text_pEnd)
-			{
-				cell.assign(Text_pBegin, Text_pEnd);
-				vector<string>::iterator p =
-					std::find(filter_list.begin(), filter_list.end(), cell);
-				if (p == filter_list.end())
-				{
-					filter_list.push_back(cell);
-					I32 = filter_list.size();
-				} else
-					I32 = p - filter_list.begin() + 1;
-			} else
-				I32 = NA_INTEGER;
-			GDS_Array_AppendData(varFilter, 1, &I32, svInt32);
-
+/// a BCF2 file (BGZF-compressed or uncompressed), the records are read
+///   sequentially
+class COREARRAY_DLL_LOCAL CBCF_Reader
+{
+public:
+	TBCF_Dict Dict;       ///< the dictionaries
+	string Header;        ///< the header text
+	size_t NumSample;     ///< the number of samples in the header
+	C_Int64 RecordNum;    ///< the number of records read
+	C_Int64 CurRecord;    ///< the current record written, used in the error message
 
-			// -----------------------------------------------------
-			// column 8: INFO
+	CBCF_Reader()
+	{
+		Stream = NULL; File = NULL;
+		NumSample = 0; RecordNum = CurRecord = 0;
+	}
+	~CBCF_Reader() { Close(); }
 
-		#if (GDS_TIMING == 3)
-			start_timing();
-		#endif
+	/// open the file, read the header and the dictionaries
+	void Open(const char *fn)
+	{
+		Close();
+		File = fopen(fn, "rb");
+		if (!File)
+			throw ErrSeqArray("Cannot open '%s'.", fn);
+		C_UInt8 h[2];
+		if ((fread(h, 1, 2, File) == 2) && (h[0] == 31) && (h[1] == 139))
+		{
+			fclose(File); File = NULL;
+			Stream = new CBGZF_Stream(fn, 0, 0, -1, 0);
+		} else
+			rewind(File);
+
+		// magic string and the header text
+		C_UInt8 b[9];
+		if ((Read(b, 9) != 9) || (memcmp(b, "BCF\2", 4) != 0))
+			throw ErrSeqArray("'%s' is not a BCF2 file.", fn);
+		Header.resize(get_u32(b + 5));
+		if (!Header.empty())
+			ReadExact(&Header[0], Header.size());
+		while (!Header.empty() && (Header[Header.size()-1] == 0))
+			Header.resize(Header.size() - 1);
+		InitDict();
+		RecordNum = CurRecord = 0;
+	}
 
-			// initialize
-			for (pI = info_list.begin(); pI != info_list.end(); pI++)
-				pI->used = false;
-			GetText(SampleNum<=0);
-			SkipTextWithDot();
+	/// close the file
+	void Close()
+	{
+		if (Stream) { delete Stream; Stream = NULL; }
+		if (File) { fclose(File); File = NULL; }
+	}
 
-			// parse
-			while (Text_pBegin < Text_pEnd)
+	/// map the dictionaries to the INFO and FORMAT lists, and remove the
+	///   chromosome prefix
+	void InitParam(const TVCF_Param &param)
+	{
+		const size_t n = Dict.Str.size();
+		Dict.Info.assign(n, -1);
+		Dict.Format.assign(n, -1);
+		Dict.Geno = -1;
+		for (size_t i=0; i < n; i++)
+		{
+			const string &s = Dict.Str[i];
+			if (s.empty()) continue;
+			Dict.Info[i] = param.info_hash.Find(s.data(), s.size());
+			Dict.Format[i] = param.format_hash.Find(s.data(), s.size());
+			if ((s == param.geno_id) && (Dict.Geno < 0))
+				Dict.Geno = i;
+		}
+		for (size_t i=0; i < Dict.Contig.size(); i++)
+		{
+			string &s = Dict.Contig[i];
+			for (vector<const char *>::const_iterator p=param.chr_prefix.begin();
+				p != param.chr_prefix.end(); p++)
 			{
-				// format: name=val | name
-				char *s, *p;
-				s = p = Text_pBegin;
-				while ((p < Text_pEnd) && (*p != ';') && (*p != '='))
-					p ++;
-				Text_pBegin = p;
-
-				// variable name
-				while ((s < p) && (*(p-1) == ' ')) p --;
-				cell.assign(s, p);
-
-				// variable value
-				char *ValBegin, *ValEnd;
-				ValBegin = ValEnd = p = Text_pBegin;
-				if (p < Text_pEnd)
+				if (StrCaseCmp(*p, s.c_str(), s.size()))
 				{
-					if (*p == '=')
-					{
-						p ++;
-						while ((p < Text_pEnd) && (*p == ' ')) p ++;
-						ValBegin = p;
-						while ((p < Text_pEnd) && (*p != ';')) p ++;
-						Text_pBegin = p;
-						if (p < Text_pEnd) Text_pBegin ++;
-						while ((ValBegin < p) && (*(p-1) == ' ')) p --;
-						ValEnd = p;
-					} else if (*p == ';')
-						Text_pBegin = p + 1;
-					else
-						Text_pBegin = p;
+					s.erase(0, strlen(*p));
+					break;
 				}
+			}
+		}
+	}
 
-				for (pI=info_list.begin(); pI != info_list.end(); pI++)
-				{
-					if (pI->name == cell)
-						break;
-				}
+	/// append the next record to 'buf', return false if it is the end of file
+	bool Next(vector<char> &buf, size_t &shared_len, size_t &len)
+	{
+		C_UInt8 b[8];
+		size_t n = Read(b, 8);
+		if (n == 0) return false;
+		if (n < 8) throw ErrSeqArray(ERR_BCF_TRUNCATED);
+		shared_len = get_u32(b);
+		len = shared_len + (size_t)get_u32(b + 4);
+		const size_t st = buf.size();
+		buf.resize(st + len);
+		if (len > 0) ReadExact(&buf[st], len);
+		RecordNum ++;
+		return true;
+	}
+
+	/// skip the next record, return false if it is the end of file
+	bool Skip()
+	{
+		size_t shared_len, len;
+		Buffer.clear();
+		return Next(Buffer, shared_len, len);
+	}
 
-				if (pI != info_list.end())
+	/// get the genotypes in the first FORMAT field of the next record as
+	///   text (e.g., 0|1), return false if there is no record
+	bool NextGenoText(vector<string> &txt)
+	{
+		size_t shared_len, len;
+		Buffer.clear();
+		txt.clear();
+		if (!Next(Buffer, shared_len, len)) return false;
+		if ((shared_len < 24) || (len < shared_len))
+			throw ErrSeqArray(ERR_BCF_TRUNCATED);
+		const C_UInt8 *p = (const C_UInt8*)&Buffer[0];
+		const size_t n_sample = get_u32(p + 20) & 0xFFFFFF;
+		const size_t n_fmt = get_u32(p + 20) >> 24;
+		if (n_fmt <= 0) return true;
+
+		const C_UInt8 *end = p + len, *v;
+		p += shared_len;
+		BCF_TypedInt(p, end);  // key
+		size_t num;
+		const int type = BCF_TypedVec(p, end, num, v, n_sample);
+		if ((type < BCF_BT_INT8) || (type > BCF_BT_INT32)) return true;
+		const int sz = BCF_TypeSize(type);
+		char buf[32];
+		for (size_t si=0; si < n_sample; si++, v += num*sz)
+		{
+			string s;
+			for (size_t k=0; k < num; k++)
+			{
+				C_Int32 g = BCF_GetInt(v + k*sz, type);
+				if (g == BCF_INT_END) break;
+				if (g == NA_INTEGER) g = 0;
+				if (k > 0) s.push_back((g & 0x01) ? '|' : '/');
+				if ((g >> 1) > 0)
 				{
-					// it is in the list of INFO variables
-					if (pI->used)
-					{
-						Rf_warning("LINE: %d, ignore duplicated INFO ID (%s).",
-							VCF_LineNum, cell.c_str());
-						continue;
-					}
+					snprintf(buf, sizeof(buf), "%d", (g >> 1) - 1);
+					s.append(buf);
+				} else
+					s.push_back('.');
+			}
+			txt.push_back(s);
+		}
+		return true;
+	}
 
-					if (pI->import_flag)
-					{
-						switch (pI->type)
-						{
-						case FIELD_TYPE_INT:
-							getInt32Array(ValBegin, ValEnd, I32s);
-							pI->Index(I32s, num_allele, NA_INTEGER);
-							GDS_Array_AppendData(pI->data_obj, I32s.size(),
-								&(I32s[0]), svInt32);
-							break;
+	// the source of data lines, used in VCF_ParseWrite()
 
-						case FIELD_TYPE_FLOAT:
-							getFloatArray(ValBegin, ValEnd, F64s);
-							pI->Index(F64s, num_allele, R_NaN);
-							GDS_Array_AppendData(pI->data_obj, F64s.size(),
-								&(F64s[0]), svFloat64);
-							break;
+	/// the records are read by a worker thread, no use of R API
+	static const bool THREAD_READ = true;
 
-						case FIELD_TYPE_FLAG:
-							if (ValBegin < ValEnd)
-							{
-								throw ErrSeqArray(
-									"INFO ID '%s' should be a flag without values.",
-									cell.c_str());
-							}
-							I32 = 1;
-							GDS_Array_AppendData(pI->data_obj, 1, &I32, svInt32);
-							break;
+	void ReadChunk(TVCF_Chunk &chunk, C_Int64 max_line, const CVCF_GDSWriter &W)
+	{
+		chunk.Text.clear();
+		chunk.NumLine = 0;
+		while ((C_Int64)chunk.NumLine < max_line)
+		{
+			if (chunk.NumLine >= chunk.Lines.size())
+			{
+				chunk.Lines.push_back(TVCF_Line());
+				chunk.Lines.back().Info = W.InfoList;
+				chunk.Lines.back().Format = W.FormatList;
+			}
+			TVCF_Line &L = chunk.Lines[chunk.NumLine];
+			L.TextStart = chunk.Text.size();
+			if (!Next(chunk.Text, L.SharedLen, L.TextLen)) break;
+			L.LineNum = RecordNum;
+			chunk.NumLine ++;
+			if (chunk.Text.size() >= VCF_CHUNK_SIZE) break;
+		}
+	}
+	inline void Parse(TVCF_Line &L, char *text, const TVCF_Param &param) const
+	{
+		L.Parse(text, param, &Dict);
+	}
+	inline void SetLine(const TVCF_Line &L)
+	{
+		CurRecord = L.LineNum;
+	}
 
-						case FIELD_TYPE_STRING:
-							getStringArray(ValBegin, ValEnd, S8s);
-							pI->Index(S8s, num_allele, BlankString);
-							GDS_Array_AppendData(pI->data_obj, S8s.size(),
-								&(S8s[0]), svStrUTF8);
-							break;
+private:
+	CBGZF_Stream *Stream;  ///< BGZF-compressed, or NULL
+	FILE *File;            ///< uncompressed, or NULL
+	vector<char> Buffer;   ///< the buffer of a record
 
-						default:
-							throw ErrSeqArray("Invalid INFO Type.");
-						}
-					}
+	inline size_t Read(void *buf, size_t n)
+	{
+		if (Stream)
+			return Stream->Read((char*)buf, n);
+		else
+			return fread(buf, 1, n, File);
+	}
 
-					pI->used = true;
-				} else {
-					set<string>::iterator it = info_missing.find(cell);
-					if (it == info_missing.end())
-					{
-						info_missing.insert(cell);
-						Rf_warning("Unknown INFO ID '%s' is ignored (it should be defined in the meta-information lines).",
-							cell.c_str());
-					}
-				}
-			}
+	inline void ReadExact(void *buf, size_t n)
+	{
+		if (Read(buf, n) != n)
+			throw ErrSeqArray(ERR_BCF_TRUNCATED);
+	}
+
+	/// add an ID to the dictionary, 'idx' is given by IDX= or -1
+	static void DictAdd(vector<string> &D, map<string, int> &M,
+		const string &id, int idx)
+	{
+		if (idx < 0)
+		{
+			if (M.find(id) != M.end()) return;
+			idx = D.size();
+		}
+		if ((size_t)idx >= D.size()) D.resize(idx + 1);
+		D[idx] = id;
+		M[id] = idx;
+	}
 
-			// for which does not exist
-			for (pI = info_list.begin(); pI != info_list.end(); pI++)
+	/// the dictionaries in the order of FILTER/INFO/FORMAT and contig lines,
+	///   PASS is always the first
+	void InitDict()
+	{
+		Dict = TBCF_Dict();
+		map<string, int> str_map, contig_map;
+		DictAdd(Dict.Str, str_map, "PASS", 0);
+		NumSample = 0;
+
+		const char *s = Header.c_str(), *end = s + Header.size();
+		string id, idx;
+		while (s < end)
+		{
+			const char *e = (const char*)memchr(s, '\n', end - s);
+			if (!e) e = end;
+			const char *le = e;
+			if ((le > s) && (*(le-1) == '\r')) le --;
+
+			const bool is_str = (strncmp(s, "##FILTER=<", 10) == 0) ||
+				(strncmp(s, "##INFO=<", 8) == 0) ||
+				(strncmp(s, "##FORMAT=<", 10) == 0);
+			const bool is_contig = (strncmp(s, "##contig=<", 10) == 0);
+			if ((is_str || is_contig) && BCF_HeaderValue(s, le, "ID", id))
 			{
-				if (!pI->used && pI->import_flag)
-				{
-					switch (pI->type)
-					{
-					case FIELD_TYPE_INT:
-						pI->Fill(I32s, NA_INTEGER);
-						break;
-					case FIELD_TYPE_FLOAT:
-						pI->Fill(F64s, R_NaN);
-						break;
-					case FIELD_TYPE_FLAG:
-						I32 = 0;
-						GDS_Array_AppendData(pI->data_obj, 1, &I32, svInt32);
-						break;
-					case FIELD_TYPE_STRING:
-						pI->Fill(S8s, BlankString);
-						break;
-					default:
-						throw ErrSeqArray("Invalid INFO Type.");
-					}
-					pI->used = true;
-				}
+				int i = -1;
+				if (BCF_HeaderValue(s, le, "IDX", idx))
+					i = atoi(idx.c_str());
+				if (is_str)
+					DictAdd(Dict.Str, str_map, id, i);
+				else
+					DictAdd(Dict.Contig, contig_map, id, i);
+			} else if (strncmp(s, "#CHROM", 6) == 0)
+			{
+				// the number of columns after FORMAT
+				size_t n = 1;
+				for (const char *p=s; p < le; p++)
+					if (*p == '\t') n ++;
+				NumSample = (n > 9) ? (n - 9) : 0;
 			}
+			s = e + 1;
+		}
+	}
+};
 
-		#if (GDS_TIMING == 3)
-			end_timing();
-		#endif
 
+}
 
-			// -----------------------------------------------------
-			// column 9: FORMAT
 
-			if (SampleNum <= 0) continue;
+extern "C"
+{
+using namespace SeqArray;
 
-			// initialize
-			for (pF = fmt_ptr.begin(); pF != fmt_ptr.end(); pF++)
-				(*pF)->Init();
-			GetText(FALSE);
+// ===========================================================
+// Get the number of lines in a VCF file
+// ===========================================================
 
-			bool first_fmt_id_flag = true;
-			bool first_fmt_id_is_geno = false;
-			fmt_ptr.clear();
+COREARRAY_DLL_EXPORT SEXP SEQ_VCF_NumLines(SEXP File, SEXP SkipHead)
+{
+	CVCF_Reader VCF;
+	VCF.Init(File);
 
-			// parse
-			while (Text_pBegin < Text_pEnd)
+	if (Rf_asLogical(SkipHead) == TRUE)
+	{
+		VCF.InitText();
+		// get the starting line
+		while (!VCF.IsEOF())
+		{
+			VCF.GetText(NA_INTEGER);
+			if (strncmp(VCF.Text_pBegin, "#CHROM", 6) == 0)
 			{
-				while ((Text_pBegin<Text_pEnd) && (*Text_pBegin==' '))
-					Text_pBegin ++;
+				VCF.SkipLine();
+				break;
+			}
+		}
+		VCF.DoneText();
+	}
 
-				const char *start = Text_pBegin;
-				while ((Text_pBegin<Text_pEnd) && (*Text_pBegin!=':'))
-					Text_pBegin ++;
+	// get the number of left lines
+	C_Int64 n = 0;
+	while (!VCF.IsEOF())
+	{
+		n ++;
+		VCF.SkipLine();
+	}
 
-				const char *end = Text_pBegin;
-				while ((start < end) && (*(end-1) == ' '))
-					end --;
-				cell.assign(start, end);
+	VCF.Done();
+	return ScalarReal(n);
+}
 
-				if ((Text_pBegin<Text_pEnd) && (*Text_pBegin==':'))
-					Text_pBegin ++;
 
-				if (first_fmt_id_flag)
-				{
-					first_fmt_id_flag = false;
-					// genotype ID
-					first_fmt_id_is_geno = (cell == geno_id);
-					if (first_fmt_id_is_geno) continue;
-				}
+// ===========================================================
+// Split a BGZF-compressed VCF file
+// ===========================================================
 
-				// find ID
-				vector<TVCF_Format>::iterator p;
-				for (p=format_list.begin(); p != format_list.end(); p++)
-				{
-					if (p->name == cell)
-						{ p->used = true; break; }
-				}
-				if (p == format_list.end())
-				{
-					set<string>::iterator it = format_missing.find(cell);
-					if (it == format_missing.end())
-					{
-						format_missing.insert(cell);
-						warning("Unknown FORMAT ID '%s' is ignored (it should be defined in the meta-information lines).",
-							cell.c_str());
-					}
-				} else {
-					// push
-					fmt_ptr.push_back(&(*p));
-				}
-			}
+#ifndef R_EOF
+#   define R_EOF    -1
+#endif
 
+/// split the data lines of a BGZF file, return a 4-by-m matrix with the
+///   starting and ending virtual offsets of each part (-1 for the end of file)
+COREARRAY_DLL_EXPORT SEXP SEQ_BGZF_Split(SEXP File, SEXP Num, SEXP IndexFile)
+{
+	const char *fn = CHAR(STRING_ELT(File, 0));
+	const int num = Rf_asInteger(Num);
+	const char *idx_fn = (Rf_length(IndexFile) > 0) ?
+		R_ExpandFileName(CHAR(STRING_ELT(IndexFile, 0))) : NULL;
+	string idx = idx_fn ? idx_fn : "";
 
-			// -----------------------------------------------------
-			// Columns for samples
+	COREARRAY_TRY
 
-			// pointer to genotype buffer
-			C_Int16 *pGeno = &Genotypes[0];
-			// pointer to phase buffer
-			C_Int8 *pPhase = &Phases[0];
+		vector<C_UInt64> start;
+		BGZF_Split(R_ExpandFileName(fn), num,
+			idx.empty() ? NULL : idx.c_str(), start);
 
-			// for-loop
-			for (size_t si=0; si < SampleNum; si ++)
+		const size_t m = start.size();
+		rv_ans = PROTECT(Rf_allocMatrix(REALSXP, 4, m));
+		double *p = REAL(rv_ans);
+		for (size_t i=0; i < m; i++, p+=4)
+		{
+			p[0] = double(start[i] >> 16);
+			p[1] = double(start[i] & 0xFFFF);
+			if (i+1 < m)
 			{
-				// read
-				GetText(si >= (SampleNum-1));
+				p[2] = double(start[i+1] >> 16);
+				p[3] = double(start[i+1] & 0xFFFF);
+			} else
+				p[2] = p[3] = -1;
+		}
+		UNPROTECT(1);
 
-				// skip whitespace
-				while ((Text_pBegin<Text_pEnd) && (*Text_pBegin==' '))
-					Text_pBegin ++;
+	COREARRAY_CATCH
+}
 
-				if (first_fmt_id_is_geno)
-				{
-					// -------------------------------------------------
-					// the first field -- genotypes (GT)
 
-					const char *p = Text_pBegin;
-					while ((Text_pBegin<Text_pEnd) && (*Text_pBegin!=':'))
-						Text_pBegin ++;
-					const char *end = Text_pBegin;
+static void bgzf_range_close(Rconnection con)
+{
+	CBGZF_Stream *s = (CBGZF_Stream*)con->xprivate;
+	char msg[1024] = { 0 };
+	if (s)
+	{
+		if (!s->ErrMsg.empty())
+			strncpy(msg, s->ErrMsg.c_str(), sizeof(msg)-1);
+		delete s;
+		con->xprivate = NULL;
+	}
+	con->isopen = FALSE;
+	// raise the reading error outside the parser
+	if (msg[0]) error("%s", msg);
+}
 
-					if ((Text_pBegin<Text_pEnd) && (*Text_pBegin==':'))
-						Text_pBegin ++;
+static size_t bgzf_range_read(void *ptr, size_t size, size_t nitems,
+	Rconnection con)
+{
+	CBGZF_Stream *s = (CBGZF_Stream*)con->xprivate;
+	if (!s || size <= 0) return 0;
+	return s->SafeRead((char*)ptr, size*nitems) / size;
+}
 
-					I32s.clear(); // genotype extra data
-					I8s.clear(); // phase extra data
-					size_t tmp_num_ploidy = 0;
+static int bgzf_range_fgetc(Rconnection con)
+{
+	unsigned char c;
+	return (bgzf_range_read(&c, 1, 1, con) == 1) ? c : R_EOF;
+}
 
-					while (p < end)
-					{
-						const char *start = p;
-						while ((p<end) && (*p!='|') && (*p!='/'))
-							p ++;
-						C_Int16 g = getGeno(start, p, num_allele);
+/// open a BGZF file as a read-only connection from a virtual offset to another
+COREARRAY_DLL_EXPORT SEXP SEQ_BGZF_Open(SEXP File, SEXP Range)
+{
+	const char *fn = CHAR(STRING_ELT(File, 0));
+	if (!Rf_isReal(Range) || Rf_length(Range) != 4)
+		error("'range' should be a numeric vector of length 4.");
+	const double *r = REAL(Range);
 
-						tmp_num_ploidy ++;
-						if (tmp_num_ploidy <= num_ploidy)
-							*pGeno ++ = g;
-						else
-							I32s.push_back(g);
+	COREARRAY_TRY
 
-						if (p < end)
-						{
-							C_Int8 v = 0;
-							if (*p == '|')
-							{
-								v = 1; p ++;
-							} else if (*p == '/')
-							{
-								v = 0; p ++;
-							}
-							if (tmp_num_ploidy <= num_ploidy_less)
-								*pPhase ++ = v;
-							else
-								I8s.push_back(v);
-						}
-					}
+		Rconnection con;
+		rv_ans = PROTECT(R_new_custom_connection(fn, "rb", "bgzf_range", &con));
+		con->xprivate = new CBGZF_Stream(R_ExpandFileName(fn),
+			(C_Int64)r[0], (int)r[1], (C_Int64)r[2], (int)r[3]);
+		con->isopen = TRUE;
+		con->canread = TRUE;
+		con->canwrite = FALSE;
+		con->text = FALSE;
+		con->close = &bgzf_range_close;
+		con->read = &bgzf_range_read;
+		con->fgetc_internal = &bgzf_range_fgetc;
+		UNPROTECT(1);
+
+	COREARRAY_CATCH
+}
 
-					for (size_t m=tmp_num_ploidy; m < num_ploidy; m++)
-						*pGeno ++ = -1;
-					for (size_t m=tmp_num_ploidy; m < num_ploidy_less; m++)
-						*pPhase ++ = 0;
 
-					// check "genotype/extra", e.g., triploid call: 0/0/1
-					if (!I32s.empty())
-					{
-						GDS_Array_AppendData(varGenoExtra, I32s.size(), &(I32s[0]), svInt32);
-						I32 = si + 1;
-						GDS_Array_AppendData(varGenoExtraIdx, 1, &I32, svInt32);
-						I32 = variant_index - variant_start_index;
-						GDS_Array_AppendData(varGenoExtraIdx, 1, &I32, svInt32);
-						I32 = I32s.size();
-						GDS_Array_AppendData(varGenoExtraIdx, 1, &I32, svInt32);
-					}
 
-					// check "phase/extra", e.g., triploid call: 0/0/1
-					if (varPhase && !I8s.empty())
-					{
-						GDS_Array_AppendData(varPhaseExtra, I8s.size(), &(I8s[0]), svInt8);
-						I32 = si + 1;
-						GDS_Array_AppendData(varPhaseExtraIdx, 1, &I32, svInt32);
-						I32 = variant_index - variant_start_index;
-						GDS_Array_AppendData(varPhaseExtraIdx, 1, &I32, svInt32);
-						I32 = I8s.size();
-						GDS_Array_AppendData(varPhaseExtraIdx, 1, &I32, svInt32);
-					}
-				}
+// ===========================================================
+// Split VCF files
+// ===========================================================
 
-				// -------------------------------------------------
-				// the other field -- format id
-				for (size_t i=0; i < fmt_ptr.size(); i++)
-				{
-					TVCF_Format *pFmt = fmt_ptr[i];
+COREARRAY_DLL_EXPORT SEXP SEQ_VCF_Split(SEXP start, SEXP count, SEXP pnum,
+	SEXP multiple)
+{
+	int num = Rf_asInteger(pnum);
+	if (num <= 0) error("'pnum' should be > 0.");
+	int multi = Rf_asInteger(multiple);
+	if (multi <= 0) error("'multiple' should be > 0.");
+	SEXP ans = PROTECT(NEW_LIST(2));
+	SEXP start_array = PROTECT(NEW_NUMERIC(num));
+	SEXP count_array = PROTECT(NEW_NUMERIC(num));
+	SET_ELEMENT(ans, 0, start_array);
+	SET_ELEMENT(ans, 1, count_array);
 
-					char *start = Text_pBegin;
-					while ((Text_pBegin<Text_pEnd) && (*Text_pBegin!=':'))
-						Text_pBegin ++;
-					char *end = Text_pBegin;
+	double cnt = Rf_asReal(count);
+	double scale = cnt / num;
+	double st = Rf_asReal(start);
+	for (int i=0; i < num; i++)
+	{
+		double old_st = REAL(start_array)[i] = round(st);
+		st += scale;
+		C_Int64 n = (C_Int64)(round(st) - old_st);
+		if (n % multi)  // should be a multiple of 'multi'
+		{
+			int m = ((n / multi) + 1) * multi;
+			st += m - n;
+			n = m;
+		}
+		if ((old_st + n) > (cnt + 1))
+			n = round(cnt + 1 - old_st);
+		REAL(count_array)[i] = (n >= 0) ? n : 0;
+	}
 
-					if ((Text_pBegin<Text_pEnd) && (*Text_pBegin==':'))
-						Text_pBegin ++;
+	UNPROTECT(3);
+	return ans;
+}
 
-					// parse the field
-					if (pFmt && pFmt->import_flag)
-					{
-					#if (GDS_TIMING == 1)
-						start_timing();
-					#endif
 
-						switch (pFmt->type)
-						{
-						case FIELD_TYPE_INT:
-							pFmt->GetInt32s(start, end, si); break;
-						case FIELD_TYPE_FLOAT:
-							pFmt->GetFloats(start, end, si); break;
-						case FIELD_TYPE_STRING:
-							pFmt->GetStrings(start, end, si); break;
-						default:
-							throw ErrSeqArray("Invalid FORMAT Type.");
-						}
-						pFmt->Check(num_allele);
 
-					#if (GDS_TIMING == 1)
-						end_timing();
-					#endif
-					}
-				}
-			}
+// ===========================================================
+// Conversion: VCF --> GDS
+// ===========================================================
 
+/// VCF format --> SeqArray GDS format
+COREARRAY_DLL_EXPORT SEXP SEQ_VCF_Parse(SEXP vcf_fn, SEXP header,
+	SEXP gds_root, SEXP param, SEXP line_cnt, SEXP rho)
+{
+	const char *fn = CHAR(STRING_ELT(vcf_fn, 0));
+	// the reading context, used in the error message
+	CVCF_Reader VCF;
 
-			if (first_fmt_id_is_geno)
-			{
-				// -------------------------------------------------
-				// write genotypes
+	COREARRAY_TRY
 
-				// need to identify num_allele if missing
-				if (num_allele == INT_MAX)
-				{
-					num_allele = 0;
-					C_Int16 *p = &Genotypes[0];
-					for (size_t n=num_samp_ploidy; n > 0; n--, p++)
-					{
-						if ((*p >= 0) && (*p > num_allele))
-							num_allele = *p;
-					}
-					num_allele ++;
-				}
+	#if (GDS_TIMING > 0)
+		_timing_ = 0;
+		clock_t _start_time = clock();
+	#endif
 
-				// determine how many bits
-				int num_bits = 2;
-				// plus ONE for missing value
-				while ((num_allele + 1) > (1 << num_bits))
-					num_bits += 2;
-				I32 = num_bits >> 1;
-				GDS_Array_AppendData(varGenoLen, 1, &I32, svInt32);
+		// =========================================================
+		// initialize variables
 
-				for (int bits=0; bits < num_bits; )
-				{
-					GDS_Array_AppendData(varGeno, num_samp_ploidy, &Genotypes[0],
-						svInt16);
-					bits += 2;
-					if (bits < num_bits)
-						vec_i16_shr_b2(&Genotypes[0], num_samp_ploidy);
-				}
+		// the parameters for parsing
+		TVCF_Param Param;
+		// variant start
+		C_Int64 variant_start = (C_Int64)Rf_asReal(RGetListElement(param, "start"));
+		// variant count
+		C_Int64 variant_count = (C_Int64)Rf_asReal(RGetListElement(param, "count"));
+		// input file
+		VCF.Init(RGetListElement(param, "infile"));
+		// progress file
+		SEXP progfile = RGetListElement(param, "progfile");
+		// whether to skip the header, false if starting from a data line
+		const bool skip_header =
+			(Rf_asLogical(RGetListElement(param, "skip.header")) == TRUE);
+		// the number of threads
+		int NumThread = Rf_asInteger(RGetListElement(param, "threads"));
+		if (NumThread == NA_INTEGER || NumThread < 1) NumThread = 1;
+	#ifndef _OPENMP
+		NumThread = 1;
+	#endif
+		// verbose
+		// bool Verbose = (LOGICAL(RGetListElement(param, "verbose"))[0] == TRUE);
 
-				// -------------------------------------------------
-				// write phase information
+		// GDS nodes, INFO and FORMAT lists, and parameters
+		CVCF_GDSWriter Writer;
+		Writer.Init(header, gds_root, param, Param, (C_Int64)Rf_asReal(line_cnt));
 
-				if (varPhase)
-				{
-					GDS_Array_AppendData(varPhase, num_samp_ploidy_less,
-						&(Phases[0]), svInt8);
-				}
-			}
 
+		// =========================================================
+		// skip the header and data rows
 
-			// -------------------------------------------------
-			// for-loop all format IDs: write
+		VCF.InitText();
 
-		#if (GDS_TIMING == 2)
-			start_timing();
-		#endif
-			for (vector<TVCF_Format>::iterator p = format_list.begin();
-				p != format_list.end(); p ++)
+		if (skip_header)
+		{
+			while (!VCF.IsEOF())
 			{
-				if (p->import_flag) p->SaveToGDS();
+				VCF.GetText(NA_INTEGER);
+				if (strncmp(VCF.Text_pBegin, "#CHROM", 6) == 0)
+				{
+					VCF.SkipLine();
+					break;
+				}
 			}
-		#if (GDS_TIMING == 2)
-			end_timing();
-		#endif
+		}
 
-			// update progress
-			Progress.Forward();
+		C_Int64 variant_index = Writer.VariantIndex;
+		while (!VCF.IsEOF() && (variant_index+1 < variant_start))
+		{
+			variant_index ++;
+			VCF.SkipLine();
 		}
+		Writer.VariantIndex = variant_index;
 
-		// set returned value: levels(filter)
-		PROTECT(rv_ans = NEW_CHARACTER(filter_list.size()));
-		for (int i=0; i < (int)filter_list.size(); i++)
-			SET_STRING_ELT(rv_ans, i, mkChar(filter_list[i].c_str()));
-		nProtected ++;
 
-		REAL(line_cnt)[0] = variant_index;
+		// =========================================================
+		// parse the context
+
+		// progress information
+		CProgress Progress(variant_index - variant_start + 1, variant_count,
+			progfile, true);
+
+		TVCF_TextSource Src(VCF);
+		VCF_ParseWrite(Src, Writer, Param, NumThread, variant_start,
+			variant_count, Progress);
 
-		UNPROTECT(nProtected);
+		// set returned value: levels(filter)
+		rv_ans = Writer.FilterLevels();
+		REAL(line_cnt)[0] = Writer.VariantIndex;
 
-		Done_VCF_Buffer();
-		DoneText();
+		VCF.Done();
+		VCF.DoneText();
 
 
 	#if (GDS_TIMING > 0)
@@ -1885,17 +4006,134 @@ COREARRAY_DLL_EXPORT SEXP SEQ_VCF_Parse(SEXP vcf_fn, SEXP header,
 
 	CORE_CATCH({
 		char buf[4096];
-		if ((VCF_ColumnNum > 0) && (save_pBegin < save_pEnd))
+		if ((VCF.ColumnNum > 0) && (VCF.save_pBegin < VCF.save_pEnd))
 		{
 			snprintf(buf, sizeof(buf),
 				"%s\nFILE: %s\nLINE: %lld, COLUMN: %d, %s\n",
-				GDS_GetError(), fn, (long long int)VCF_LineNum, VCF_ColumnNum,
-				string(save_pBegin, save_pEnd).c_str());
+				GDS_GetError(), fn, (long long int)VCF.LineNum, VCF.ColumnNum,
+				string(VCF.save_pBegin, VCF.save_pEnd).c_str());
 		} else {
 			snprintf(buf, sizeof(buf), "%s\nFILE: %s\nLINE: %lld\n",
-				GDS_GetError(), fn, (long long int)VCF_LineNum);
+				GDS_GetError(), fn, (long long int)VCF.LineNum);
+		}
+		GDS_SetError(buf);
+		VCF.Done();
+		VCF.DoneText();
+		has_error = true;
+	});
+	if (has_error) error(GDS_GetError());
+
+	// output
+	return rv_ans;
+}
+
+
+
+// ===========================================================
+// Conversion: BCF --> GDS
+// ===========================================================
+
+/// get the genotypes of the first record (as text) and the number of
+///   records in a BCF file
+COREARRAY_DLL_EXPORT SEXP SEQ_BCF_Info(SEXP bcf_fn, SEXP getnum)
+{
+	const char *fn = CHAR(STRING_ELT(bcf_fn, 0));
+	const bool get_num = (Rf_asLogical(getnum) == TRUE);
+
+	COREARRAY_TRY
+
+		CBCF_Reader BCF;
+		BCF.Open(fn);
+		vector<string> geno;
+		C_Int64 n = BCF.NextGenoText(geno) ? 1 : 0;
+		if (get_num && (n > 0))
+		{
+			while (BCF.Skip()) n ++;
+		}
+		BCF.Close();
+
+		PROTECT(rv_ans = NEW_LIST(2));
+		SEXP txt = NEW_CHARACTER(geno.size());
+		SET_VECTOR_ELT(rv_ans, 0, txt);
+		for (size_t i=0; i < geno.size(); i++)
+			SET_STRING_ELT(txt, i, mkChar(geno[i].c_str()));
+		SET_VECTOR_ELT(rv_ans, 1, ScalarReal(get_num ? n : R_NaN));
+		SEXP nm = NEW_CHARACTER(2);
+		SET_NAMES(rv_ans, nm);
+		SET_STRING_ELT(nm, 0, mkChar("geno.text"));
+		SET_STRING_ELT(nm, 1, mkChar("num.variant"));
+		UNPROTECT(1);
+
+	COREARRAY_CATCH
+}
+
+
+/// BCF2 format --> SeqArray GDS format, the records are decoded in parallel
+COREARRAY_DLL_EXPORT SEXP SEQ_BCF_Parse(SEXP bcf_fn, SEXP header,
+	SEXP gds_root, SEXP param, SEXP line_cnt, SEXP rho)
+{
+	const char *fn = CHAR(STRING_ELT(bcf_fn, 0));
+	// the reading context, used in the error message
+	CBCF_Reader BCF;
+
+	COREARRAY_TRY
+
+		// the parameters for parsing
+		TVCF_Param Param;
+		// variant start
+		C_Int64 variant_start = (C_Int64)Rf_asReal(RGetListElement(param, "start"));
+		// variant count
+		C_Int64 variant_count = (C_Int64)Rf_asReal(RGetListElement(param, "count"));
+		// progress file
+		SEXP progfile = RGetListElement(param, "progfile");
+		// the number of threads
+		int NumThread = Rf_asInteger(RGetListElement(param, "threads"));
+		if (NumThread == NA_INTEGER || NumThread < 1) NumThread = 1;
+	#ifndef _OPENMP
+		NumThread = 1;
+	#endif
+
+		// GDS nodes, INFO and FORMAT lists, and parameters
+		CVCF_GDSWriter Writer;
+		Writer.Init(header, gds_root, param, Param, (C_Int64)Rf_asReal(line_cnt));
+
+		// open the file and map the dictionaries
+		BCF.Open(fn);
+		if (BCF.NumSample != Param.sample_num)
+		{
+			throw ErrSeqArray("The number of samples (%d) should be %d.",
+				(int)BCF.NumSample, (int)Param.sample_num);
 		}
+		BCF.InitParam(Param);
+
+		// skip the records
+		C_Int64 variant_index = Writer.VariantIndex;
+		while ((variant_index+1 < variant_start) && BCF.Skip())
+			variant_index ++;
+		Writer.VariantIndex = variant_index;
+
+		// progress information
+		CProgress Progress(variant_index - variant_start + 1, variant_count,
+			progfile, true);
+
+		VCF_ParseWrite(BCF, Writer, Param, NumThread, variant_start,
+			variant_count, Progress);
+
+		// set returned value: levels(filter)
+		rv_ans = Writer.FilterLevels();
+		REAL(line_cnt)[0] = Writer.VariantIndex;
+		BCF.Close();
+
+	CORE_CATCH({
+		char buf[4096];
+		if (BCF.CurRecord > 0)
+		{
+			snprintf(buf, sizeof(buf), "%s\nFILE: %s\nRECORD: %lld\n",
+				GDS_GetError(), fn, (long long int)BCF.CurRecord);
+		} else
+			snprintf(buf, sizeof(buf), "%s\nFILE: %s\n", GDS_GetError(), fn);
 		GDS_SetError(buf);
+		BCF.Close();
 		has_error = true;
 	});
 	if (has_error) error(GDS_GetError());
@@ -29,6 +29,376 @@
 
 
 
+// ===========================================================
+// Allele interning
+// ===========================================================
+
+namespace SeqArray
+{
+
+/// the alleles of merged allele lists, interned by a hash table to get the
+///   index of an allele in constant time
+class COREARRAY_DLL_LOCAL CAlleleIndex
+{
+public:
+	CAlleleIndex() { }
+
+	/// remove all alleles
+	void Clear()
+	{
+		for (size_t i=0; i < Slot.size(); i++) Table[Slot[i]] = -1;
+		Slot.clear();
+		Alleles.clear();
+	}
+
+	/// the number of distinct alleles
+	inline size_t Size() const { return Alleles.size(); }
+
+	/// add the alleles in a comma-separated list
+	void AddList(const char *allele_list)
+	{
+		Split(allele_list);
+		for (size_t i=0; i < Pieces.size(); i++)
+			Add(Pieces[i].first, Pieces[i].second);
+	}
+
+	/// get the indices of the alleles in a comma-separated list, -1 if
+	///   not found, return the number of alleles in the list
+	int MapList(const char *allele_list, vector<int> &map)
+	{
+		Split(allele_list);
+		map.resize(Pieces.size());
+		for (size_t i=0; i < Pieces.size(); i++)
+			map[i] = Find(Pieces[i].first, Pieces[i].second);
+		return Pieces.size();
+	}
+
+	/// the number of alleles in a comma-separated list (the same as GetAlleles)
+	int CountList(const char *allele_list)
+	{
+		Split(allele_list);
+		return Pieces.size();
+	}
+
+	/// join the distinct alleles with comma
+	void GetList(string &s) const
+	{
+		s.clear();
+		for (size_t i=0; i < Alleles.size(); i++)
+		{
+			if (i > 0) s.push_back(',');
+			s.append(Alleles[i]);
+		}
+	}
+
+private:
+	vector<string> Alleles;  ///< the distinct alleles in order
+	vector<int> Table;       ///< hash table of allele indices, -1 for empty
+	vector<size_t> Slot;     ///< the used slots in the hash table
+	vector< pair<const char*, size_t> > Pieces;  ///< the split allele list
+
+	inline static size_t Hash(const char *s, size_t n)
+	{
+		C_UInt32 h = 2166136261U;  // FNV-1a
+		for (; n > 0; n--) { h ^= (C_UInt8)(*s++); h *= 16777619U; }
+		return h;
+	}
+
+	/// return the slot of the allele, or an empty slot
+	inline size_t Lookup(const char *s, size_t n) const
+	{
+		const size_t mask = Table.size() - 1;
+		size_t i = Hash(s, n) & mask;
+		while (Table[i] >= 0)
+		{
+			const string &a = Alleles[Table[i]];
+			if (a.size()==n && memcmp(a.data(), s, n)==0) break;
+			i = (i + 1) & mask;
+		}
+		return i;
+	}
+
+	int Find(const char *s, size_t n) const
+	{
+		if (Table.empty()) return -1;
+		return Table[Lookup(s, n)];
+	}
+
+	int Add(const char *s, size_t n)
+	{
+		// keep the load factor <= 0.5
+		if (2*(Alleles.size() + 1) > Table.size())
+		{
+			size_t m = Table.empty() ? 16 : 2*Table.size();
+			Table.assign(m, -1);
+			Slot.clear();
+			for (size_t k=0; k < Alleles.size(); k++)
+			{
+				size_t i = Lookup(Alleles[k].data(), Alleles[k].size());
+				Table[i] = k;
+				Slot.push_back(i);
+			}
+		}
+		size_t i = Lookup(s, n);
+		if (Table[i] < 0)
+		{
+			Table[i] = Alleles.size();
+			Slot.push_back(i);
+			Alleles.push_back(string(s, n));
+		}
+		return Table[i];
+	}
+
+	/// split by comma, the same as GetAlleles()
+	void Split(const char *alleles)
+	{
+		Pieces.clear();
+		const char *p, *s;
+		p = s = alleles;
+		do {
+			if ((*p == 0) || (*p == ','))
+			{
+				Pieces.push_back(pair<const char*, size_t>(s, p - s));
+				if (*p == ',') p ++;
+				s = p;
+				if (*p == 0) break;
+			}
+			p ++;
+		} while (1);
+	}
+};
+
+}
+
+
+
+// ===========================================================
+// Merging genotypes in chunks
+// ===========================================================
+
+namespace SeqArray
+{
+
+/// the maximum number of genotypes in a chunk of merged variants
+static const size_t MERGE_CHUNK_CELL = 1 << 22;
+/// the maximum number of merged variants in a chunk
+static const int MERGE_CHUNK_VARIANT = 1024;
+
+/// a chunk of merged variants, the input genotypes are loaded from the
+///   source files by the worker threads (one thread per file), converted to
+///   the 2-bit planes of the output file by the worker threads, and then
+///   written by the main thread; the alleles of source files are remapped by
+///   the tables built in SEQ_MergeAllele()
+struct COREARRAY_DLL_LOCAL TMergeGenoChunk
+{
+	int Start;   ///< the first merged variant in the chunk (starting from 1)
+	int Num;     ///< the number of merged variants in the chunk
+	vector<string> Allele;   ///< the merged allele lists
+	vector<int> Row;         ///< the variant row in each file (Num x FileCnt), -1 if none
+	vector< vector<const int*> > FileMap;  ///< the allele maps in each file
+	vector< vector<int> > FileGeno;       ///< the genotypes in each file
+	vector<C_Int32> NumPlane;     ///< the number of 2-bit planes of each variant
+	vector< vector<C_Int8> > Planes;  ///< the 2-bit planes of each variant
+	vector<C_BOOL> Warn;     ///< whether out-of-range genotypes (Num x FileCnt)
+	string ErrMsg;           ///< the error message if any
+
+	TMergeGenoChunk() { Start = 1; Num = 0; }
+};
+
+
+/// merge the genotypes of multiple files into the merged variants
+class COREARRAY_DLL_LOCAL CMergeGeno
+{
+public:
+	CMergeGeno(SEXP num, SEXP varidx, SEXP files, SEXP export_file,
+		SEXP allele_map)
+	{
+		if (Rf_length(allele_map) != Rf_length(varidx))
+			throw ErrSeqArray("Invalid allele maps in SEQ_MergeGeno.");
+		TotalNum = Rf_asInteger(num);
+		FileCnt  = Rf_length(varidx);
+		Ploidy = INTEGER(num)[2];
+		GenoCnt = (size_t)INTEGER(num)[1] * Ploidy;
+
+		Files.resize(FileCnt);
+		pMap.resize(FileCnt); pMapEnd.resize(FileCnt);
+		pIdx.resize(FileCnt); pIdxEnd.resize(FileCnt);
+		for (int i=0; i < FileCnt; i++)
+		{
+			SEXP idx = VECTOR_ELT(varidx, i);
+			pIdx[i] = INTEGER(idx);
+			pIdxEnd[i] = pIdx[i] + Rf_length(idx);
+			Files[i].Init(GetFileInfo(VECTOR_ELT(files, i)), false);
+			SEXP am = VECTOR_ELT(allele_map, i);
+			pMap[i] = INTEGER(am);
+			pMapEnd[i] = pMap[i] + Rf_length(am);
+			SEXP fn = RGetListElement(VECTOR_ELT(files, i), "filename");
+			FileName.push_back(Rf_isString(fn) ? CHAR(STRING_ELT(fn, 0)) : "");
+		}
+
+		PdGDSFolder Root = GDS_R_SEXP2FileRoot(export_file);
+		Allele  = GDS_Node_Path(Root, "allele", TRUE);
+		GenoVar = GDS_Node_Path(Root, "genotype/data", TRUE);
+		GenoIdx = GDS_Node_Path(Root, "genotype/@data", TRUE);
+		NextVariant = 1;
+	}
+
+	/// prepare the next merged variants and load the merged allele lists
+	///   from the output file (main thread only)
+	void Prepare(TMergeGenoChunk &C, int max_num)
+	{
+		int n = TotalNum - NextVariant + 1;
+		if (n > max_num) n = max_num;
+		if (n < 0) n = 0;
+		C.Start = NextVariant;
+		C.Num = n;
+		NextVariant += n;
+		C.ErrMsg.clear();
+		if (n <= 0) return;
+
+		C_Int32 st = C.Start - 1, cnt = n;
+		C.Allele.resize(n);
+		GDS_Array_ReadData(Allele, &st, &cnt, &C.Allele[0], svStrUTF8);
+
+		C.Row.assign((size_t)n * FileCnt, -1);
+		C.FileMap.resize(FileCnt);
+		C.FileGeno.resize(FileCnt);
+		C.NumPlane.resize(n);
+		C.Planes.resize(n);
+		C.Warn.assign((size_t)n * FileCnt, FALSE);
+	}
+
+	/// load the allele maps and genotypes of the j-th file in the chunk,
+	///   thread-safe for different files (no R API, and each source file is
+	///   only read by one thread)
+	void LoadFile(TMergeGenoChunk &C, int j)
+	{
+		// the variants in this chunk
+		const int end = C.Start + C.Num;
+		C_Int32 m = 0;
+		for (; pIdx[j] < pIdxEnd[j] && *pIdx[j] < end; pIdx[j]++)
+			C.Row[(size_t)(*pIdx[j] - C.Start) * FileCnt + j] = m++;
+		if (m <= 0) return;
+		// allele maps
+		C.FileMap[j].resize(m);
+		for (int k=0; k < m; k++)
+		{
+			const int *p = pMap[j];
+			if (p >= pMapEnd[j])
+				throw ErrSeqArray("internal error in SEQ_MergeGeno");
+			C.FileMap[j][k] = p;
+			pMap[j] += (*p >= 0) ? 1 : (1 - *p);
+			if (pMap[j] > pMapEnd[j])
+				throw ErrSeqArray("internal error in SEQ_MergeGeno");
+		}
+		// genotypes
+		CApply_Variant_Geno &F = Files[j];
+		const size_t size = (size_t)F.SampNum * Ploidy;
+		C.FileGeno[j].resize(size * m);
+		for (int k=0; k < m; )
+		{
+			int r = F.ReadGenoBlock(&C.FileGeno[j][size * k], m - k);
+			if (r <= 0)
+				throw ErrSeqArray("internal error in SEQ_MergeGeno");
+			k += r;
+		}
+	}
+
+	/// convert the k-th variant in the chunk to 2-bit planes (thread-safe),
+	///   'buf' is a per-thread buffer
+	void Process(TMergeGenoChunk &C, int k, vector<int> &buf) const
+	{
+		const string &allele_list = C.Allele[k];
+		buf.resize(GenoCnt);
+		int *pGeno = GenoCnt ? &buf[0] : NULL;
+		for (int j=0; j < FileCnt; j++)
+		{
+			const size_t size = (size_t)Files[j].SampNum * Ploidy;
+			const int r = C.Row[(size_t)k * FileCnt + j];
+			if (r >= 0)
+			{
+				if (size > 0)
+					memcpy(pGeno, &C.FileGeno[j][size * r], sizeof(int) * size);
+				// the allele map, no replacement if the same allele list
+				const int *pm = C.FileMap[j][r];
+				const int nAllele = (*pm >= 0) ? *pm : -*pm;
+				const int *map = (*pm >= 0) ? NULL : (pm + 1);
+				// replace
+				int *p = pGeno;
+				for (size_t m=size; m > 0; m--, p++)
+				{
+					int v = *p;
+					if ((0 <= v) && (v < nAllele))
+					{
+						if (map) *p = map[v];
+					} else if (v != NA_INTEGER)
+					{
+						C.Warn[(size_t)k * FileCnt + j] = TRUE;
+					}
+				}
+			} else
+				vec_int32_set(pGeno, size, NA_INTEGER);
+			pGeno += size;
+		}
+
+		// determine how many bits
+		const int GenoNumBits = 2;
+		const int GenoBitMask = 0x03;
+		int num_allele = GetNumOfAllele(allele_list.c_str());
+		int num_bits = GenoNumBits;
+		while ((num_allele + 1) > (1 << num_bits))
+			num_bits += GenoNumBits;
+		C.NumPlane[k] = num_bits / GenoNumBits;
+
+		// the 2-bit planes
+		vector<C_Int8> &I8s = C.Planes[k];
+		I8s.resize(GenoCnt * C.NumPlane[k]);
+		C_Int8 *s = GenoCnt ? &I8s[0] : NULL;
+		for (int bits=0; bits < num_bits; bits += GenoNumBits)
+		{
+			const int *p = GenoCnt ? &buf[0] : NULL;
+			for (size_t i=0; i < GenoCnt; i++)
+			{
+				int v = *p++;
+				*s++ = (v == NA_INTEGER) ? GenoBitMask :
+					((v >> bits) & GenoBitMask);
+			}
+		}
+	}
+
+	/// append the 2-bit planes of the chunk to the output (main thread only)
+	void Write(const TMergeGenoChunk &C)
+	{
+		if (C.Num <= 0) return;
+		GDS_Array_AppendData(GenoIdx, C.Num, &C.NumPlane[0], svInt32);
+		for (int k=0; k < C.Num; k++)
+		{
+			const vector<C_Int8> &I8s = C.Planes[k];
+			if (!I8s.empty())
+				GDS_Array_AppendData(GenoVar, I8s.size(), &I8s[0], svInt8);
+		}
+	}
+
+	int TotalNum;     ///< the total number of merged variants
+	int FileCnt;      ///< the number of source files
+	int Ploidy;       ///< the number of sets of chromosomes
+	size_t GenoCnt;   ///< the number of genotypes of a merged variant
+	vector<string> FileName;  ///< the file names of source files
+
+private:
+	vector<CApply_Variant_Geno> Files;  ///< the genotype readers
+	vector<int*> pIdx, pIdxEnd;  ///< the current and ending merged indices
+	vector<const int*> pMap, pMapEnd;  ///< the current and ending allele maps
+	PdAbstractArray Allele;      ///< the merged 'allele'
+	PdAbstractArray GenoVar;     ///< the output 'genotype/data'
+	PdAbstractArray GenoIdx;     ///< the output 'genotype/@data'
+	int NextVariant;             ///< the next merged variant to be loaded
+};
+
+}
+
+
+
 // ===========================================================
 // File Merging
 // ===========================================================
@@ -54,7 +424,10 @@ static const C_Int32 ZERO = 0;
 static const C_Int32 ONE  = 1;
 
 
-/// merge alleles from multiple files
+/// merge alleles from multiple files, return the allele maps of each file
+///   used in SEQ_MergeGeno(): for each variant in the file, the number of
+///   alleles if the same allele list as the merged one, otherwise minus the
+///   number of alleles followed by their indices in the merged list
 COREARRAY_DLL_EXPORT SEXP SEQ_MergeAllele(SEXP num, SEXP varidx, SEXP files,
 	SEXP export_var)
 {
@@ -72,38 +445,63 @@ COREARRAY_DLL_EXPORT SEXP SEQ_MergeAllele(SEXP num, SEXP varidx, SEXP files,
 		PdAbstractArray exp_var = GDS_R_SEXP2Obj(export_var, FALSE);
 
 		// for-loop
-		vector<string> vec, vv;
-		string ss, val;
+		CAlleleIndex Index;
+		string ss;
+		vector<string> val(FileCnt);
+		vector<C_BOOL> flag(FileCnt);
+		vector< vector<int> > Map(FileCnt);
+		vector<int> amap;
 		for (int i=1; i <= TotalNum; i++)
 		{
-			vec.clear();
+			Index.Clear();
 			for (int j=0; j < FileCnt; j++)
 			{
-				if (*pIdx[j] == i)  // deal with this variant?
+				flag[j] = (*pIdx[j] == i);
+				if (flag[j])  // deal with this variant?
 				{
 					++ pIdx[j];
-					GDS_Array_ReadData(pVar[j], &pI[j], &ONE, &val, svStrUTF8);
+					GDS_Array_ReadData(pVar[j], &pI[j], &ONE, &val[j], svStrUTF8);
 					++ pI[j];
-					// parse alleles
-					GetAlleles(val.c_str(), vv);
-					for (int k=0; k < (int)vv.size(); k++)
-					{
-						vector<string>::iterator it = find(vec.begin(), vec.end(), vv[k]);
-						if (it == vec.end())
-							vec.push_back(vv[k]);
-					}
+					// add alleles
+					Index.AddList(val[j].c_str());
 				}
 			}
 			// save
-			ss.clear();
-			for (int j=0; j < (int)vec.size(); j++)
+			Index.GetList(ss);
+			GDS_Array_AppendString(exp_var, ss.c_str());
+			// the allele maps
+			for (int j=0; j < FileCnt; j++)
 			{
-				if (j > 0) ss.push_back(',');
-				ss.append(vec[j]);
+				if (!flag[j]) continue;
+				vector<int> &M = Map[j];
+				if (val[j] != ss)
+				{
+					const int n = Index.MapList(val[j].c_str(), amap);
+					M.push_back(-n);
+					for (int k=0; k < n; k++)
+					{
+						if (amap[k] < 0)
+							throw ErrSeqArray("internal error in SEQ_MergeAllele");
+						M.push_back(amap[k]);
+					}
+				} else
+					M.push_back(Index.CountList(val[j].c_str()));
 			}
-			GDS_Array_AppendString(exp_var, ss.c_str());
 		}
 
+		// output
+		rv_ans = PROTECT(NEW_LIST(FileCnt));
+		for (int j=0; j < FileCnt; j++)
+		{
+			vector<int> &M = Map[j];
+			SEXP v = NEW_INTEGER(M.size());
+			SET_ELEMENT(rv_ans, j, v);
+			if (!M.empty())
+				memcpy(INTEGER(v), &M[0], sizeof(int)*M.size());
+			vector<int>().swap(M);
+		}
+		UNPROTECT(1);
+
 	COREARRAY_CATCH
 }
 
@@ -114,111 +512,303 @@ COREARRAY_DLL_EXPORT SEXP SEQ_MergeGeno(SEXP num, SEXP varidx, SEXP files,
 {
 	COREARRAY_TRY
 
-		MERGE_VAR_DEF
+		CMergeGeno Merge(num, varidx, files, export_file,
+			RGetListElement(param, "allele.map"));
+		const int TotalNum = Merge.TotalNum;
 
-		vector<CApply_Variant_Geno> Files(FileCnt);
-		for (int i=0; i < FileCnt; i++)
-			Files[i].Init(GetFileInfo(VECTOR_ELT(files, i)), false);
+		int div = TotalNum / 25;
+		if (div <= 0) div = 1;
+		bool Verbose = (Rf_asLogical(RGetListElement(param, "verbose")) == TRUE);
+		SEXP nt = RGetListElement(param, "threads");
+		int NumThread = Rf_isNull(nt) ? 1 : Rf_asInteger(nt);
+		if (NumThread < 1 || NumThread == NA_INTEGER) NumThread = 1;
 
-		vector<PdAbstractArray> pAllele(FileCnt);
-		for (int i=0; i < FileCnt; i++)
+		// the number of merged variants in a chunk
+		int max_num = 1;
+		if (NumThread > 1)
 		{
-			PdGDSFolder Root = GDS_R_SEXP2FileRoot(VECTOR_ELT(files, i));
-			pAllele[i] = GDS_Node_Path(Root, "allele", TRUE);
+			size_t n = MERGE_CHUNK_CELL / (Merge.GenoCnt > 0 ? Merge.GenoCnt : 1);
+			max_num = (n < (size_t)MERGE_CHUNK_VARIANT) ? (int)n :
+				MERGE_CHUNK_VARIANT;
+			if (max_num < 1) max_num = 1;
 		}
 
-		PdGDSFolder Root = GDS_R_SEXP2FileRoot(export_file);
-		PdAbstractArray allele   = GDS_Node_Path(Root, "allele", TRUE);
-		PdAbstractArray geno_var = GDS_Node_Path(Root, "genotype/data", TRUE);
-		PdAbstractArray geno_idx = GDS_Node_Path(Root, "genotype/@data", TRUE);
+		// a pipeline of three chunks: in each round, the source files of the
+		//   next chunk are read by the worker threads (one thread per file),
+		//   the current chunk is converted by the other threads, and the
+		//   previous chunk is appended to the output file by the main thread;
+		//   progress and warnings are reported after the parallel region
+		//   since the R API is not thread-safe
+		TMergeGenoChunk Chunk[3];
+		TMergeGenoChunk *pRead = &Chunk[0], *pWork = &Chunk[1],
+			*pWrite = &Chunk[2];
+		vector<int> WarnNum(Merge.FileCnt, 0);
+		const int FileCnt = Merge.FileCnt;
+
+		Merge.Prepare(*pWork, max_num);
+		for (int j=0; j < FileCnt; j++)
+			Merge.LoadFile(*pWork, j);
+
+		while (pWork->Num > 0 || pWrite->Num > 0)
+		{
+			Merge.Prepare(*pRead, max_num);
+			const int num_read = (pRead->Num > 0) ? FileCnt : 0;
+			const int num_work = pWork->Num;
+			bool write_fail = false;
+			string write_error;
+
+		#ifdef _OPENMP
+			#pragma omp parallel num_threads(NumThread) if (NumThread > 1)
+		#endif
+			{
+				// append the previous chunk
+			#ifdef _OPENMP
+				#pragma omp master
+			#endif
+				{
+					try {
+						Merge.Write(*pWrite);
+					}
+					catch (std::exception &E) {
+						write_fail = true;
+						write_error = E.what();
+					}
+				}
 
-		// the genotype buffer
-		const int nsamp = INTEGER(num)[1];
-		const int ploidy = INTEGER(num)[2];
-		const int geno_cnt = nsamp * ploidy;
+				// load the next chunk, one thread per file
+			#ifdef _OPENMP
+				#pragma omp for schedule(dynamic) nowait
+			#endif
+				for (int j=0; j < num_read; j++)
+				{
+					try {
+						Merge.LoadFile(*pRead, j);
+					}
+					catch (std::exception &E) {
+					#ifdef _OPENMP
+						#pragma omp critical
+					#endif
+						pRead->ErrMsg = E.what();
+					}
+				}
+
+				// convert the current chunk
+				vector<int> buf;
+			#ifdef _OPENMP
+				#pragma omp for schedule(dynamic) nowait
+			#endif
+				for (int k=0; k < num_work; k++)
+				{
+					try {
+						Merge.Process(*pWork, k, buf);
+					}
+					catch (std::exception &E) {
+					#ifdef _OPENMP
+						#pragma omp critical
+					#endif
+						pWork->ErrMsg = E.what();
+					}
+				}
+			}
 
-		vector<int> geno_buffer(geno_cnt);
-		vector<C_Int8> I8s(geno_cnt);
-		vector<string> ss;
-		vector<int> allele_map;
-		string allele_list, s;
+			if (write_fail)
+				throw ErrSeqArray(write_error);
+			if (!pRead->ErrMsg.empty())
+				throw ErrSeqArray(pRead->ErrMsg);
+			if (!pWork->ErrMsg.empty())
+				throw ErrSeqArray(pWork->ErrMsg);
 
-		int div = TotalNum / 25;
+			// the number of variants with out-of-range genotypes in each file
+			for (int k=0; k < num_work; k++)
+			{
+				const C_BOOL *w = &pWork->Warn[(size_t)k * FileCnt];
+				for (int j=0; j < FileCnt; j++)
+					if (w[j]) WarnNum[j] ++;
+			}
+			if (Verbose)
+			{
+				for (int i=pWrite->Start; i < pWrite->Start+pWrite->Num; i++)
+					if (i % div == 0) Rprintf("<");
+			}
+
+			// the converted variants are written in the next round
+			TMergeGenoChunk *p = pWrite;
+			pWrite = pWork; pWork = pRead; pRead = p;
+		}
+
+		if (Verbose) Rprintf("]");
+
+		// raise one warning per file
+		for (int j=0; j < Merge.FileCnt; j++)
+		{
+			if (WarnNum[j] > 0)
+			{
+				warning("Genotypes out of range in %s variant(s) of File(%d) '%s'.",
+					PrettyInt(WarnNum[j]), j+1, Merge.FileName[j].c_str());
+			}
+		}
+
+	COREARRAY_CATCH
+}
+
+
+/// merge a variable by concatenating the rows of all files without decoding
+///   (the files have the same variants), the index variable with the prefix
+///   '@' is copied from the first file if it exists in the output
+COREARRAY_DLL_EXPORT SEXP SEQ_MergeRows(SEXP files, SEXP varname,
+	SEXP export_file, SEXP param)
+{
+	COREARRAY_TRY
+
+		const int FileCnt = Rf_length(files);
+		const char *VarName = CHAR(STRING_ELT(varname, 0));
+		const string VarName2 = GDS_PATH_PREFIX(VarName, '@');
+
+		// the source variables
+		vector<PdAbstractArray> Node(FileCnt);
+		vector< vector<C_Int32> > Dim(FileCnt);
+		vector<size_t> RowSize(FileCnt);
+		size_t TotalSize = 0;
+		C_Int32 NumRow = 0;
+		for (int j=0; j < FileCnt; j++)
+		{
+			PdGDSFolder Root = GDS_R_SEXP2FileRoot(VECTOR_ELT(files, j));
+			Node[j] = GDS_Node_Path(Root, VarName, TRUE);
+			const int nd = GDS_Array_DimCnt(Node[j]);
+			if (nd < 1)
+				throw ErrSeqArray("Invalid '%s'.", VarName);
+			vector<C_Int32> &D = Dim[j];
+			D.resize(nd);
+			GDS_Array_GetDim(Node[j], &D[0], nd);
+			if (j == 0)
+				NumRow = D[0];
+			else if (D[0] != NumRow)
+				throw ErrSeqArray("'%s' should have the same number of rows.", VarName);
+			RowSize[j] = 1;
+			for (int k=1; k < nd; k++) RowSize[j] *= D[k];
+			TotalSize += RowSize[j];
+		}
+
+		PdGDSFolder Root = GDS_R_SEXP2FileRoot(export_file);
+		PdAbstractArray var = GDS_Node_Path(Root, VarName, TRUE);
+		PdAbstractArray var_idx = GDS_Node_Path(Root, VarName2.c_str(), FALSE);
+		{
+			const int nd = GDS_Array_DimCnt(var);
+			vector<C_Int32> D(nd);
+			if (nd > 0) GDS_Array_GetDim(var, &D[0], nd);
+			size_t size = 1;
+			for (int k=1; k < nd; k++) size *= D[k];
+			if (nd < 1 || size != TotalSize)
+				throw ErrSeqArray("Invalid dimension of '%s' in the output.", VarName);
+		}
+
+		// the data type of buffer, no conversion for bit fields up to 8 bits
+		C_SVType SV = GDS_Array_GetSVType(Node[0]);
+		size_t ElmSize = 0;
+		switch (SV)
+		{
+			case svInt8:  case svUInt8:  ElmSize = 1; break;
+			case svInt16: case svUInt16: ElmSize = 2; break;
+			case svInt32: case svUInt32: case svFloat32: ElmSize = 4; break;
+			case svInt64: case svUInt64: case svFloat64: ElmSize = 8; break;
+			case svCustomInt:
+				if (GDS_Array_GetBitOf(Node[0]) <= 8)
+					{ SV = svInt8; ElmSize = 1; }
+				else
+					{ SV = svInt32; ElmSize = 4; }
+				break;
+			case svCustomUInt:
+				if (GDS_Array_GetBitOf(Node[0]) <= 8)
+					{ SV = svUInt8; ElmSize = 1; }
+				else
+					{ SV = svUInt32; ElmSize = 4; }
+				break;
+			case svStrUTF8: case svStrUTF16: case svCustomStr:
+				SV = svStrUTF8; break;
+			default:
+				SV = svFloat64; ElmSize = 8;
+		}
+		const bool IsStr = (SV == svStrUTF8);
+
+		int div = NumRow / 25;
 		if (div <= 0) div = 1;
-		bool Verbose = (Rf_asLogical(RGetListElement(param, "verbose")) == TRUE);
+		bool Verbose = (Rf_asLogical(RGetListElement(param, "verbose"))==TRUE);
+
+		// the number of rows in a chunk
+		C_Int32 max_row = MERGE_CHUNK_CELL / (TotalSize > 0 ? TotalSize : 1);
+		if (max_row < 1) max_row = 1;
+		vector<C_UInt8> Buf, Out;
+		vector<string> StrBuf, StrOut;
 
 		// for-loop
-		for (int i=1; i <= TotalNum; i++)
+		for (C_Int32 r=0; r < NumRow; )
 		{
-			C_Int32 st = i - 1;
-			GDS_Array_ReadData(allele, &st, &ONE, &allele_list, svStrUTF8);
-			int *pGeno = &(geno_buffer[0]);
+			const C_Int32 n = (NumRow - r < max_row) ? (NumRow - r) : max_row;
+			const size_t out_size = TotalSize * n;
+			if (IsStr) StrOut.resize(out_size); else Out.resize(out_size * ElmSize);
 
+			size_t off = 0;  // the offset of the file in an output row
 			for (int j=0; j < FileCnt; j++)
 			{
-				CApply_Variant_Geno &FILE = Files[j];
-				const size_t size = (size_t)FILE.SampNum * ploidy;
-
-				if (*pIdx[j] == i)  // deal with this variant?
+				const size_t size = RowSize[j];
+				if (size <= 0) continue;
+				vector<C_Int32> st(Dim[j].size(), 0), cn(Dim[j]);
+				st[0] = r; cn[0] = n;
+				if (IsStr)
 				{
-					++ pIdx[j];
-					GDS_Array_ReadData(pAllele[j], &pI[j], &ONE, &s, svStrUTF8);
-					++ pI[j];
-					// parse alleles
-					GetAlleles(s.c_str(), ss);
-					const int nAllele = ss.size();
-					allele_map.resize(nAllele);
-					for (int k=0; k < nAllele; k++)
+					StrBuf.resize(size * n);
+					GDS_Array_ReadData(Node[j], &st[0], &cn[0], &StrBuf[0], SV);
+					for (C_Int32 k=0; k < n; k++)
 					{
-						int x = GetIndexOfAllele(ss[k].c_str(), allele_list.c_str());
-						if (x < 0)
-							throw ErrSeqArray("internal error in SEQ_MergeGeno");
-						allele_map[k] = x;
+						for (size_t i=0; i < size; i++)
+							StrOut[TotalSize*k + off + i].swap(StrBuf[size*k + i]);
 					}
-					FILE.ReadGenoData(pGeno);
-					FILE.Next();
-					// replace
-					size_t m = size;
-					const int *map = &allele_map[0];
-					for (int *p = pGeno; m > 0; m--, p++)
+				} else {
+					Buf.resize(size * n * ElmSize);
+					GDS_Array_ReadData(Node[j], &st[0], &cn[0], &Buf[0], SV);
+					for (C_Int32 k=0; k < n; k++)
 					{
-						int v = *p;
-						if ((0 <= v) && (v < nAllele))
-							*p = map[v];
-						else if (v != NA_INTEGER)
-							warning("Genotype in File(%d), out of range.", j+1);
+						memcpy(&Out[(TotalSize*k + off) * ElmSize],
+							&Buf[size * k * ElmSize], size * ElmSize);
 					}
-				} else
-					vec_int32_set(pGeno, size, NA_INTEGER);
-				pGeno += size;
+				}
+				off += size;
 			}
 
-			// determine how many bits
-			const int GenoNumBits = 2;
-			const int GenoBitMask = 0x03;
-			int num_allele = GetNumOfAllele(allele_list.c_str());
-			int num_bits = GenoNumBits;
-			while ((num_allele + 1) > (1 << num_bits))
-				num_bits += GenoNumBits;
-			C_Int32 I32 = num_bits / GenoNumBits;
-			GDS_Array_AppendData(geno_idx, 1, &I32, svInt32);
-
-			// write to the variable "genotype"
-			for (int bits=0; bits < num_bits; bits += GenoNumBits)
+			// write the rows
+			if (out_size > 0)
 			{
-				int *p = &(geno_buffer[0]);
-				C_Int8 *s = &(I8s[0]);
-				for (int k=0; k < geno_cnt; k++)
-				{
-					int v = *p++;
-					*s++ = (v == NA_INTEGER) ? GenoBitMask :
-						((v >> bits) & GenoBitMask);
-				}
-				GDS_Array_AppendData(geno_var, geno_cnt, &(I8s[0]), svInt8);
+				if (IsStr)
+					GDS_Array_AppendData(var, out_size, &StrOut[0], SV);
+				else
+					GDS_Array_AppendData(var, out_size, &Out[0], SV);
 			}
 
 			if (Verbose)
-				if (i % div == 0) Rprintf("<");
+			{
+				for (C_Int32 i=r+1; i <= r+n; i++)
+					if (i % div == 0) Rprintf("<");
+			}
+			r += n;
+		}
+
+		// copy the index variable
+		if (var_idx)
+		{
+			PdGDSFolder SrcRoot = GDS_R_SEXP2FileRoot(VECTOR_ELT(files, 0));
+			PdAbstractArray src_idx = GDS_Node_Path(SrcRoot, VarName2.c_str(), TRUE);
+			C_Int32 cnt = 0;
+			GDS_Array_GetDim(src_idx, &cnt, 1);
+			vector<C_Int32> I32;
+			for (C_Int32 i=0; i < cnt; )
+			{
+				C_Int32 n = (cnt - i < (C_Int32)MERGE_CHUNK_CELL) ? (cnt - i) :
+					(C_Int32)MERGE_CHUNK_CELL;
+				I32.resize(n);
+				GDS_Array_ReadData(src_idx, &i, &n, &I32[0], svInt32);
+				GDS_Array_AppendData(var_idx, n, &I32[0], svInt32);
+				i += n;
+			}
 		}
 
 		if (Verbose) Rprintf("]");
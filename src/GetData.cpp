@@ -176,21 +176,42 @@ static SEXP get_genotype(CFileInfo &File, TVarMap &Var, void *param)
 		CApply_Variant_Geno NodeVar(File, P->use_raw);
 		// size to be allocated
 		ssize_t SIZE = (ssize_t)nSample * File.Ploidy();
-		if (P->use_raw)
+		// read genotypes block by block
+		if (P->use_raw == USE_RAW_PACKED)
+		{
+			const ssize_t size = NodeVar.PackedGenoSize();
+			rv_ans = PROTECT(allocMatrix(RAWSXP, size, nVariant));
+			C_UInt8 *base = (C_UInt8 *)RAW(rv_ans);
+			for (int n=nVariant; n > 0; )
+			{
+				int m = NodeVar.ReadGenoBlockPacked(base, n);
+				if (m <= 0)
+					throw ErrSeqArray("internal error in reading genotypes by blocks.");
+				base += m * size; n -= m;
+			}
+			UNPROTECT(1);
+			return rv_ans;
+		} else if (P->use_raw)
 		{
 			rv_ans = PROTECT(NEW_RAW(nVariant * SIZE));
 			C_UInt8 *base = (C_UInt8 *)RAW(rv_ans);
-			do {
-				NodeVar.ReadGenoData(base);
-				base += SIZE;
-			} while (NodeVar.Next());
+			for (int n=nVariant; n > 0; )
+			{
+				int m = NodeVar.ReadGenoBlock(base, n);
+				if (m <= 0)
+					throw ErrSeqArray("internal error in reading genotypes by blocks.");
+				base += m * SIZE; n -= m;
+			}
 		} else {
 			rv_ans = PROTECT(NEW_INTEGER(nVariant * SIZE));
 			int *base = INTEGER(rv_ans);
-			do {
-				NodeVar.ReadGenoData(base);
-				base += SIZE;
-			} while (NodeVar.Next());
+			for (int n=nVariant; n > 0; )
+			{
+				int m = NodeVar.ReadGenoBlock(base, n);
+				if (m <= 0)
+					throw ErrSeqArray("internal error in reading genotypes by blocks.");
+				base += m * SIZE; n -= m;
+			}
 		}
 		// return R object
 		SEXP dim = PROTECT(NEW_INTEGER(3));
@@ -228,7 +249,18 @@ static SEXP get_dosage(CFileInfo &File, TVarMap &Var, void *param)
 	{
 		// initialize GDS genotype Node
 		CApply_Variant_Dosage NodeVar(File, false, false);
-		if (P->use_raw)
+		if (P->use_raw == USE_RAW_PACKED)
+		{
+			const ssize_t size = (nSample + 3) / 4;
+			rv_ans = PROTECT(allocMatrix(RAWSXP, size, nVariant));
+			C_UInt8 *base = (C_UInt8 *)RAW(rv_ans);
+			do {
+				NodeVar.ReadDosagePacked(base);
+				base += size;
+			} while (NodeVar.Next());
+			UNPROTECT(1);
+			return rv_ans;
+		} else if (P->use_raw)
 		{
 			rv_ans = PROTECT(allocMatrix(RAWSXP, nSample, nVariant));
 			C_UInt8 *base = (C_UInt8 *)RAW(rv_ans);
@@ -262,7 +294,18 @@ static SEXP get_dosage_alt(CFileInfo &File, TVarMap &Var, void *param)
 	{
 		// initialize GDS genotype Node
 		CApply_Variant_Dosage NodeVar(File, false, true);
-		if (P->use_raw)
+		if (P->use_raw == USE_RAW_PACKED)
+		{
+			const ssize_t size = (nSample + 3) / 4;
+			rv_ans = PROTECT(allocMatrix(RAWSXP, size, nVariant));
+			C_UInt8 *base = (C_UInt8 *)RAW(rv_ans);
+			do {
+				NodeVar.ReadDosagePacked(base);
+				base += size;
+			} while (NodeVar.Next());
+			UNPROTECT(1);
+			return rv_ans;
+		} else if (P->use_raw)
 		{
 			rv_ans = PROTECT(allocMatrix(RAWSXP, nSample, nVariant));
 			C_UInt8 *base = (C_UInt8 *)RAW(rv_ans);
@@ -892,9 +935,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_GetData(SEXP gdsfile, SEXP var_name, SEXP UseRaw,
 	if (nlen <= 0)
 		error("'length(var.name)' should be > 0.");
 	// .useraw
-	if (TYPEOF(UseRaw) != LGLSXP)
-		error("'.useraw' must be logical.");
-	const int use_raw = Rf_asLogical(UseRaw);
+	const int use_raw = GetUseRaw(UseRaw);
 	// .padNA
 	const int padNA = Rf_asLogical(PadNA);
 	if (padNA == NA_LOGICAL)
@@ -945,10 +986,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_BApply_Variant(SEXP gdsfile, SEXP var_name,
 	if (bsize < 1)
 		error("'bsize' must be >= 1.");
 	// .useraw
-	SEXP pam_use_raw = RGetListElement(param, "useraw");
-	if (!Rf_isLogical(pam_use_raw))
-		error("'.useraw' must be TRUE, FALSE or NA.");
-	int use_raw_flag = Rf_asLogical(pam_use_raw);
+	int use_raw_flag = GetUseRaw(RGetListElement(param, "useraw"));
 	// .padNA
 	int padNA = Rf_asLogical(RGetListElement(param, "padNA"));
 	if (padNA == NA_LOGICAL)
@@ -1045,14 +1083,20 @@ COREARRAY_DLL_EXPORT SEXP SEQ_BApply_Variant(SEXP gdsfile, SEXP var_name,
 		}
 
 
-		// local selection
+		// local selection, the previous selection is compressed unless it is
+		//   referred by an active iterator
 		TSelection &Sel = File.Push_Selection(true, false);
+		TSelLock SelLock(Sel);
 		Sel.ClearStructVariant();
 		memset(Sel.pVariant, 0, File.VariantNum());
 
-		C_BOOL *pBase, *pSel, *pEnd;
-		pBase = pSel = Selection.pVariant;
-		pEnd = pBase + File.VariantNum();
+		// the selected variants as runs or a bitmap
+		CSelBitmap LockedSel;
+		if (!Selection.IsCompressed())
+			LockedSel.Set(Selection.pVariant, File.VariantNum());
+		const CSelBitmap &VarSel = Selection.IsCompressed() ?
+			Selection.VarBitmap : LockedSel;
+		size_t pSel = 0;
 
 		// progress object
 		CProgressStdOut progress(NumBlock, 1, prog_flag);
@@ -1065,9 +1109,8 @@ COREARRAY_DLL_EXPORT SEXP SEQ_BApply_Variant(SEXP gdsfile, SEXP var_name,
 			case 1:  // relative
 				INTEGER(R_Index)[0] = idx*bsize + 1; break;
 			case 2:  // absolute
-				while ((pSel < pEnd) && (*pSel == FALSE))
-					pSel ++;
-				INTEGER(R_Index)[0] = pSel - pBase + 1; break;
+				pSel = VarSel.Next(pSel);
+				INTEGER(R_Index)[0] = pSel + 1; break;
 			}
 
 			// assign sub-selection
@@ -1075,24 +1118,13 @@ COREARRAY_DLL_EXPORT SEXP SEQ_BApply_Variant(SEXP gdsfile, SEXP var_name,
 				// clear selection
 				Sel.ClearSelectVariant();
 				// find the first TRUE
-				pSel = VEC_BOOL_FIND_TRUE(pSel, pEnd);
-				Sel.varStart = pSel - pBase;
-				// for-loop
-				C_BOOL *pNewSel = Sel.pVariant;
-				int bs = bsize;
-				for (; bs > 0; bs--)
-				{
-					while ((pSel < pEnd) && (*pSel == FALSE))
-						pSel ++;
-					if (pSel < pEnd)
-					{
-						pNewSel[pSel - pBase] = TRUE;
-						pSel ++;
-					} else
-						break;
-				}
-				Sel.varTrueNum = bsize - bs;
-				Sel.varEnd = pSel - pBase;
+				pSel = VarSel.Next(pSel);
+				Sel.varStart = pSel;
+				// select the next 'bsize' variants
+				size_t num = bsize;
+				pSel = VarSel.Select(pSel, num, Sel.pVariant);
+				Sel.varTrueNum = num;
+				Sel.varEnd = pSel;
 			}
 
 			// load data and call the user-defined function
@@ -1166,6 +1198,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_BApply_Variant(SEXP gdsfile, SEXP var_name,
 			progress.Forward();
 		}
 
+		SelLock.Unlock();
 		File.Pop_Selection();
 
 		// finally
@@ -22,6 +22,7 @@
 #include "Index.h"
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -47,6 +48,119 @@ static const char *ERR_INDEX_VALUE =
 // Indexing object
 // ===========================================================
 
+/// build the checkpoints of a run-length encoding
+template<typename TYPE> static void rle_init_checkpoint(
+	const vector<TYPE> &Values, const vector<C_UInt32> &Lengths,
+	vector<C_Int64> &CkPos, vector<C_Int64> &CkSum)
+{
+	CkPos.clear(); CkSum.clear();
+	const size_t n = Lengths.size();
+	CkPos.reserve(n / INDEX_CHECKPOINT_NRUN + 1);
+	CkSum.reserve(n / INDEX_CHECKPOINT_NRUN + 1);
+	C_Int64 pos = 0, sum = 0;
+	for (size_t i=0; i < n; i++)
+	{
+		if (i % INDEX_CHECKPOINT_NRUN == 0)
+		{
+			CkPos.push_back(pos);
+			CkSum.push_back(sum);
+		}
+		pos += Lengths[i];
+		sum += C_Int64(Values[i]) * Lengths[i];
+	}
+}
+
+/// return true if the position should be moved to the checkpoint 'out_k'
+static inline bool rle_find_checkpoint(const vector<C_Int64> &CkPos,
+	size_t pos, size_t cur_pos, size_t cur_idx, size_t &out_k)
+{
+	if (pos >= cur_pos)
+	{
+		// forward, and no checkpoint between cur_pos and pos
+		size_t k = cur_idx / INDEX_CHECKPOINT_NRUN + 1;
+		if ((k >= CkPos.size()) || (C_Int64(pos) < CkPos[k]))
+			return false;
+	}
+	// binary search
+	out_k = upper_bound(CkPos.begin(), CkPos.end(), C_Int64(pos)) -
+		CkPos.begin() - 1;
+	return true;
+}
+
+
+/// the maximum number of runs spot-checked against the index node
+static const size_t INDEX_RLE_NUM_CHECK = 64;
+
+/// load the run-length encoding stored in a '@@' node, and validate it
+/// against the index node 'IdxObj' (total length, total sum and the values
+/// at the two ends of up to INDEX_RLE_NUM_CHECK runs)
+template<typename TYPE> static bool rle_load(PdContainer Obj,
+	PdAbstractArray IdxObj, C_Int64 data_count, vector<TYPE> &Values,
+	vector<C_UInt32> &Lengths)
+{
+	const C_Int64 idx_count = GDS_Array_GetTotalCount(IdxObj);
+	// header: version, # of runs, total length, total sum (low and high 32 bits),
+	//   MD5 digest of the index node (verified in R, see .stale_rle())
+	const C_Int32 HEADER_SIZE = 13;
+	if (!Obj || (GDS_Array_DimCnt(Obj) != 1)) return false;
+	C_Int64 n = GDS_Array_GetTotalCount(Obj);
+	if (n < HEADER_SIZE) return false;
+	C_Int32 hd[HEADER_SIZE], st=0, cnt=HEADER_SIZE;
+	GDS_Array_ReadData(Obj, &st, &cnt, hd, svInt32);
+	const C_Int64 nrun = hd[1];
+	const C_Int64 sum = C_Int64((C_UInt64(C_UInt32(hd[4])) << 32) | C_UInt32(hd[3]));
+	if ((hd[0] != INDEX_RLE_VERSION) || (nrun < 0) ||
+			(n != HEADER_SIZE + 2*nrun) || (hd[2] != idx_count) ||
+			(sum != data_count))
+		return false;
+
+	// values and lengths
+	vector<C_Int32> buf(2*nrun + 1);
+	st = HEADER_SIZE; cnt = 2*nrun;
+	if (cnt > 0)
+		GDS_Array_ReadData(Obj, &st, &cnt, &buf[0], svInt32);
+	Values.resize(nrun);
+	Lengths.resize(nrun);
+	C_Int64 tot_len=0, tot_sum=0;
+	for (C_Int64 i=0; i < nrun; i++)
+	{
+		C_Int32 v = buf[i], l = buf[nrun + i];
+		if ((v < 0) || (l <= 0)) { tot_len = -1; break; }
+		Values[i] = v; Lengths[i] = l;
+		tot_len += l; tot_sum += C_Int64(v) * l;
+	}
+	bool ok = (tot_len == idx_count) && (tot_sum == data_count);
+
+	// spot-check the content of the index node, since the count and sum
+	// are not changed by a rewrite which only moves values around
+	if (ok && (nrun > 0))
+	{
+		const C_Int64 step = max(nrun / C_Int64(INDEX_RLE_NUM_CHECK), C_Int64(1));
+		const C_Int32 one = 1;
+		C_Int64 p = 0;
+		for (C_Int64 i=0; ok && (i < nrun); i++)
+		{
+			const C_Int64 p_next = p + Lengths[i];
+			if ((i % step == 0) || (i == nrun-1))
+			{
+				C_Int32 s1=p, s2=p_next-1, v1, v2;
+				GDS_Array_ReadData(IdxObj, &s1, &one, &v1, svInt32);
+				GDS_Array_ReadData(IdxObj, &s2, &one, &v2, svInt32);
+				ok = (v1 == C_Int32(Values[i])) && (v2 == C_Int32(Values[i]));
+			}
+			p = p_next;
+		}
+	}
+
+	if (!ok)
+	{
+		Values.clear(); Lengths.clear();
+		return false;
+	}
+	return true;
+}
+
+
 CIndex::CIndex()
 {
 	TotalLength = Position = 0;
@@ -107,6 +221,7 @@ void CIndex::Init(PdContainer Obj, const char *varname)
 	val_max = 0;
 	for (size_t i=0; i < Values.size(); i++)
 		if (Values[i] > val_max) val_max = Values[i];
+	init_checkpoint();
 
 	if (if_neg_val && varname)
 		warning(ERR_INDEX_VALUE, varname);
@@ -124,18 +239,47 @@ void CIndex::InitOne(int num)
 	AccIndex = AccOffset = 0;
 	has_index = false;
 	val_max = 1;
+	init_checkpoint();
+}
+
+bool CIndex::InitRLE(PdContainer Obj, PdAbstractArray IdxObj, C_Int64 data_count)
+{
+	if (!rle_load(Obj, IdxObj, data_count, Values, Lengths))
+		return false;
+	TotalLength = GDS_Array_GetTotalCount(IdxObj);
+	Position = 0;
+	AccSum = 0;
+	AccIndex = AccOffset = 0;
+	has_index = true;
+	val_max = 0;
+	for (size_t i=0; i < Values.size(); i++)
+		if (Values[i] > val_max) val_max = Values[i];
+	init_checkpoint();
+	return true;
+}
+
+void CIndex::init_checkpoint()
+{
+	rle_init_checkpoint(Values, Lengths, CkPosition, CkAccSum);
+}
+
+inline void CIndex::seek_checkpoint(size_t pos)
+{
+	size_t k;
+	if (rle_find_checkpoint(CkPosition, pos, Position, AccIndex, k))
+	{
+		Position = CkPosition[k];
+		AccSum = CkAccSum[k];
+		AccIndex = k * INDEX_CHECKPOINT_NRUN;
+		AccOffset = 0;
+	}
 }
 
 void CIndex::GetInfo(size_t pos, C_Int64 &Sum, int &Value)
 {
 	if (pos >= TotalLength)
 		throw ErrSeqArray("Invalid position in CIndex.");
-	if (pos < Position)
-	{
-		Position = 0;
-		AccSum = 0;
-		AccIndex = AccOffset = 0;
-	}
+	seek_checkpoint(pos);
 	for (; Position < pos; )
 	{
 		size_t L = Lengths[AccIndex];
@@ -338,20 +482,45 @@ void CGenoIndex::Init(PdContainer Obj, const char *varname)
 	Position = 0;
 	AccSum = 0;
 	AccIndex = AccOffset = 0;
+	init_checkpoint();
 	if (if_neg_val && varname)
 		warning(ERR_INDEX_VALUE, varname);
 }
 
+bool CGenoIndex::InitRLE(PdContainer Obj, PdAbstractArray IdxObj, C_Int64 data_count)
+{
+	if (!rle_load(Obj, IdxObj, data_count, Values, Lengths))
+		return false;
+	TotalLength = GDS_Array_GetTotalCount(IdxObj);
+	Position = 0;
+	AccSum = 0;
+	AccIndex = AccOffset = 0;
+	init_checkpoint();
+	return true;
+}
+
+void CGenoIndex::init_checkpoint()
+{
+	rle_init_checkpoint(Values, Lengths, CkPosition, CkAccSum);
+}
+
+inline void CGenoIndex::seek_checkpoint(size_t pos)
+{
+	size_t k;
+	if (rle_find_checkpoint(CkPosition, pos, Position, AccIndex, k))
+	{
+		Position = CkPosition[k];
+		AccSum = CkAccSum[k];
+		AccIndex = k * INDEX_CHECKPOINT_NRUN;
+		AccOffset = 0;
+	}
+}
+
 void CGenoIndex::GetInfo(size_t pos, C_Int64 &Sum, C_UInt8 &Value)
 {
 	if (pos >= TotalLength)
 		throw ErrSeqArray("Invalid position in CIndex.");
-	if (pos < Position)
-	{
-		Position = 0;
-		AccSum = 0;
-		AccIndex = AccOffset = 0;
-	}
+	seek_checkpoint(pos);
 	for (; Position < pos; )
 	{
 		size_t L = Lengths[AccIndex];
@@ -501,6 +670,335 @@ size_t CChromIndex::RangeTotalLength(const TRangeList &RngList)
 
 
 
+// ===========================================================
+// Position indexing
+// ===========================================================
+
+CPosIndex::CPosIndex() { Pos = NULL; }
+
+void CPosIndex::Clear()
+{
+	Block.clear();
+	Pos = NULL;
+}
+
+void CPosIndex::Init(CChromIndex &Chrom, const vector<C_Int32> &PosList)
+{
+	Clear();
+	if (PosList.empty()) return;
+	Pos = &PosList[0];
+
+	map<string, CChromIndex::TRangeList>::const_iterator it;
+	for (it=Chrom.Map.begin(); it != Chrom.Map.end(); it++)
+	{
+		vector<CChromIndex::TRange>::const_iterator p;
+		for (p=it->second.begin(); p != it->second.end(); p++)
+		{
+			TBlock b;
+			b.Start = p->Start; b.Length = p->Length;
+			const C_Int32 *s = &Pos[b.Start];
+			b.Sorted = true;
+			for (size_t i=1; i < b.Length; i++)
+				if (s[i] < s[i-1]) { b.Sorted = false; break; }
+			Block.push_back(b);
+		}
+	}
+	sort(Block.begin(), Block.end(), less_block);
+
+	// the sparse index for unsorted blocks
+	vector<TBlock>::iterator p;
+	for (p=Block.begin(); p != Block.end(); p++)
+	{
+		if (p->Sorted) continue;
+		const size_t nsub = (p->Length + SUB_BLOCK - 1) / SUB_BLOCK;
+		p->Min.resize(nsub); p->Max.resize(nsub);
+		const C_Int32 *s = &Pos[p->Start];
+		for (size_t k=0, i=0; k < nsub; k++)
+		{
+			size_t n = p->Length - i;
+			if (n > SUB_BLOCK) n = SUB_BLOCK;
+			C_Int32 vmin = s[i], vmax = s[i];
+			for (; n > 0; n--, i++)
+			{
+				if (s[i] < vmin) vmin = s[i];
+				if (s[i] > vmax) vmax = s[i];
+			}
+			p->Min[k] = vmin; p->Max[k] = vmax;
+		}
+	}
+}
+
+bool CPosIndex::IsSorted(size_t idx)
+{
+	return get_block(idx).Sorted;
+}
+
+void CPosIndex::Find(size_t start, size_t end, int from, int to,
+	vector<TSpan> &out)
+{
+	if ((start >= end) || (from > to)) return;
+	TBlock &b = get_block(start);
+	if (end > b.Start + b.Length)
+		throw ErrSeqArray("Invalid variant range in CPosIndex::Find().");
+	TSpan ss;
+	if (b.Sorted)
+	{
+		// binary search
+		const C_Int32 *st = lower_bound(Pos + start, Pos + end, from);
+		const C_Int32 *ed = upper_bound(st, Pos + end, to);
+		if (st < ed)
+		{
+			ss.Start = st - Pos; ss.End = ed - Pos; ss.Exact = true;
+			out.push_back(ss);
+		}
+	} else {
+		// the sub-blocks overlapping [from, to]
+		size_t k = (start - b.Start) / SUB_BLOCK;
+		size_t k_end = (end - 1 - b.Start) / SUB_BLOCK + 1;
+		bool has = false;
+		for (; k < k_end; k++)
+		{
+			if (b.Max[k] < from || b.Min[k] > to) continue;
+			size_t i1 = b.Start + k*SUB_BLOCK, i2 = i1 + SUB_BLOCK;
+			if (i1 < start) i1 = start;
+			if (i2 > end) i2 = end;
+			bool exact = (from <= b.Min[k]) && (b.Max[k] <= to);
+			if (has && ss.End==i1 && ss.Exact==exact)
+			{
+				ss.End = i2;
+			} else {
+				if (has) out.push_back(ss);
+				ss.Start = i1; ss.End = i2; ss.Exact = exact;
+				has = true;
+			}
+		}
+		if (has) out.push_back(ss);
+	}
+}
+
+bool CPosIndex::less_block(const TBlock &lhs, const TBlock &rhs)
+{
+	return lhs.Start < rhs.Start;
+}
+
+CPosIndex::TBlock &CPosIndex::get_block(size_t idx)
+{
+	size_t lo = 0, hi = Block.size();
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi) / 2;
+		if (Block[mid].Start <= idx) lo = mid + 1; else hi = mid;
+	}
+	if (lo == 0)
+		throw ErrSeqArray("Invalid variant index in CPosIndex.");
+	TBlock &b = Block[lo - 1];
+	if (idx >= b.Start + b.Length)
+		throw ErrSeqArray("Invalid variant index in CPosIndex.");
+	return b;
+}
+
+
+
+// ===========================================================
+// ID indexing
+// ===========================================================
+
+static inline C_UInt32 id_hash_int(C_UInt64 x)
+{
+	x ^= x >> 33; x *= 0xFF51AFD7ED558CCDULL;
+	x ^= x >> 33; x *= 0xC4CEB9FE1A85EC53ULL;
+	x ^= x >> 33;
+	return (C_UInt32)x;
+}
+
+static inline C_UInt32 id_hash_real(double x)
+{
+	if (x == 0) x = 0;  // -0 and +0
+	C_UInt64 v;
+	memcpy(&v, &x, sizeof(v));
+	return id_hash_int(v);
+}
+
+static inline C_UInt32 id_hash_str(const char *s, size_t n)
+{
+	C_UInt32 h = 2166136261U;  // FNV-1a
+	for (; n > 0; n--) { h ^= (C_UInt8)(*s++); h *= 16777619U; }
+	return h;
+}
+
+CIdIndex::CIdIndex()
+{
+	Obj = NULL; Count = 0; SV = svCustom;
+	IsSeq = false; SeqStart = SeqStep = 0; Mask = 0;
+}
+
+void CIdIndex::Clear()
+{
+	Obj = NULL; Count = 0; SV = svCustom;
+	IsSeq = false; SeqStart = SeqStep = 0; Mask = 0;
+	vector<C_Int32>().swap(IntList);
+	vector<double>().swap(RealList);
+	vector<char>().swap(StrBuffer);
+	vector<size_t>().swap(StrOffset);
+	vector<C_Int32>().swap(Table);
+	vector<C_Int32>().swap(Next);
+}
+
+void CIdIndex::Init(PdAbstractArray obj, C_SVType sv)
+{
+	Clear();
+	const C_Int64 n = GDS_Array_GetTotalCount(obj);
+	if (n > 2147483647)
+		throw ErrSeqArray("Too many IDs in CIdIndex.");
+	const C_Int32 SIZE = 65536;
+	if (sv == svInt32)
+	{
+		IntList.resize(n);
+		if (n > 0) GDS_Array_ReadData(obj, NULL, NULL, &IntList[0], svInt32);
+		// check whether it is an integer sequence
+		if (n > 0)
+		{
+			SeqStart = IntList[0];
+			SeqStep = (n > 1) ? (C_Int64)IntList[1] - IntList[0] : 1;
+			IsSeq = (SeqStep > 0);
+			for (C_Int64 i=1; IsSeq && i < n; i++)
+				if ((C_Int64)IntList[i] - IntList[i-1] != SeqStep) IsSeq = false;
+		}
+		if (IsSeq) vector<C_Int32>().swap(IntList);
+	} else if (sv == svFloat64)
+	{
+		RealList.resize(n);
+		if (n > 0) GDS_Array_ReadData(obj, NULL, NULL, &RealList[0], svFloat64);
+	} else if (sv == svStrUTF8)
+	{
+		vector<string> buffer(SIZE);
+		StrOffset.reserve(n + 1);
+		StrOffset.push_back(0);
+		for (C_Int32 st=0; st < n; )
+		{
+			C_Int32 m = (n - st <= SIZE) ? (n - st) : SIZE;
+			GDS_Array_ReadData(obj, &st, &m, &buffer[0], svStrUTF8);
+			for (C_Int32 i=0; i < m; i++)
+			{
+				StrBuffer.insert(StrBuffer.end(), buffer[i].begin(),
+					buffer[i].end());
+				StrOffset.push_back(StrBuffer.size());
+			}
+			st += m;
+		}
+		StrBuffer.push_back(0);  // not empty
+	} else
+		throw ErrSeqArray("Invalid data type in CIdIndex.");
+
+	Obj = obj; Count = n; SV = sv;
+	if (!IsSeq) init_table();
+}
+
+bool CIdIndex::IsInit(PdAbstractArray obj) const
+{
+	return (Obj != NULL) && (Obj == obj) &&
+		(Count == GDS_Array_GetTotalCount(obj));
+}
+
+void CIdIndex::init_table()
+{
+	size_t size = 16;
+	while (size < (size_t)Count + (size_t)Count/2) size <<= 1;
+	Table.assign(size, -1);
+	Next.assign(Count, -1);
+	Mask = size - 1;
+	for (C_Int32 i=0; i < Count; i++)
+	{
+		size_t k = hash_at(i) & Mask;
+		while (Table[k] >= 0)
+		{
+			const C_Int32 j = Table[k];
+			bool eq;
+			if (SV == svInt32)
+				eq = (IntList[i] == IntList[j]);
+			else if (SV == svFloat64)
+				eq = (RealList[i] == RealList[j]);
+			else {
+				const size_t n = StrOffset[i+1] - StrOffset[i];
+				eq = (n == StrOffset[j+1] - StrOffset[j]) &&
+					(memcmp(&StrBuffer[0] + StrOffset[i],
+						&StrBuffer[0] + StrOffset[j], n) == 0);
+			}
+			if (eq) break;
+			k = (k + 1) & Mask;
+		}
+		Next[i] = Table[k];
+		Table[k] = i;
+	}
+}
+
+C_UInt32 CIdIndex::hash_at(size_t i) const
+{
+	if (SV == svInt32)
+		return id_hash_int((C_UInt32)IntList[i]);
+	else if (SV == svFloat64)
+		return id_hash_real(RealList[i]);
+	else
+		return id_hash_str(&StrBuffer[0] + StrOffset[i],
+			StrOffset[i+1] - StrOffset[i]);
+}
+
+inline void CIdIndex::add_chain(C_Int32 i, vector<C_Int32> &out) const
+{
+	for (; i >= 0; i = Next[i]) out.push_back(i);
+}
+
+void CIdIndex::Find(C_Int32 id, vector<C_Int32> &out) const
+{
+	if (SV != svInt32)
+		throw ErrSeqArray("Invalid data type in CIdIndex::Find().");
+	if (IsSeq)
+	{
+		C_Int64 d = (C_Int64)id - SeqStart;
+		if ((d >= 0) && (d % SeqStep == 0) && (d / SeqStep < Count))
+			out.push_back(d / SeqStep);
+		return;
+	}
+	if (Table.empty()) return;
+	for (size_t k = id_hash_int((C_UInt32)id) & Mask; Table[k] >= 0; )
+	{
+		if (IntList[Table[k]] == id)
+			{ add_chain(Table[k], out); break; }
+		k = (k + 1) & Mask;
+	}
+}
+
+void CIdIndex::Find(double id, vector<C_Int32> &out) const
+{
+	if (SV != svFloat64)
+		throw ErrSeqArray("Invalid data type in CIdIndex::Find().");
+	if (Table.empty()) return;
+	for (size_t k = id_hash_real(id) & Mask; Table[k] >= 0; )
+	{
+		if (RealList[Table[k]] == id)
+			{ add_chain(Table[k], out); break; }
+		k = (k + 1) & Mask;
+	}
+}
+
+void CIdIndex::Find(const char *id, vector<C_Int32> &out) const
+{
+	if (SV != svStrUTF8)
+		throw ErrSeqArray("Invalid data type in CIdIndex::Find().");
+	if (Table.empty()) return;
+	const size_t n = strlen(id);
+	for (size_t k = id_hash_str(id, n) & Mask; Table[k] >= 0; )
+	{
+		const C_Int32 j = Table[k];
+		if ((StrOffset[j+1] - StrOffset[j] == n) &&
+			(memcmp(&StrBuffer[0] + StrOffset[j], id, n) == 0))
+			{ add_chain(j, out); break; }
+		k = (k + 1) & Mask;
+	}
+}
+
+
+
 // ===========================================================
 // Genomic Range Set
 // ===========================================================
@@ -560,6 +1058,136 @@ void CRangeSet::GetRanges(int Start[], int End[])
 
 
 
+// ===========================================================
+// Compressed Selection
+// ===========================================================
+
+CSelBitmap::CSelBitmap()
+{
+	fLength = fCount = 0;
+	fIsRun = true;
+}
+
+void CSelBitmap::Set(const C_BOOL *sel, size_t n)
+{
+	Clear();
+	fLength = n;
+	// the runs of TRUEs, unless they need more memory than a bitmap
+	const size_t max_run = (n + 7) / 8 / (2 * sizeof(C_UInt32));
+	const C_BOOL *p = sel, *end = sel + n;
+	while (p < end)
+	{
+		p = VEC_BOOL_FIND_TRUE(p, end);
+		if (p >= end) break;
+		const C_BOOL *e = p + 1;
+		while (e < end && *e) e++;
+		if (fRuns.size() >= 2*max_run)
+		{
+			fIsRun = false;
+			break;
+		}
+		fRuns.push_back(p - sel);
+		fRuns.push_back(e - sel);
+		fCount += e - p;
+		p = e;
+	}
+	if (!fIsRun)
+	{
+		// packed bitmap
+		vector<C_UInt32>().swap(fRuns);
+		fBits.assign((n + 7) / 8, 0);
+		fCount = 0;
+		for (size_t i=0; i < n; i++)
+		{
+			if (sel[i])
+			{
+				fBits[i >> 3] |= 1 << (i & 0x07);
+				fCount ++;
+			}
+		}
+	}
+}
+
+void CSelBitmap::Get(C_BOOL *sel) const
+{
+	if (fIsRun)
+	{
+		memset(sel, FALSE, fLength);
+		for (size_t i=0; i < fRuns.size(); i+=2)
+			memset(sel + fRuns[i], TRUE, fRuns[i+1] - fRuns[i]);
+	} else {
+		for (size_t i=0; i < fLength; i++)
+			sel[i] = (fBits[i >> 3] >> (i & 0x07)) & 0x01;
+	}
+}
+
+void CSelBitmap::Clear()
+{
+	fLength = fCount = 0;
+	fIsRun = true;
+	vector<C_UInt32>().swap(fRuns);
+	vector<C_UInt8>().swap(fBits);
+}
+
+size_t CSelBitmap::Next(size_t pos) const
+{
+	if (pos >= fLength) return fLength;
+	if (fIsRun)
+	{
+		// the first run ending after 'pos'
+		size_t lo = 0, hi = fRuns.size() / 2;
+		while (lo < hi)
+		{
+			size_t mid = (lo + hi) / 2;
+			if (fRuns[2*mid+1] <= pos) lo = mid + 1; else hi = mid;
+		}
+		if (lo >= fRuns.size()/2) return fLength;
+		return (fRuns[2*lo] > pos) ? fRuns[2*lo] : pos;
+	} else {
+		for (; pos < fLength; pos++)
+		{
+			const C_UInt8 b = fBits[pos >> 3] >> (pos & 0x07);
+			if (b == 0)
+				pos |= 0x07;  // skip the remaining bits in the byte
+			else if (b & 0x01)
+				return pos;
+		}
+		return fLength;
+	}
+}
+
+size_t CSelBitmap::Select(size_t pos, size_t &num, C_BOOL *out) const
+{
+	size_t n = 0, end = pos;
+	while (n < num)
+	{
+		pos = Next(pos);
+		if (pos >= fLength) break;
+		if (fIsRun)
+		{
+			// the end of the run containing 'pos'
+			size_t lo = 0, hi = fRuns.size() / 2;
+			while (lo < hi)
+			{
+				size_t mid = (lo + hi) / 2;
+				if (fRuns[2*mid+1] <= pos) lo = mid + 1; else hi = mid;
+			}
+			size_t m = fRuns[2*lo+1] - pos;
+			if (m > num - n) m = num - n;
+			memset(out + pos, TRUE, m);
+			n += m; pos += m;
+		} else {
+			out[pos++] = TRUE;
+			n ++;
+		}
+		end = pos;
+	}
+	num = n;
+	return end;
+}
+
+
+
 // ===========================================================
 // SeqArray GDS file information
 // ===========================================================
@@ -567,6 +1195,7 @@ void CRangeSet::GetRanges(int Start[], int End[])
 TSelection::TSelection(CFileInfo &File, bool init)
 {
 	Link = NULL;
+	LockNum = 0;
 	if (File.Ploidy() <= 0)
 		throw ErrSeqArray("Unable to determine ploidy.");
 	numPloidy = File.Ploidy();
@@ -575,7 +1204,14 @@ TSelection::TSelection(CFileInfo &File, bool init)
 	numVar = File.VariantNum(); pVariant = new C_BOOL[numVar];
 	if (init) memset(pVariant, TRUE, numVar);
 	pFlagGenoSel = NULL;
-	varTrueNum = -1; varStart = varEnd = 0;
+	if (init)
+	{
+		sampTrueNum = sampEnd = numSamp; sampStart = 0;
+		varTrueNum = varEnd = numVar; varStart = 0;
+	} else {
+		sampTrueNum = -1; sampStart = sampEnd = 0;
+		varTrueNum = -1; varStart = varEnd = 0;
+	}
 }
 
 TSelection::~TSelection()
@@ -616,6 +1252,7 @@ TSelection::TSampStruct *TSelection::GetStructSample()
 		last.length = last.offset = 0; last.sel = NULL;
 		C_BOOL *pSt = pSample, *pEnd = pSample + numSamp;
 		// find the first TRUE
+		if (sampTrueNum >= 0) pSt += sampStart;
 		while (pSt<pEnd && !*pSt) pSt++;
 		// for-loop all TRUE blocks
 		for (; pSt < pEnd; )
@@ -679,10 +1316,8 @@ TSelection::TSampStruct *TSelection::GetStructSample()
 			pSampList.push_back(last);
 		ss.length = ss.offset = 0; ss.sel = NULL;
 		pSampList.push_back(ss);
-	}
 
-	{
-		// check
+		// check only when the structure is built
 		ssize_t num = 0;
 		TSampStruct *p = &pSampList[0];
 		for (; p->length > 0; p++)
@@ -692,14 +1327,38 @@ TSelection::TSampStruct *TSelection::GetStructSample()
 			else
 				num += p->length;
 		}
-		ssize_t num_samp = GetNumOfTRUE(pSample, numSamp);
-		if (num_samp*int(numPloidy) != num)
+		GetCountSample();
+		if (sampTrueNum*int(numPloidy) != num)
 			throw ErrSeqArray("Internal error when preparing structure for selected samples, please email to zhengxwen@gmail.com.");
 	}
 
 	return &pSampList[0];
 }
 
+void TSelection::GetCountSample()
+{
+	if (sampTrueNum < 0)
+	{
+		C_BOOL *end = pSample + numSamp;
+		C_BOOL *p = VEC_BOOL_FIND_TRUE(pSample, end);
+		sampStart = p - pSample;
+		sampTrueNum = vec_i8_cnt_nonzero((C_Int8*)p, end - p);
+		if (sampTrueNum > 0)
+		{
+			C_BOOL *last = end - 1;
+			while (!*last) last--;
+			sampEnd = last + 1 - pSample;
+		} else
+			sampStart = sampEnd = 0;
+	}
+}
+
+void TSelection::SetCountSample(ssize_t num, ssize_t start, ssize_t end)
+{
+	sampTrueNum = num;
+	sampStart = start; sampEnd = end;
+}
+
 void TSelection::ClearStructSample()
 {
 	if (pFlagGenoSel)
@@ -708,6 +1367,8 @@ void TSelection::ClearStructSample()
 		pFlagGenoSel = NULL;
 	}
 	pSampList.clear();
+	sampTrueNum = -1;
+	sampStart = sampEnd = 0;
 }
 
 void TSelection::GetStructVariant()
@@ -743,6 +1404,74 @@ void TSelection::ClearStructVariant()
 	varStart = varEnd = 0;
 }
 
+void TSelection::CopyStructSample(TSelection &dst) const
+{
+	dst.ClearStructSample();
+	if (pFlagGenoSel)
+	{
+		const size_t SIZE = numSamp * numPloidy;
+		dst.pFlagGenoSel = new C_BOOL[SIZE];
+		memcpy(dst.pFlagGenoSel, pFlagGenoSel, SIZE);
+		dst.pSampList = pSampList;
+		// the block pointers refer to the copied genotype selection
+		vector<TSampStruct>::iterator p;
+		for (p=dst.pSampList.begin(); p != dst.pSampList.end(); p++)
+		{
+			if (p->sel)
+				p->sel = dst.pFlagGenoSel + (p->sel - pFlagGenoSel);
+		}
+	}
+	dst.SetCountSample(sampTrueNum, sampStart, sampEnd);
+}
+
+void TSelection::MoveStructSample(TSelection &dst)
+{
+	dst.ClearStructSample();
+	dst.pFlagGenoSel = pFlagGenoSel;
+	dst.pSampList.swap(pSampList);
+	dst.SetCountSample(sampTrueNum, sampStart, sampEnd);
+	pFlagGenoSel = NULL;
+	pSampList.clear();
+}
+
+void TSelection::Compress()
+{
+	if (LockNum > 0) return;
+	// the structure of selected samples is rebuilt when needed
+	if (pFlagGenoSel)
+	{
+		delete[] pFlagGenoSel;
+		pFlagGenoSel = NULL;
+	}
+	vector<TSampStruct>().swap(pSampList);
+	if (pSample)
+	{
+		SampBitmap.Set(pSample, numSamp);
+		delete[] pSample; pSample = NULL;
+	}
+	if (pVariant)
+	{
+		VarBitmap.Set(pVariant, numVar);
+		delete[] pVariant; pVariant = NULL;
+	}
+}
+
+void TSelection::Decompress()
+{
+	if (!pSample)
+	{
+		pSample = new C_BOOL[numSamp];
+		SampBitmap.Get(pSample);
+		SampBitmap.Clear();
+	}
+	if (!pVariant)
+	{
+		pVariant = new C_BOOL[numVar];
+		VarBitmap.Get(pVariant);
+		VarBitmap.Clear();
+	}
+}
+
 // TVarMap
 
 static const char *ERR_DIM = "Invalid dimension of '%s'.";
@@ -782,7 +1511,17 @@ void TVarMap::InitWtIndex(CFileInfo &file, const string &varnm, TFunction fc)
 	PdAbstractArray N = file.GetObj(idx_name.c_str(), FALSE);
 	if (N)
 	{
-		Index.Init(N, idx_name.c_str());
+		// use the run-length encoding stored in GDS if it is up-to-date
+		string rle_name = GDS_PATH_PREFIX(idx_name, '@');
+		PdAbstractArray R = file.UseRLE(rle_name) ?
+			file.GetObj(rle_name.c_str(), FALSE) : NULL;
+		if (R)
+		{
+			if (!Index.InitRLE(R, N, Dim[0]))
+				Index.Init(N, idx_name.c_str());
+			GDS_Node_Unload(R);
+		} else
+			Index.Init(N, idx_name.c_str());
 		GDS_Node_Unload(N);
 	} else
 		Index.InitOne(file._VariantNum);
@@ -804,7 +1543,7 @@ void TVarMap::get_obj(CFileInfo &file, const string &varnm)
 
 CFileInfo::CFileInfo(PdGDSFolder root)
 {
-	_File = NULL; _Root = NULL;
+	_File = NULL; _Root = NULL; _ReadOnly = true;
 	_SelList = NULL;
 	_SampleNum = _VariantNum = 0;
 	ResetRoot(root);
@@ -828,8 +1567,9 @@ void CFileInfo::clear_selection()
 	_SelList = NULL;
 }
 
-void CFileInfo::ResetRoot(PdGDSFolder root)
+void CFileInfo::ResetRoot(PdGDSFolder root, bool readonly)
 {
+	_ReadOnly = readonly;
 	if (_Root != root)
 	{
 		// initialize
@@ -837,6 +1577,9 @@ void CFileInfo::ResetRoot(PdGDSFolder root)
 		_Root = root;
 		_Chrom.Clear();
 		_Position.clear();
+		_PosIndex.Clear();
+		_IdIndex.clear();
+		_StaleRLE.clear();
 		clear_selection();
 
 		// sample.id
@@ -872,6 +1615,21 @@ void CFileInfo::ResetRoot(PdGDSFolder root)
 	}
 }
 
+void CFileInfo::SetStaleRLE(SEXP names)
+{
+	_StaleRLE.clear();
+	if (Rf_isString(names))
+	{
+		for (R_xlen_t i=0; i < XLENGTH(names); i++)
+			_StaleRLE.insert(CHAR(STRING_ELT(names, i)));
+	}
+}
+
+bool CFileInfo::UseRLE(const string &rle_name) const
+{
+	return _StaleRLE.find(rle_name) == _StaleRLE.end();
+}
+
 TSelection &CFileInfo::Selection()
 {
 	if (!_Root)
@@ -882,11 +1640,27 @@ TSelection &CFileInfo::Selection()
 TSelection &CFileInfo::Push_Selection(bool init_samp, bool init_var)
 {
 	TSelection *n = new TSelection(*this, false);
-	n->Link = _SelList;
+	TSelection *last = _SelList;
+	n->Link = last;
 	if (init_samp)
-		memcpy(n->pSample, _SelList->pSample, _SampleNum);
+	{
+		memcpy(n->pSample, last->pSample, _SampleNum);
+		// reuse the structure of selected samples, the previous selection
+		//   keeps its own if it is referred by an active iterator
+		if (last->LockNum > 0)
+			last->CopyStructSample(*n);
+		else
+			last->MoveStructSample(*n);
+	}
 	if (init_var)
-		memcpy(n->pVariant, _SelList->pVariant, _VariantNum);
+	{
+		memcpy(n->pVariant, last->pVariant, _VariantNum);
+		n->varTrueNum = last->varTrueNum;
+		n->varStart = last->varStart;
+		n->varEnd = last->varEnd;
+	}
+	// the previous selection is not used until popping up
+	last->Compress();
 	_SelList = n;
 	return *n;
 }
@@ -896,7 +1670,14 @@ void CFileInfo::Pop_Selection()
 	if (_SelList==NULL || _SelList->Link==NULL)
 		throw ErrSeqArray("No filter can be pop up.");
 	TSelection *n = _SelList;
-	_SelList = n->Link;
+	TSelection *last = n->Link;
+	last->Decompress();
+	// reuse the structure of selected samples if the samples are the same
+	//   and the previous one is not referred by an active iterator
+	if ((last->LockNum <= 0) &&
+			memcmp(n->pSample, last->pSample, _SampleNum) == 0)
+		n->MoveStructSample(*last);
+	_SelList = last;
 	delete n;
 }
 
@@ -914,6 +1695,9 @@ void CFileInfo::ResetChromosome()
 	if (!_Root)
 		throw ErrSeqArray(ERR_FILE_ROOT);
 	_Chrom.Clear();
+	_Position.clear();
+	_PosIndex.Clear();
+	_IdIndex.clear();
 }
 
 vector<C_Int32> &CFileInfo::Position()
@@ -934,13 +1718,44 @@ vector<C_Int32> &CFileInfo::Position()
 	return _Position;
 }
 
+CPosIndex &CFileInfo::PosIndex()
+{
+	if (_PosIndex.Empty())
+		_PosIndex.Init(Chromosome(), Position());
+	return _PosIndex;
+}
+
+CIdIndex &CFileInfo::IdIndex(const char *varname, C_SVType sv)
+{
+	PdAbstractArray N = GetObj(varname, TRUE);
+	string key = varname;
+	key.append(sv==svInt32 ? ":int" : (sv==svFloat64 ? ":real" : ":str"));
+	CIdIndex &I = _IdIndex[key];
+	// the node could be modified in place if the file is writable
+	if (!_ReadOnly || !I.IsInit(N))
+		I.Init(N, sv);
+	return I;
+}
+
 CGenoIndex &CFileInfo::GenoIndex()
 {
 	if (_GenoIndex.Empty())
 	{
 		const char *varname = "genotype/@data";
 		PdAbstractArray N = GDS_Node_Path(_Root, varname, TRUE);
-		_GenoIndex.Init(N, varname);
+		// use the run-length encoding stored in GDS if it is up-to-date
+		PdAbstractArray R = UseRLE("genotype/@@data") ?
+			GDS_Node_Path(_Root, "genotype/@@data", FALSE) : NULL;
+		PdAbstractArray G = GDS_Node_Path(_Root, "genotype/data", FALSE);
+		if (R && G && (GDS_Array_DimCnt(G) == 3))
+		{
+			C_Int32 DLen[3];
+			GDS_Array_GetDim(G, DLen, 3);
+			if (!_GenoIndex.InitRLE(R, N, DLen[0]))
+				_GenoIndex.Init(N, varname);
+			GDS_Node_Unload(R);
+		} else
+			_GenoIndex.Init(N, varname);
 		GDS_Node_Unload(N);
 	}
 	return _GenoIndex;
@@ -956,7 +1771,8 @@ PdAbstractArray CFileInfo::GetObj(const char *name, C_BOOL MustExist)
 int CFileInfo::SampleSelNum()
 {
 	TSelection &s = Selection();
-	return vec_i8_cnt_nonzero((C_Int8*)s.pSample, _SampleNum);
+	s.GetCountSample();
+	return s.sampTrueNum;
 }
 
 int CFileInfo::VariantSelNum()
@@ -981,18 +1797,19 @@ COREARRAY_DLL_LOCAL CFileInfo &GetFileInfo(SEXP gdsfile)
 
 	int id = Rf_asInteger(ID);
 	PdGDSFolder root = GDS_R_SEXP2FileRoot(gdsfile);
+	SEXP RO = RGetListElement(gdsfile, "readonly");
+	bool readonly = Rf_isNull(RO) || (Rf_asLogical(RO) == TRUE);
 
-	map<int, CFileInfo>::iterator p = GDSFile_ID_Info.find(id);
-	if (p == GDSFile_ID_Info.end())
+	CFileInfo &file = GDSFile_ID_Info[id];
+	if (file.Root() != root)
 	{
-		GDSFile_ID_Info[id].ResetRoot(root);
-		p = GDSFile_ID_Info.find(id);
-	} else {
-		if (p->second.Root() != root)
-			p->second.ResetRoot(root);
-	}
+		file.ResetRoot(root, readonly);
+		// '@@' nodes failing the digest check in seqOpen()
+		file.SetStaleRLE(RGetListElement(gdsfile, "rle.stale"));
+	} else
+		file.ResetRoot(root, readonly);
 
-	return p->second;
+	return file;
 }
 
 
@@ -1454,6 +2271,19 @@ COREARRAY_DLL_LOCAL C_BOOL *NeedArrayTRUEs(size_t len)
 }
 
 
+/// get '.useraw': FALSE, TRUE, NA_INTEGER or USE_RAW_PACKED
+COREARRAY_DLL_LOCAL int GetUseRaw(SEXP UseRaw)
+{
+	if (Rf_isLogical(UseRaw))
+		return Rf_asLogical(UseRaw);
+	if (Rf_isString(UseRaw) && (RLength(UseRaw) == 1) &&
+			(strcmp(CHAR(STRING_ELT(UseRaw, 0)), "packed") == 0))
+		return USE_RAW_PACKED;
+	error("'.useraw' must be TRUE, FALSE, NA or \"packed\".");
+	return FALSE;
+}
+
+
 static char pretty_num_buffer[32];
 
 /// Get pretty text for an integer with comma
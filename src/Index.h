@@ -56,6 +56,9 @@ COREARRAY_DLL_LOCAL Rconnection My_R_GetConnection(SEXP x);
 
 /// define missing value of RAW
 #define NA_RAW     0xFF
+
+/// '.useraw="packed"', genotypes or dosages in packed 2-bit RAW format
+#define USE_RAW_PACKED    2
 }
 
 
@@ -150,6 +153,12 @@ protected:
 // Indexing object
 // ===========================================================
 
+/// the number of runs between two neighboring checkpoints in CIndex and CGenoIndex
+static const size_t INDEX_CHECKPOINT_NRUN = 64;
+
+/// the version of the run-length encoding stored in '@@' nodes (e.g., genotype/@@data)
+static const int INDEX_RLE_VERSION = 2;
+
 /// Indexing object with run-length encoding
 class COREARRAY_DLL_LOCAL CIndex
 {
@@ -166,6 +175,8 @@ public:
 	void Init(PdContainer Obj, const char *varname);
 	/// load data and represent as run-length encoding
 	void InitOne(int num);
+	/// load the run-length encoding stored in GDS, return false if it is stale
+	bool InitRLE(PdContainer Obj, PdAbstractArray IdxObj, C_Int64 data_count);
 	/// return the accumulated sum of values and current value in Lengths and Values given by a position
 	void GetInfo(size_t pos, C_Int64 &Sum, int &Value);
 	/// get lengths with selection
@@ -197,6 +208,15 @@ protected:
 	bool has_index;
 	/// the maximum value in Values
 	int val_max;
+	/// the positions of the first element in every INDEX_CHECKPOINT_NRUN runs
+	vector<C_Int64> CkPosition;
+	/// the accumulated sums according to CkPosition
+	vector<C_Int64> CkAccSum;
+
+	/// initialize CkPosition and CkAccSum from Values and Lengths
+	void init_checkpoint();
+	/// move Position to the closest checkpoint at or before pos if needed
+	inline void seek_checkpoint(size_t pos);
 };
 
 
@@ -214,6 +234,8 @@ public:
 
 	/// load data and represent as run-length encoding
 	void Init(PdContainer Obj, const char *varname);
+	/// load the run-length encoding stored in GDS, return false if it is stale
+	bool InitRLE(PdContainer Obj, PdAbstractArray IdxObj, C_Int64 data_count);
 	/// return the accumulated sum of values and current value in Lengths and Values given by a position
 	void GetInfo(size_t pos, C_Int64 &Sum, C_UInt8 &Value);
 	/// return true if empty
@@ -230,6 +252,15 @@ protected:
 	size_t AccIndex;
 	/// the offset according the value of Lengths[AccIndex]
 	size_t AccOffset;
+	/// the positions of the first element in every INDEX_CHECKPOINT_NRUN runs
+	vector<C_Int64> CkPosition;
+	/// the accumulated sums according to CkPosition
+	vector<C_Int64> CkAccSum;
+
+	/// initialize CkPosition and CkAccSum from Values and Lengths
+	void init_checkpoint();
+	/// move Position to the closest checkpoint at or before pos if needed
+	inline void seek_checkpoint(size_t pos);
 };
 
 
@@ -278,6 +309,117 @@ protected:
 
 
 
+// ===========================================================
+// Position indexing
+// ===========================================================
+
+/// Position indexing object: binary search in the chromosome blocks with
+///   sorted positions, or a sparse index of sub-blocks for unsorted blocks
+class COREARRAY_DLL_LOCAL CPosIndex
+{
+public:
+	/// the number of variants in a sub-block of the sparse index
+	static const size_t SUB_BLOCK = 256;
+
+	/// a span of variants
+	struct TSpan
+	{
+		size_t Start;  ///< the starting variant index
+		size_t End;    ///< the ending variant index (not included)
+		bool Exact;    ///< true if all positions in the span are in the range
+	};
+
+	/// constructor
+	CPosIndex();
+
+	/// clear
+	void Clear();
+	/// detect whether the positions are sorted in each chromosome block
+	void Init(CChromIndex &Chrom, const vector<C_Int32> &PosList);
+
+	/// whether it is empty
+	inline bool Empty() const { return Block.empty(); }
+	/// whether the positions of the block containing the variant are sorted
+	bool IsSorted(size_t idx);
+	/// append the spans of variants in [start, end) within a chromosome
+	///   block, which cover all variants with positions in [from, to]
+	void Find(size_t start, size_t end, int from, int to, vector<TSpan> &out);
+
+protected:
+	/// a chromosome block
+	struct TBlock
+	{
+		size_t Start;   ///< the starting variant index
+		size_t Length;  ///< the number of variants
+		bool Sorted;    ///< whether the positions are sorted
+		vector<C_Int32> Min;  ///< the minimum position of each sub-block if unsorted
+		vector<C_Int32> Max;  ///< the maximum position of each sub-block if unsorted
+	};
+
+	/// chromosome blocks ordered by the starting variant index
+	vector<TBlock> Block;
+	/// the pointer to the positions
+	const C_Int32 *Pos;
+
+	/// get the block containing the variant
+	TBlock &get_block(size_t idx);
+	/// the order of blocks
+	static bool less_block(const TBlock &lhs, const TBlock &rhs);
+};
+
+
+
+// ===========================================================
+// ID indexing
+// ===========================================================
+
+/// ID indexing object: a hash table from IDs to indices (allowing
+///   duplicated IDs), or arithmetic lookup for an integer sequence
+class COREARRAY_DLL_LOCAL CIdIndex
+{
+public:
+	/// constructor
+	CIdIndex();
+
+	/// clear
+	void Clear();
+	/// build the index of a GDS node, sv should be svInt32, svFloat64 or svStrUTF8
+	void Init(PdAbstractArray obj, C_SVType sv);
+	/// whether the index is built from the GDS node
+	bool IsInit(PdAbstractArray obj) const;
+
+	/// append the indices of the integer ID
+	void Find(C_Int32 id, vector<C_Int32> &out) const;
+	/// append the indices of the numeric ID
+	void Find(double id, vector<C_Int32> &out) const;
+	/// append the indices of the string ID
+	void Find(const char *id, vector<C_Int32> &out) const;
+
+protected:
+	PdAbstractArray Obj;  ///< the GDS node
+	C_Int64 Count;  ///< the number of IDs
+	C_SVType SV;    ///< the data type used in the index
+	bool IsSeq;     ///< whether the IDs are SeqStart + i*SeqStep
+	C_Int64 SeqStart;  ///< the first ID if IsSeq
+	C_Int64 SeqStep;   ///< the step if IsSeq
+	vector<C_Int32> IntList;   ///< integer IDs
+	vector<double> RealList;   ///< numeric IDs
+	vector<char> StrBuffer;     ///< string IDs (concatenated)
+	vector<size_t> StrOffset;   ///< the offsets of string IDs, Count+1 elements
+	vector<C_Int32> Table;  ///< open addressing table, the last index of an ID or -1
+	vector<C_Int32> Next;   ///< the previous index with the same ID or -1
+	size_t Mask;  ///< the table size - 1
+
+	/// build the hash table
+	void init_table();
+	/// the hash code of the ID at the index
+	C_UInt32 hash_at(size_t i) const;
+	/// append the indices in a chain
+	inline void add_chain(C_Int32 i, vector<C_Int32> &out) const;
+};
+
+
+
 // ===========================================================
 // Genomic Range Sets
 // ===========================================================
@@ -313,6 +455,46 @@ protected:
 
 
 
+// ===========================================================
+// Compressed Selection
+// ===========================================================
+
+/// a compressed selection of TRUE/FALSE, stored as the runs of TRUEs or a
+///   packed bitmap whichever is smaller
+class COREARRAY_DLL_LOCAL CSelBitmap
+{
+public:
+	CSelBitmap();
+
+	/// compress a selection of 'n' elements
+	void Set(const C_BOOL *sel, size_t n);
+	/// decompress to a selection of Length() elements
+	void Get(C_BOOL *sel) const;
+	/// release memory
+	void Clear();
+
+	/// the first TRUE at or after 'pos', or Length() if no TRUE
+	size_t Next(size_t pos) const;
+	/// set TRUE in 'out' for at most 'num' TRUEs starting from 'pos', 'num'
+	///   is replaced by the number of TRUEs, return the position after the
+	///   last TRUE
+	size_t Select(size_t pos, size_t &num, C_BOOL *out) const;
+
+	/// the total number of elements
+	inline size_t Length() const { return fLength; }
+	/// the number of TRUEs
+	inline size_t Count() const { return fCount; }
+
+protected:
+	size_t fLength;  ///< the total number of elements
+	size_t fCount;   ///< the number of TRUEs
+	bool fIsRun;     ///< true for the runs of TRUEs, otherwise a bitmap
+	vector<C_UInt32> fRuns;  ///< the starting and ending positions of TRUE runs
+	vector<C_UInt8> fBits;   ///< the packed bitmap
+};
+
+
+
 // ===========================================================
 // SeqArray GDS file information
 // ===========================================================
@@ -332,6 +514,10 @@ struct COREARRAY_DLL_LOCAL TSelection
 	C_BOOL *pSample;   ///< sample selection
 	C_BOOL *pVariant;  ///< variant selection
 
+	ssize_t sampTrueNum;  ///< the number of TRUEs in pSample, -1 for requiring initialization
+	ssize_t sampStart;    ///< the start position of the first TRUE in pSample (0 if none)
+	ssize_t sampEnd;      ///< the next position of the last TRUE in pSample (0 if none)
+
 	ssize_t varTrueNum;  ///< the number of TRUEs in pVariant, -1 for requiring initialization
 	ssize_t varStart;    ///< the start position of the first TRUE in pVariant
 	ssize_t varEnd;      ///< the next position of the last TRUE in pVariant
@@ -343,6 +529,10 @@ struct COREARRAY_DLL_LOCAL TSelection
 
 	/// get the pointer to the sample reading structure
 	TSampStruct *GetStructSample();
+	/// get the number of selected samples and the range of TRUEs in pSample
+	void GetCountSample();
+	/// set the number of selected samples and the range of TRUEs in pSample
+	void SetCountSample(ssize_t num, ssize_t start, ssize_t end);
 	/// clear the structure of selected samples for resetting the sample filter
 	void ClearStructSample();
 
@@ -353,6 +543,22 @@ struct COREARRAY_DLL_LOCAL TSelection
 	/// clear the structure of selected variants for resetting the variant filter
 	void ClearStructVariant();
 
+	/// copy the structure of selected samples to 'dst' with the same samples
+	void CopyStructSample(TSelection &dst) const;
+	/// move the structure of selected samples to 'dst' with the same samples
+	void MoveStructSample(TSelection &dst);
+
+	/// compress pSample and pVariant when it is pushed and not locked
+	void Compress();
+	/// decompress pSample and pVariant when it becomes the current selection
+	void Decompress();
+	/// whether pSample and pVariant are compressed
+	inline bool IsCompressed() const { return !pVariant; }
+
+	int LockNum;  ///< the number of active iterators referring to pSample and pVariant
+	CSelBitmap SampBitmap;  ///< the compressed pSample, or empty
+	CSelBitmap VarBitmap;   ///< the compressed pVariant, or empty
+
 private:
 	size_t numSamp;    ///< the total number of samples
 	size_t numVar;     ///< the total number of variants
@@ -362,6 +568,18 @@ private:
 };
 
 
+/// keep a selection uncompressed while it is referred by an iterator, e.g.,
+///   a user-defined function may push a new filter in seqApply()
+struct COREARRAY_DLL_LOCAL TSelLock
+{
+	TSelection *Sel;
+	TSelLock(TSelection &sel): Sel(&sel) { Sel->LockNum ++; }
+	~TSelLock() { Unlock(); }
+	/// release the lock before the selection is popped up
+	void Unlock() { if (Sel) { Sel->LockNum --; Sel = NULL; } }
+};
+
+
 /// GDS variable structure used in SeqArray::seqGetData()
 struct COREARRAY_DLL_LOCAL TVarMap
 {
@@ -400,8 +618,12 @@ public:
 	/// destructor
 	~CFileInfo();
 
-	/// reset the root of GDS file
-	void ResetRoot(PdGDSFolder root);
+	/// reset the root of GDS file, the ID indices are cached only if read-only
+	void ResetRoot(PdGDSFolder root, bool readonly=true);
+	/// set the paths of out-of-date '@@' nodes (a character vector or NULL)
+	void SetStaleRLE(SEXP names);
+	/// whether the run-length encoding in the '@@' node can be used
+	bool UseRLE(const string &rle_name) const;
 
 	/// get the current selection
 	TSelection &Selection();
@@ -412,10 +634,14 @@ public:
 
 	/// return _Chrom which has been initialized
 	CChromIndex &Chromosome();
-	/// reload chromosome coding when it is changed
+	/// reload chromosome coding, positions and IDs when they are replaced
 	void ResetChromosome();
 	/// return _Position which has been initialized
 	vector<C_Int32> &Position();
+	/// return _PosIndex which has been initialized
+	CPosIndex &PosIndex();
+	/// return the ID index of a GDS node which has been initialized
+	CIdIndex &IdIndex(const char *varname, C_SVType sv);
 
 	/// return _GenoIndex which has been initialized
 	CGenoIndex &GenoIndex();
@@ -445,6 +671,7 @@ public:
 protected:
 	PdGDSFile _File;       ///< the GDS file
 	PdGDSFolder _Root;     ///< the root of GDS file
+	bool _ReadOnly;        ///< whether the GDS file is read-only
 	TSelection *_SelList;  ///< the pointer to the sample and variant selections
 	int _SampleNum;   ///< the total number of samples
 	int _VariantNum;  ///< the total number of variants
@@ -452,8 +679,11 @@ protected:
 
 	CChromIndex _Chrom;  ///< chromosome indexing
 	vector<C_Int32> _Position;  ///< position
+	CPosIndex _PosIndex;  ///< position indexing
+	map<string, CIdIndex> _IdIndex;  ///< ID indexing
 	CGenoIndex _GenoIndex;  ///< the indexing object for genotypes
 	map<string, TVarMap> _VarMap;  ///< the indexing objects for seqGetData()
+	set<string> _StaleRLE;  ///< the '@@' nodes with a mismatched digest
 
 private:
 	inline void clear_selection();
@@ -667,6 +897,9 @@ COREARRAY_DLL_LOCAL void RAppendGDS(PdAbstractArray Node, SEXP Val);
 /// requires a vector of TRUEs
 COREARRAY_DLL_LOCAL C_BOOL *NeedArrayTRUEs(size_t len);
 
+/// get '.useraw': FALSE, TRUE, NA_INTEGER or USE_RAW_PACKED
+COREARRAY_DLL_LOCAL int GetUseRaw(SEXP UseRaw);
+
 /// Get pretty text for an integer with comma
 COREARRAY_DLL_LOCAL const char *PrettyInt(int val);
 
@@ -284,33 +284,29 @@ void CVarApplyBySample::ReadGenoData(int *Base)
 
 	for (int i=0; i < Num_Variant; i++)
 	{
-		int *p;
 		int missing = bit_mask;
 
 		// the first 2 bits
-		p = Base;
+		int *p = Base;
 		for (int j=DLen[2]; j > 0; j--)
 			*p++ = *s++;
 
-		/// the left bits
+		/// the left bits, and replace missing genotypes in the last pass
 		C_UInt8 shift = NumOfBits;
 		for (int m=GenoCellCnt[i]; m > 1; m--)
 		{
-			p = Base;
-			for (int j=DLen[2]; j > 0; j--)
-			{
-				*p |= int(*s) << shift;
-				p ++; s ++;
-			}
-			shift += NumOfBits;
 			missing = (missing << NumOfBits) | bit_mask;
+			if (m > 2)
+				vec_i32_or_shl_u8(Base, s, DLen[2], shift);
+			else
+				vec_i32_or_shl_u8_replace(Base, s, DLen[2], shift, missing, NA_INTEGER);
+			s += DLen[2];
+			shift += NumOfBits;
 		}
+		if (GenoCellCnt[i] <= 1)
+			vec_i32_replace(Base, DLen[2], missing, NA_INTEGER);
 
-		for (int j=DLen[2]; j > 0; j--)
-		{
-			if (*Base == missing) *Base = NA_INTEGER;
-			Base ++;
-		}
+		Base += DLen[2];
 	}
 }
 
@@ -342,25 +338,22 @@ void CVarApplyBySample::ReadGenoData(C_UInt8 *Base)
 				warning("RAW type may not be sufficient to store genotypes.");
 		}
 
-		/// the left bits
+		/// the left bits, and replace missing genotypes in the last pass
 		C_UInt8 shift = NumOfBits;
 		for (int m=GenoCellCnt[i]; m > 1; m--)
 		{
-			p = Base;
-			for (int j=DLen[2]; j > 0; j--)
-			{
-				*p |= int(*s) << shift;
-				p ++; s ++;
-			}
-			shift += NumOfBits;
 			missing = (missing << NumOfBits) | bit_mask;
+			if ((m > 2) || (missing > 0xFF))
+				vec_u8_or_shl(Base, s, DLen[2], shift);
+			else
+				vec_u8_or_shl_replace(Base, s, DLen[2], shift, missing, NA_RAW);
+			s += DLen[2];
+			shift += NumOfBits;
 		}
+		if (GenoCellCnt[i] <= 1)
+			vec_i8_replace((C_Int8*)Base, DLen[2], missing, NA_RAW);
 
-		for (int j=DLen[2]; j > 0; j--)
-		{
-			if (*Base == missing) *Base = NA_RAW;
-			Base ++;
-		}
+		Base += DLen[2];
 	}
 }
 
@@ -498,6 +491,8 @@ COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Sample(SEXP gdsfile, SEXP var_name,
 		// the selection
 		CFileInfo &File = GetFileInfo(gdsfile);
 		TSelection &Sel = File.Selection();
+		// the iterators refer to the current selection
+		TSelLock SelLock(Sel);
 		// the GDS root node
 		PdGDSFolder Root = GDS_R_SEXP2FileRoot(gdsfile);
 
@@ -29,6 +29,23 @@ using namespace Vectorization;
 
 static const char *ERR_DIM = "Invalid dimension of '%s'.";
 
+/// the maximum number of bytes of 2-bit planes loaded in a genotype block
+static const ssize_t GENO_BLOCK_SIZE = 16 * 1024 * 1024;
+/// the maximum number of unselected 2-bit planes between two variants in a block
+static const C_Int64 GENO_BLOCK_GAP = 256;
+
+/// throw an error if a value (not missing) can not be packed in 2 bits,
+///   since 3 is used for missing values in the packed format
+static void check_pack_b2(const C_UInt8 *s, size_t n, const char *what)
+{
+	for (; n > 0; n--, s++)
+	{
+		if ((*s >= 3) && (*s != NA_RAW))
+			throw ErrSeqArray("%s greater than 2 can not be packed in 2 bits, "
+				"please use '.useraw=TRUE' instead.", what);
+	}
+}
+
 
 // =====================================================================
 // Object for reading basic variables variant by variant
@@ -163,6 +180,8 @@ CApply_Variant_Geno::CApply_Variant_Geno(): CApply_Variant()
 	SampNum = 0; Ploidy = 0;
 	UseRaw = FALSE;
 	VarIntGeno = VarRawGeno = NULL;
+	pSampBool = NULL;
+	DimSamp = DimPloidy = 0;
 }
 
 CApply_Variant_Geno::CApply_Variant_Geno(CFileInfo &File, int use_raw):
@@ -198,13 +217,16 @@ void CApply_Variant_Geno::Init(CFileInfo &File, int use_raw)
 
 	// initialize selection
 	pSampSel = File.Selection().GetStructSample();
+	pSampBool = File.Selection().pSample;
+	DimSamp = DLen[1];
+	DimPloidy = DLen[2];
 
 	ExtPtr.reset(SiteCount);
 	VarIntGeno = VarRawGeno = NULL;
 	Reset();
 }
 
-int CApply_Variant_Geno::_ReadGenoData(int *Base)
+int CApply_Variant_Geno::_ReadGenoData(int *Base, bool ReplaceNA)
 {
 	C_UInt8 NumIndexRaw;
 	C_Int64 Index;
@@ -220,26 +242,31 @@ int CApply_Variant_Geno::_ReadGenoData(int *Base)
 		int missing = bit_mask;
 		for (C_UInt8 i=1; i < NumIndexRaw; i++)
 		{
-			GDS_Iter_Position(Node, &it, (Index+1)*SiteCount);
+			GDS_Iter_Position(Node, &it, (Index+i)*SiteCount);
 			read_geno(it, (C_UInt8*)ExtPtr.get(), pSampSel);
 
-			C_UInt8 shift = i * 2;
-			C_UInt8 *s = (C_UInt8*)ExtPtr.get();
-			int *p = Base;
-			for (ssize_t n=CellCount; n > 0; n--)
-				*p++ |= int(*s++) << shift;
-
+			// merge the 2-bit plane, and replace missing genotypes in the last one
 			missing = (missing << 2) | bit_mask;
+			const C_UInt8 *s = (const C_UInt8*)ExtPtr.get();
+			if (ReplaceNA && (i == NumIndexRaw-1))
+				vec_i32_or_shl_u8_replace(Base, s, CellCount, i*2, missing, NA_INTEGER);
+			else
+				vec_i32_or_shl_u8(Base, s, CellCount, i*2);
 		}
+		if (ReplaceNA && (NumIndexRaw == 1))
+			vec_i32_replace(Base, CellCount, missing, NA_INTEGER);
 
 		return missing;
 	} else {
-		memset(Base, 0, sizeof(int)*CellCount);
+		if (ReplaceNA)
+			vec_int32_set(Base, CellCount, NA_INTEGER);
+		else
+			memset(Base, 0, sizeof(int)*CellCount);
 		return 0;
 	}
 }
 
-C_UInt8 CApply_Variant_Geno::_ReadGenoData(C_UInt8 *Base)
+C_UInt8 CApply_Variant_Geno::_ReadGenoData(C_UInt8 *Base, bool ReplaceNA)
 {
 	C_UInt8 NumIndexRaw;
 	C_Int64 Index;
@@ -261,21 +288,23 @@ C_UInt8 CApply_Variant_Geno::_ReadGenoData(C_UInt8 *Base)
 
 		for (C_UInt8 i=1; i < NumIndexRaw; i++)
 		{
-			GDS_Iter_Position(Node, &it, (Index+1)*SiteCount);
+			GDS_Iter_Position(Node, &it, (Index+i)*SiteCount);
 			read_geno(it, (C_UInt8*)ExtPtr.get(), pSampSel);
 
-			C_UInt8 shift = i * 2;
-			C_UInt8 *s = (C_UInt8*)ExtPtr.get();
-			C_UInt8 *p = Base;
-			for (ssize_t n=CellCount; n > 0; n--)
-				*p++ |= (*s++) << shift;
-
+			// merge the 2-bit plane, and replace missing genotypes in the last one
 			missing = (missing << 2) | bit_mask;
+			const C_UInt8 *s = (const C_UInt8*)ExtPtr.get();
+			if (ReplaceNA && (i == NumIndexRaw-1))
+				vec_u8_or_shl_replace(Base, s, CellCount, i*2, missing, NA_RAW);
+			else
+				vec_u8_or_shl(Base, s, CellCount, i*2);
 		}
+		if (ReplaceNA && (NumIndexRaw == 1))
+			vec_i8_replace((C_Int8*)Base, CellCount, missing, NA_RAW);
 
 		return missing;
 	} else {
-		memset(Base, 0, CellCount);
+		memset(Base, ReplaceNA ? NA_RAW : 0, CellCount);
 		return 0;
 	}
 }
@@ -287,7 +316,11 @@ void CApply_Variant_Geno::ReadData(SEXP val)
 		case INTSXP:
 			ReadGenoData(INTEGER(val)); break;
 		case RAWSXP:
-			ReadGenoData(RAW(val)); break;
+			if (UseRaw == USE_RAW_PACKED)
+				ReadGenoPacked(RAW(val));
+			else
+				ReadGenoData(RAW(val));
+			break;
 		default:
 			throw ErrSeqArray("Invalid type (%d) in CApply_Variant_Geno::ReadData()",
 				(int)TYPEOF(val));
@@ -296,6 +329,16 @@ void CApply_Variant_Geno::ReadData(SEXP val)
 
 SEXP CApply_Variant_Geno::NeedRData(int &nProtected)
 {
+	if (UseRaw == USE_RAW_PACKED)
+	{
+		if (VarRawGeno == NULL)
+		{
+			VarRawGeno = PROTECT(NEW_RAW(PackedGenoSize()));
+			nProtected ++;
+		}
+		return VarRawGeno;
+	}
+
 	bool int_type;
 	if (UseRaw == NA_INTEGER)
 	{
@@ -330,14 +373,165 @@ SEXP CApply_Variant_Geno::NeedRData(int &nProtected)
 
 void CApply_Variant_Geno::ReadGenoData(int *Base)
 {
-	int missing = _ReadGenoData(Base);
-	vec_i32_replace(Base, CellCount, missing, NA_INTEGER);
+	_ReadGenoData(Base, true);
 }
 
 void CApply_Variant_Geno::ReadGenoData(C_UInt8 *Base)
 {
-	C_UInt8 missing = _ReadGenoData(Base);
-	vec_i8_replace((C_Int8*)Base, CellCount, missing, NA_RAW);
+	_ReadGenoData(Base, true);
+}
+
+void CApply_Variant_Geno::ReadGenoPacked(C_UInt8 *Base)
+{
+	if (PackBuf.size() < (size_t)CellCount)
+		PackBuf.resize(CellCount);
+	// more than one 2-bit plane, allele indices could be greater than 2
+	if (_ReadGenoData(&PackBuf[0], true) > 3)
+		check_pack_b2(&PackBuf[0], CellCount, "Allele indices");
+	vec_u8_pack_b2(Base, &PackBuf[0], CellCount);
+}
+
+int CApply_Variant_Geno::_LoadGenoBlock(int nVariant)
+{
+	// determine the variants and 2-bit planes in the block
+	BlockNum.clear();
+	BlockIdx.clear();
+	C_Int64 PlaneStart=-1, PlaneEnd=-1, NumPlane=0;
+	C_Int32 LastPos = Position;
+	for (int k=0; k < nVariant; k++)
+	{
+		C_UInt8 NumIndexRaw;
+		C_Int64 Index;
+		GenoIndex->GetInfo(Position, Index, NumIndexRaw);
+		if (NumIndexRaw > 0)
+		{
+			if (PlaneStart < 0)
+			{
+				PlaneStart = Index;
+			} else if ((Index - PlaneEnd > GENO_BLOCK_GAP) ||
+				((NumPlane + NumIndexRaw) * CellCount > GENO_BLOCK_SIZE))
+			{
+				break;
+			}
+			NumPlane += NumIndexRaw;
+			PlaneEnd = Index + NumIndexRaw;
+		}
+		BlockNum.push_back(NumIndexRaw);
+		BlockIdx.push_back(Index);
+		LastPos = Position;
+		if ((k < nVariant-1) && !Next()) break;
+	}
+	Position = LastPos;
+
+	// load all 2-bit planes of selected samples in the block
+	if (NumPlane > 0)
+	{
+		BlockSel.assign(PlaneEnd - PlaneStart, FALSE);
+		for (size_t k=0; k < BlockNum.size(); k++)
+		{
+			C_Int64 I = BlockIdx[k] - PlaneStart;
+			for (C_UInt8 i=0; i < BlockNum[k]; i++)
+				BlockSel[I + i] = TRUE;
+		}
+		if (BlockBuf.size() < (size_t)(NumPlane * CellCount))
+			BlockBuf.resize(NumPlane * CellCount);
+
+		C_Int32 st[3] = { C_Int32(PlaneStart), 0, 0 };
+		C_Int32 cn[3] = { C_Int32(PlaneEnd - PlaneStart), DimSamp, DimPloidy };
+		const C_BOOL *ss[3] = { &BlockSel[0], pSampBool, NeedTRUEs(DimPloidy) };
+		GDS_Array_ReadDataEx(Node, st, cn, ss, &BlockBuf[0], svUInt8);
+	}
+	return BlockNum.size();
+}
+
+int CApply_Variant_Geno::ReadGenoBlock(int *Base, int nVariant)
+{
+	const int n = _LoadGenoBlock(nVariant);
+	const C_UInt8 *s = BlockBuf.empty() ? NULL : &BlockBuf[0];
+	for (int k=0; k < n; k++, Base += CellCount)
+	{
+		const C_UInt8 NumIndexRaw = BlockNum[k];
+		if (NumIndexRaw >= 1)
+		{
+			// merge 2-bit planes, and replace missing genotypes in the last one
+			memset(Base, 0, sizeof(int)*CellCount);
+			int missing = 0;
+			for (C_UInt8 i=0; i < NumIndexRaw; i++, s += CellCount)
+			{
+				missing = (missing << 2) | 0x03;
+				if (i < NumIndexRaw-1)
+					vec_i32_or_shl_u8(Base, s, CellCount, i*2);
+				else
+					vec_i32_or_shl_u8_replace(Base, s, CellCount, i*2, missing, NA_INTEGER);
+			}
+		} else
+			vec_int32_set(Base, CellCount, NA_INTEGER);
+	}
+	Next();
+	return n;
+}
+
+bool CApply_Variant_Geno::_DecodeGenoBlock(C_UInt8 *Base,
+	C_UInt8 NumIndexRaw, const C_UInt8 *s)
+{
+	if (NumIndexRaw >= 1)
+	{
+		C_UInt8 NumPlane = NumIndexRaw;
+		if (NumPlane > 4) NumPlane = 4;
+		// merge 2-bit planes, and replace missing genotypes in the last one
+		memcpy(Base, s, CellCount);
+		C_UInt8 missing = 0x03;
+		for (C_UInt8 i=1; i < NumPlane; i++)
+		{
+			missing = (missing << 2) | 0x03;
+			if (i < NumPlane-1)
+				vec_u8_or_shl(Base, s + i*CellCount, CellCount, i*2);
+			else
+				vec_u8_or_shl_replace(Base, s + i*CellCount, CellCount, i*2, missing, NA_RAW);
+		}
+		if (NumPlane == 1)
+			vec_i8_replace((C_Int8*)Base, CellCount, missing, NA_RAW);
+	} else
+		memset(Base, NA_RAW, CellCount);
+	return (NumIndexRaw <= 4);
+}
+
+int CApply_Variant_Geno::ReadGenoBlock(C_UInt8 *Base, int nVariant)
+{
+	const int n = _LoadGenoBlock(nVariant);
+	const C_UInt8 *s = BlockBuf.empty() ? NULL : &BlockBuf[0];
+	bool warn = false;
+	for (int k=0; k < n; k++, Base += CellCount)
+	{
+		if (!_DecodeGenoBlock(Base, BlockNum[k], s)) warn = true;
+		s += BlockNum[k] * CellCount;
+	}
+	if (warn)
+		warning("RAW type may not be sufficient to store genotypes.");
+	Next();
+	return n;
+}
+
+int CApply_Variant_Geno::ReadGenoBlockPacked(C_UInt8 *Base, int nVariant)
+{
+	if (PackBuf.size() < (size_t)CellCount)
+		PackBuf.resize(CellCount);
+	const int n = _LoadGenoBlock(nVariant);
+	const C_UInt8 *s = BlockBuf.empty() ? NULL : &BlockBuf[0];
+	const ssize_t size = PackedGenoSize();
+	bool warn = false;
+	for (int k=0; k < n; k++, Base += size)
+	{
+		if (!_DecodeGenoBlock(&PackBuf[0], BlockNum[k], s)) warn = true;
+		s += BlockNum[k] * CellCount;
+		if (BlockNum[k] > 1)
+			check_pack_b2(&PackBuf[0], CellCount, "Allele indices");
+		vec_u8_pack_b2(Base, &PackBuf[0], CellCount);
+	}
+	if (warn)
+		warning("RAW type may not be sufficient to store genotypes.");
+	Next();
+	return n;
 }
 
 
@@ -345,6 +539,20 @@ void CApply_Variant_Geno::ReadGenoData(C_UInt8 *Base)
 // =====================================================================
 // Object for reading genotypes variant by variant
 
+/// dosages of reference allele indexed by two 2-bit alleles (a | b << 2)
+static const C_UInt8 LUT_DOSAGE_REF[16] =
+{
+	2, 1, 1, NA_RAW, 1, 0, 0, NA_RAW, 1, 0, 0, NA_RAW,
+	NA_RAW, NA_RAW, NA_RAW, NA_RAW
+};
+
+/// dosages of alternative alleles indexed by two 2-bit alleles (a | b << 2)
+static const C_UInt8 LUT_DOSAGE_ALT[16] =
+{
+	0, 1, 1, NA_RAW, 1, 2, 2, NA_RAW, 1, 2, 2, NA_RAW,
+	NA_RAW, NA_RAW, NA_RAW, NA_RAW
+};
+
 CApply_Variant_Dosage::CApply_Variant_Dosage(CFileInfo &File, int use_raw, bool alt):
 	CApply_Variant_Geno(File, use_raw)
 {
@@ -362,7 +570,12 @@ void CApply_Variant_Dosage::ReadData(SEXP val)
 			if (IsAlt) ReadDosageAlt(INTEGER(val)); else ReadDosage(INTEGER(val));
 			break;
 		case RAWSXP:
-			if (IsAlt) ReadDosageAlt(RAW(val)); else ReadDosage(RAW(val));
+			if (UseRaw == USE_RAW_PACKED)
+				ReadDosagePacked(RAW(val));
+			else if (IsAlt)
+				ReadDosageAlt(RAW(val));
+			else
+				ReadDosage(RAW(val));
 			break;
 		default:
 			throw ErrSeqArray("Invalid type (%d) in CApply_Variant_Dosage::ReadData()",
@@ -374,15 +587,41 @@ SEXP CApply_Variant_Dosage::NeedRData(int &nProtected)
 {
 	if (VarDosage == NULL)
 	{
-		VarDosage = UseRaw ? NEW_RAW(SampNum) : NEW_INTEGER(SampNum);
+		if (UseRaw == USE_RAW_PACKED)
+			VarDosage = NEW_RAW((SampNum + 3) / 4);
+		else
+			VarDosage = UseRaw ? NEW_RAW(SampNum) : NEW_INTEGER(SampNum);
 		PROTECT(VarDosage);
 		nProtected ++;
 	}
 	return VarDosage;
 }
 
+const C_UInt8 *CApply_Variant_Dosage::_ReadGeno2Plane()
+{
+	if (Ploidy != 2) return NULL;
+	C_UInt8 NumIndexRaw;
+	C_Int64 Index;
+	GenoIndex->GetInfo(Position, Index, NumIndexRaw);
+	if (NumIndexRaw != 1) return NULL;
+
+	CdIterator it;
+	GDS_Iter_Position(Node, &it, Index*SiteCount);
+	C_UInt8 *p = (C_UInt8 *)ExtPtr2.get();
+	read_geno(it, p, pSampSel);
+	return p;
+}
+
 void CApply_Variant_Dosage::ReadDosage(int *Base)
 {
+	// biallelic diploid site
+	const C_UInt8 *s = _ReadGeno2Plane();
+	if (s)
+	{
+		vec_u8_geno2_lut_i32(s, Base, SampNum, LUT_DOSAGE_REF);
+		return;
+	}
+
 	int *p = (int *)ExtPtr2.get();
 	int missing = _ReadGenoData(p);
 
@@ -409,6 +648,14 @@ void CApply_Variant_Dosage::ReadDosage(int *Base)
 
 void CApply_Variant_Dosage::ReadDosageAlt(int *Base)
 {
+	// biallelic diploid site
+	const C_UInt8 *s = _ReadGeno2Plane();
+	if (s)
+	{
+		vec_u8_geno2_lut_i32(s, Base, SampNum, LUT_DOSAGE_ALT);
+		return;
+	}
+
 	int *p = (int *)ExtPtr2.get();
 	int missing = _ReadGenoData(p);
 
@@ -435,6 +682,14 @@ void CApply_Variant_Dosage::ReadDosageAlt(int *Base)
 
 void CApply_Variant_Dosage::ReadDosage(C_UInt8 *Base)
 {
+	// biallelic diploid site
+	const C_UInt8 *s = _ReadGeno2Plane();
+	if (s)
+	{
+		vec_u8_geno2_lut(s, Base, SampNum, LUT_DOSAGE_REF);
+		return;
+	}
+
 	C_UInt8 *p = (C_UInt8 *)ExtPtr2.get();
 	C_UInt8 missing = _ReadGenoData(p);
 
@@ -444,7 +699,6 @@ void CApply_Variant_Dosage::ReadDosage(C_UInt8 *Base)
 		vec_i8_cnt_dosage2((int8_t *)p, (int8_t *)Base, SampNum, 0,
 			missing, NA_RAW);
 	} else {
-		C_UInt8 *p = (C_UInt8 *)ExtPtr.get();
 		for (int n=SampNum; n > 0; n--)
 		{
 			C_UInt8 cnt = 0;
@@ -463,6 +717,14 @@ void CApply_Variant_Dosage::ReadDosage(C_UInt8 *Base)
 
 void CApply_Variant_Dosage::ReadDosageAlt(C_UInt8 *Base)
 {
+	// biallelic diploid site
+	const C_UInt8 *s = _ReadGeno2Plane();
+	if (s)
+	{
+		vec_u8_geno2_lut(s, Base, SampNum, LUT_DOSAGE_ALT);
+		return;
+	}
+
 	C_UInt8 *p = (C_UInt8 *)ExtPtr2.get();
 	C_UInt8 missing = _ReadGenoData(p);
 
@@ -472,7 +734,6 @@ void CApply_Variant_Dosage::ReadDosageAlt(C_UInt8 *Base)
 		vec_i8_cnt_dosage_alt2((int8_t *)p, (int8_t *)Base, SampNum, 0,
 			missing, NA_RAW);
 	} else {
-		C_UInt8 *p = (C_UInt8 *)ExtPtr.get();
 		for (int n=SampNum; n > 0; n--)
 		{
 			C_UInt8 cnt = 0;
@@ -489,6 +750,19 @@ void CApply_Variant_Dosage::ReadDosageAlt(C_UInt8 *Base)
 	}
 }
 
+void CApply_Variant_Dosage::ReadDosagePacked(C_UInt8 *Base)
+{
+	if (PackBuf.size() < (size_t)SampNum)
+		PackBuf.resize(SampNum);
+	if (IsAlt)
+		ReadDosageAlt(&PackBuf[0]);
+	else
+		ReadDosage(&PackBuf[0]);
+	if (Ploidy > 2)
+		check_pack_b2(&PackBuf[0], SampNum, "Dosages");
+	vec_u8_pack_b2(Base, &PackBuf[0], SampNum);
+}
+
 
 
 // =====================================================================
@@ -829,10 +1103,7 @@ COREARRAY_DLL_LOCAL const char *Txt_Apply_VarIdx[] =
 COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Variant(SEXP gdsfile, SEXP var_name,
 	SEXP FUN, SEXP as_is, SEXP var_index, SEXP param, SEXP rho)
 {
-	SEXP pam_use_raw = RGetListElement(param, "useraw");
-	if (!Rf_isLogical(pam_use_raw))
-		error("'.useraw' must be TRUE, FALSE or NA.");
-	int use_raw_flag = Rf_asLogical(pam_use_raw);
+	int use_raw_flag = GetUseRaw(RGetListElement(param, "useraw"));
 
 	int prog_flag = Rf_asLogical(RGetListElement(param, "progress"));
 	if (prog_flag == NA_LOGICAL)
@@ -846,6 +1117,8 @@ COREARRAY_DLL_EXPORT SEXP SEQ_Apply_Variant(SEXP gdsfile, SEXP var_name,
 
 		// the selection
 		CFileInfo &File = GetFileInfo(gdsfile);
+		// the iterators refer to the current selection
+		TSelLock SelLock(File.Selection());
 
 		// the number of calling PROTECT
 		int nProtected = 0;
@@ -81,14 +81,27 @@ protected:
 	CGenoIndex *GenoIndex;  ///< indexing genotypes
 	ssize_t SiteCount;  ///< the total number of entries at a site
 	ssize_t CellCount;  ///< the selected number of entries at a site
-	int UseRaw;  ///< whether use RAW type: FALSE, int; TRUE, raw; NA: auto
+	int UseRaw;  ///< whether use RAW type: FALSE, int; TRUE, raw; NA: auto; USE_RAW_PACKED: packed 2-bit raw
 	TSelection::TSampStruct *pSampSel;   ///< the structure for selected samples
 	VEC_AUTO_PTR ExtPtr;  ///< a pointer to the additional buffer
 	SEXP VarIntGeno;    ///< genotype R integer object
 	SEXP VarRawGeno;    ///< genotype R RAW object
-
-	inline int _ReadGenoData(int *Base);
-	inline C_UInt8 _ReadGenoData(C_UInt8 *Base);
+	C_BOOL *pSampBool;  ///< sample selection for all samples
+	C_Int32 DimSamp;    ///< the total number of samples in 'genotype/data'
+	C_Int32 DimPloidy;  ///< the size of the third dimension of 'genotype/data'
+	vector<C_BOOL> BlockSel;   ///< the selection of 2-bit planes in a block
+	vector<C_UInt8> BlockBuf;  ///< the 2-bit planes of selected samples in a block
+	vector<C_UInt8> BlockNum;  ///< the number of 2-bit planes for each variant in a block
+	vector<C_Int64> BlockIdx;  ///< the starting 2-bit plane for each variant in a block
+	vector<C_UInt8> PackBuf;   ///< the unpacked genotypes or dosages for packing
+
+	/// read genotypes and return the missing value, or replace missing genotypes by NA if ReplaceNA
+	inline int _ReadGenoData(int *Base, bool ReplaceNA=false);
+	inline C_UInt8 _ReadGenoData(C_UInt8 *Base, bool ReplaceNA=false);
+	/// load the 2-bit planes of at most nVariant selected variants in a single call
+	int _LoadGenoBlock(int nVariant);
+	/// decode genotypes from 2-bit planes, return false if RAW is not sufficient
+	bool _DecodeGenoBlock(C_UInt8 *Base, C_UInt8 NumIndexRaw, const C_UInt8 *s);
 
 public:
 	ssize_t SampNum;  ///< the number of selected samples
@@ -107,6 +120,18 @@ public:
 	void ReadGenoData(int *Base);
 	/// read genotypes in unsigned 8-bit intetger
 	void ReadGenoData(C_UInt8 *Base);
+
+	/// read genotypes of at most nVariant variants in 32-bit integer, move to the next variant after the block and return the number of variants read
+	int ReadGenoBlock(int *Base, int nVariant);
+	/// read genotypes of at most nVariant variants in unsigned 8-bit intetger, move to the next variant after the block and return the number of variants read
+	int ReadGenoBlock(C_UInt8 *Base, int nVariant);
+
+	/// the number of bytes for the packed 2-bit genotypes of a variant
+	inline ssize_t PackedGenoSize() const { return (CellCount + 3) / 4; }
+	/// read genotypes in packed 2-bit format (3 for missing or allele index >= 3)
+	void ReadGenoPacked(C_UInt8 *Base);
+	/// read genotypes of at most nVariant variants in packed 2-bit format, move to the next variant after the block and return the number of variants read
+	int ReadGenoBlockPacked(C_UInt8 *Base, int nVariant);
 };
 
 
@@ -119,6 +144,9 @@ protected:
 	SEXP VarDosage;        ///< dosage R object
 	VEC_AUTO_PTR ExtPtr2;  ///< a pointer to the additional buffer for dosages
 	bool IsAlt;            ///< if true, ReadData() returns the dosage of alternative alleles
+
+	/// read the only 2-bit plane of a biallelic diploid site, otherwise return NULL
+	inline const C_UInt8 *_ReadGeno2Plane();
 public:
 	/// constructor
 	CApply_Variant_Dosage(CFileInfo &File, int use_raw, bool alt);
@@ -134,6 +162,8 @@ public:
 	void ReadDosage(C_UInt8 *Base);
 	/// read dosages of alternative alleles in unsigned 8-bit intetger
 	void ReadDosageAlt(C_UInt8 *Base);
+	/// read dosages in packed 2-bit format (3 for missing or dosage >= 3)
+	void ReadDosagePacked(C_UInt8 *Base);
 };
 
 
@@ -87,7 +87,10 @@ COREARRAY_DLL_EXPORT SEXP SEQ_FilterPushEmpty(SEXP gdsfile)
 			CFileInfo &f = it->second;
 			TSelection &s = f.Push_Selection(false, false);
 			memset(s.pSample, TRUE, f.SampleNum());
+			s.SetCountSample(f.SampleNum(), 0, f.SampleNum());
 			memset(s.pVariant, TRUE, f.VariantNum());
+			s.varTrueNum = s.varEnd = f.VariantNum();
+			s.varStart = 0;
 		} else
 			throw ErrSeqArray("The GDS file is closed or invalid.");
 	COREARRAY_CATCH
@@ -126,6 +129,58 @@ COREARRAY_DLL_EXPORT SEXP SEQ_FilterPop(SEXP gdsfile)
 }
 
 
+/// get the sorted indices of the IDs stored in a GDS node, using the cached
+///   hash index of the file
+static void get_id_index(CFileInfo &File, const char *varname, SEXP ID,
+	bool skip_na, vector<C_Int32> &out)
+{
+	out.clear();
+	const R_xlen_t n = XLENGTH(ID);
+	if (Rf_isInteger(ID))
+	{
+		CIdIndex &Idx = File.IdIndex(varname, svInt32);
+		const int *p = INTEGER(ID);
+		for (R_xlen_t i=0; i < n; i++)
+			Idx.Find((C_Int32)p[i], out);
+	} else if (Rf_isReal(ID))
+	{
+		CIdIndex &Idx = File.IdIndex(varname, svFloat64);
+		const double *p = REAL(ID);
+		for (R_xlen_t i=0; i < n; i++)
+			Idx.Find(p[i], out);
+	} else if (Rf_isString(ID))
+	{
+		CIdIndex &Idx = File.IdIndex(varname, svStrUTF8);
+		for (R_xlen_t i=0; i < n; i++)
+		{
+			SEXP s = STRING_ELT(ID, i);
+			if (skip_na && (s == NA_STRING)) continue;
+			Idx.Find(CHAR(s), out);
+		}
+	}
+	sort(out.begin(), out.end());
+	out.resize(unique(out.begin(), out.end()) - out.begin());
+}
+
+/// set the selection according to the sorted indices (keeping only the
+///   selected ones if intersect), where all TRUEs are in [start, end)
+static void set_sel_index(C_BOOL *sel, size_t start, size_t end,
+	vector<C_Int32> &idx, bool intersect)
+{
+	if (intersect)
+	{
+		size_t k = 0;
+		for (size_t i=0; i < idx.size(); i++)
+			if (sel[idx[i]]) idx[k++] = idx[i];
+		idx.resize(k);
+	}
+	if (end > start)
+		memset(sel + start, FALSE, end - start);
+	for (size_t i=0; i < idx.size(); i++)
+		sel[idx[i]] = TRUE;
+}
+
+
 /// set a working space with selected sample id
 COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample(SEXP gdsfile, SEXP samp_id,
 	SEXP intersect, SEXP verbose)
@@ -137,7 +192,6 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample(SEXP gdsfile, SEXP samp_id,
 		int nProtected = 0;
 		CFileInfo &File = GetFileInfo(gdsfile);
 		TSelection &Sel = File.Selection();
-		Sel.ClearStructSample();
 
 		C_BOOL *pArray = Sel.pSample;
 		int Count = File.SampleNum();
@@ -149,77 +203,25 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample(SEXP gdsfile, SEXP samp_id,
 			nProtected ++;
 		}
 
-		if (Rf_isInteger(samp_id))
-		{
-			// initialize
-			set<int> set_id;
-			set_id.insert(INTEGER(samp_id), INTEGER(samp_id) + XLENGTH(samp_id));
-			// sample id
-			vector<int> sample_id(Count);
-			C_Int32 _st=0, _cnt=Count;
-			GDS_Array_ReadData(varSamp, &_st, &_cnt, &sample_id[0], svInt32);
-
-			// set selection
-			if (!intersect_flag)
-			{
-				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(sample_id[i]) != set_id.end());
-			} else {
-				for (int i=0; i < Count; i++, pArray++)
-				{
-					if (*pArray)
-						*pArray = (set_id.find(sample_id[i]) != set_id.end());
-				}
-			}
-		} else if (Rf_isReal(samp_id))
+		if (Rf_isInteger(samp_id) || Rf_isReal(samp_id) || Rf_isString(samp_id))
 		{
-			// initialize
-			set<double> set_id;
-			set_id.insert(REAL(samp_id), REAL(samp_id) + XLENGTH(samp_id));
-			// sample id
-			vector<double> sample_id(Count);
-			C_Int32 _st=0, _cnt=Count;
-			GDS_Array_ReadData(varSamp, &_st, &_cnt, &sample_id[0], svFloat64);
-
+			// the indices of sample IDs
+			vector<C_Int32> idx;
+			get_id_index(File, "sample.id", samp_id, false, idx);
 			// set selection
-			if (!intersect_flag)
-			{
-				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(sample_id[i]) != set_id.end());
-			} else {
-				for (int i=0; i < Count; i++, pArray++)
-				{
-					if (*pArray)
-						*pArray = (set_id.find(sample_id[i]) != set_id.end());
-				}
-			}
-		} else if (Rf_isString(samp_id))
-		{
-			// initialize
-			set<string> set_id;
-			R_xlen_t m = XLENGTH(samp_id);
-			for (R_xlen_t i=0; i < m; i++)
-				set_id.insert(string(CHAR(STRING_ELT(samp_id, i))));
-			// sample id
-			vector<string> sample_id(Count);
-			C_Int32 _st=0, _cnt=Count;
-			GDS_Array_ReadData(varSamp, &_st, &_cnt, &sample_id[0], svStrUTF8);
-
-			// set selection
-			if (!intersect_flag)
-			{
-				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(sample_id[i]) != set_id.end());
-			} else {
-				for (int i=0; i < Count; i++, pArray++)
-				{
-					if (*pArray)
-						*pArray = (set_id.find(sample_id[i]) != set_id.end());
-				}
-			}
+			Sel.GetCountSample();
+			set_sel_index(pArray, Sel.sampStart, Sel.sampEnd, idx,
+				intersect_flag);
+			Sel.ClearStructSample();
+			if (!idx.empty())
+				Sel.SetCountSample(idx.size(), idx.front(), idx.back() + 1);
+			else
+				Sel.SetCountSample(0, 0, 0);
 		} else if (Rf_isNull(samp_id))
 		{
+			Sel.ClearStructSample();
 			memset(pArray, TRUE, Count);
+			Sel.SetCountSample(Count, 0, Count);
 		} else
 			throw ErrSeqArray("Invalid type of 'sample.id'.");
 
@@ -328,7 +330,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample2(SEXP gdsfile, SEXP samp_sel,
 				// get the current index
 				vector<int> Idx;
 				Idx.reserve(Cnt);
-				for (int i=0; i < Count; i++)
+				for (ssize_t i=Sel.sampStart; i < Sel.sampEnd; i++)
 				{
 					if (pArray[i]) Idx.push_back(i);
 				}
@@ -340,10 +342,12 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceSample2(SEXP gdsfile, SEXP samp_sel,
 					int I = *pI ++;
 					if (I != NA_INTEGER) pArray[Idx[I-1]] = TRUE;
 				}
+				Sel.ClearStructSample();
 			}
 		} else if (Rf_isNull(samp_sel))
 		{
 			memset(pArray, TRUE, Count);
+			Sel.SetCountSample(Count, 0, Count);
 		} else
 			throw ErrSeqArray("Invalid type of 'sample.sel'.");
 
@@ -365,7 +369,6 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceVariant(SEXP gdsfile, SEXP var_id,
 		int nProtected = 0;
 		CFileInfo &File = GetFileInfo(gdsfile);
 		TSelection &Sel = File.Selection();
-		Sel.ClearStructVariant();
 
 		C_BOOL *pArray = Sel.pVariant;
 		int Count = File.VariantNum();
@@ -377,77 +380,26 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceVariant(SEXP gdsfile, SEXP var_id,
 			nProtected ++;
 		}
 
-		if (Rf_isInteger(var_id))
-		{
-			// initialize
-			set<int> set_id;
-			set_id.insert(INTEGER(var_id), INTEGER(var_id) + XLENGTH(var_id));
-			// sample id
-			vector<int> var_id(Count);
-			C_Int32 _st=0, _cnt=Count;
-			GDS_Array_ReadData(varVariant, &_st, &_cnt, &var_id[0], svInt32);
-
-			// set selection
-			if (!intersect_flag)
-			{
-				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(var_id[i]) != set_id.end());
-			} else {
-				for (int i=0; i < Count; i++, pArray++)
-				{
-					if (*pArray)
-						*pArray = (set_id.find(var_id[i]) != set_id.end());
-				}
-			}
-		} else if (Rf_isReal(var_id))
-		{
-			// initialize
-			set<double> set_id;
-			set_id.insert(REAL(var_id), REAL(var_id) + XLENGTH(var_id));
-			// variant id
-			vector<double> var_id(Count);
-			C_Int32 _st=0, _cnt=Count;
-			GDS_Array_ReadData(varVariant, &_st, &_cnt, &var_id[0], svFloat64);
-
-			// set selection
-			if (!intersect_flag)
-			{
-				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(var_id[i]) != set_id.end());
-			} else {
-				for (int i=0; i < Count; i++, pArray++)
-				{
-					if (*pArray)
-						*pArray = (set_id.find(var_id[i]) != set_id.end());
-				}
-			}
-		} else if (Rf_isString(var_id))
+		if (Rf_isInteger(var_id) || Rf_isReal(var_id) || Rf_isString(var_id))
 		{
-			// initialize
-			set<string> set_id;
-			R_xlen_t m = XLENGTH(var_id);
-			for (R_xlen_t i=0; i < m; i++)
-				set_id.insert(string(CHAR(STRING_ELT(var_id, i))));
-			// variant id
-			vector<string> var_id(Count);
-			C_Int32 _st=0, _cnt=Count;
-			GDS_Array_ReadData(varVariant, &_st, &_cnt, &var_id[0], svStrUTF8);
-
+			// the indices of variant IDs
+			vector<C_Int32> idx;
+			get_id_index(File, "variant.id", var_id, false, idx);
 			// set selection
-			if (!intersect_flag)
+			Sel.GetStructVariant();
+			set_sel_index(pArray, Sel.varStart, Sel.varEnd, idx,
+				intersect_flag);
+			Sel.varTrueNum = idx.size();
+			if (!idx.empty())
 			{
-				for (int i=0; i < Count; i++)
-					*pArray++ = (set_id.find(var_id[i]) != set_id.end());
-			} else {
-				for (int i=0; i < Count; i++, pArray++)
-				{
-					if (*pArray)
-						*pArray = (set_id.find(var_id[i]) != set_id.end());
-				}
-			}
+				Sel.varStart = idx.front(); Sel.varEnd = idx.back() + 1;
+			} else
+				Sel.varStart = Sel.varEnd = 0;
 		} else if (Rf_isNull(var_id))
 		{
 			memset(pArray, TRUE, Count);
+			Sel.varStart = 0;
+			Sel.varEnd = Sel.varTrueNum = Count;
 		} else
 			throw ErrSeqArray("Invalid type of 'variant.id'.");
 
@@ -568,9 +520,10 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceVariant2(SEXP gdsfile, SEXP var_sel,
 					}
 				}
 				// set the structure of selected variants
+				if (num <= 0) st = ed = 0;
 				Sel.varTrueNum = num;
 				Sel.varStart = st;
-				Sel.varEnd = (ed < st) ? st : ed;
+				Sel.varEnd = ed;
 			} else {
 				int Cnt = File.VariantSelNum();
 				R_xlen_t N = XLENGTH(var_sel);
@@ -580,7 +533,7 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceVariant2(SEXP gdsfile, SEXP var_sel,
 				// get the current index
 				vector<int> Idx;
 				Idx.reserve(Cnt);
-				for (int i=0; i < Count; i++)
+				for (ssize_t i=Sel.varStart; i < Sel.varEnd; i++)
 				{
 					if (pArray[i]) Idx.push_back(i);
 				}
@@ -618,6 +571,139 @@ static bool is_numeric(const string &txt)
 	return (endptr != txt.c_str()) && (*endptr == 0);
 }
 
+typedef CRangeSet::TRange TBpRange;
+
+static bool less_bp_start(const TBpRange &lhs, const TBpRange &rhs)
+{
+	return lhs.Start < rhs.Start;
+}
+
+static bool less_bp_end(const TBpRange &rng, int pos)
+{
+	return rng.End < pos;
+}
+
+/// sort and merge overlapping or adjacent ranges (as CRangeSet)
+static void merge_bp_ranges(vector<TBpRange> &rng)
+{
+	if (rng.size() <= 1) return;
+	sort(rng.begin(), rng.end(), less_bp_start);
+	vector<TBpRange>::iterator p = rng.begin(), it = p + 1;
+	for (; it != rng.end(); it++)
+	{
+		if (it->Start-1 <= p->End)
+		{
+			if (it->End > p->End) p->End = it->End;
+		} else
+			*(++p) = *it;
+	}
+	rng.resize(p - rng.begin() + 1);
+}
+
+/// select the variants in a block according to the sorted and non-overlapping
+///   ranges, by sweeping the positions and ranges together
+static size_t select_bp_ranges(const C_Int32 *pos, C_BOOL *sel, size_t n,
+	const TBpRange *rng, size_t nrng, bool intersect, ssize_t &first,
+	ssize_t &last, ssize_t offset)
+{
+	const TBpRange *p = rng, *end = rng + nrng;
+	size_t num = 0;
+	C_Int32 prev = (n > 0) ? pos[0] : 0;
+	p = lower_bound(p, end, prev, less_bp_end);
+	for (size_t i=0; i < n; i++)
+	{
+		if (intersect && !sel[i]) continue;
+		C_Int32 x = pos[i];
+		if (x >= prev)
+		{
+			// sorted positions, move forward
+			while (p<end && p->End<x) p++;
+		} else {
+			// unsorted positions, use binary search
+			p = lower_bound(rng, end, x, less_bp_end);
+		}
+		prev = x;
+		if (p<end && p->Start<=x)
+		{
+			sel[i] = TRUE; num ++;
+			ssize_t j = offset + i;
+			if (first < 0 || j < first) first = j;
+			if (j > last) last = j;
+		} else if (intersect)
+			sel[i] = FALSE;
+	}
+	return num;
+}
+
+/// select the variants in [start, end) of a chromosome block according to
+///   the sorted and non-overlapping ranges, using the position index if the
+///   number of ranges is small relative to the number of variants
+static size_t select_bp_block(CPosIndex &PosIdx, const C_Int32 *pos,
+	C_BOOL *sel, size_t start, size_t end, const vector<TBpRange> &rng,
+	bool intersect, ssize_t &first, ssize_t &last)
+{
+	const size_t n = end - start;
+	const bool sorted = PosIdx.IsSorted(start);
+	const size_t cost = rng.size() * (sorted ? 32 : CPosIndex::SUB_BLOCK);
+	if ((cost >= n) || (intersect && !sorted))
+	{
+		return select_bp_ranges(pos + start, sel + start, n, &rng[0],
+			rng.size(), intersect, first, last, start);
+	}
+
+	size_t num = 0, i = start;
+	vector<CPosIndex::TSpan> spans;
+	vector<TBpRange>::const_iterator r;
+	for (r=rng.begin(); r != rng.end(); r++)
+	{
+		spans.clear();
+		PosIdx.Find(start, end, r->Start, r->End, spans);
+		vector<CPosIndex::TSpan>::const_iterator p;
+		for (p=spans.begin(); p != spans.end(); p++)
+		{
+			const size_t m = p->End - p->Start;
+			if (intersect)
+			{
+				// sorted, the spans are ordered and exact
+				memset(sel + i, FALSE, p->Start - i);
+				size_t cnt = GetNumOfTRUE(sel + p->Start, m);
+				if (cnt > 0)
+				{
+					C_BOOL *s = sel + p->Start, *e = sel + p->End;
+					C_BOOL *s1 = VEC_BOOL_FIND_TRUE(s, e);
+					if (first < 0) first = s1 - sel;
+					while (!*(e-1)) e--;
+					last = (e - 1) - sel;
+					num += cnt;
+				}
+				i = p->End;
+			} else if (p->Exact)
+			{
+				memset(sel + p->Start, TRUE, m);
+				num += m;
+				if (first < 0 || (ssize_t)p->Start < first) first = p->Start;
+				if ((ssize_t)p->End - 1 > last) last = p->End - 1;
+			} else {
+				num += select_bp_ranges(pos + p->Start, sel + p->Start, m,
+					&(*r), 1, false, first, last, p->Start);
+			}
+		}
+	}
+	if (intersect)
+		memset(sel + i, FALSE, end - i);
+	return num;
+}
+
+/// variant block of a chromosome with the associated ranges
+struct COREARRAY_DLL_LOCAL TBpBlock
+{
+	size_t Start;   ///< the starting variant index
+	size_t Length;  ///< the number of variants
+	const vector<TBpRange> *Range;  ///< the merged ranges
+	bool operator< (const TBpBlock &v) const { return Start < v.Start; }
+};
+
+
 /// set a working space flag with selected chromosome(s)
 COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceChrom(SEXP gdsfile, SEXP include,
 	SEXP is_num, SEXP frombp, SEXP tobp, SEXP intersect, SEXP verbose)
@@ -656,10 +742,98 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceChrom(SEXP gdsfile, SEXP include,
 
 		CFileInfo &File = GetFileInfo(gdsfile);
 		TSelection &Sel = File.Selection();
-		Sel.ClearStructVariant();
-
 		const size_t array_size = File.VariantNum();
 		C_BOOL *sel_array = Sel.pVariant;
+
+		if (pFrom && pTo)
+		{
+			// include != NULL, with from.bp and to.bp
+			const C_Int32 *varPos = &File.Position()[0];
+			CChromIndex &Chrom = File.Chromosome();
+			CPosIndex &PosIdx = File.PosIndex();
+			map<string, vector<TBpRange> > RngSets;  // Chromosome ==> ranges
+
+			R_xlen_t n = XLENGTH(include);
+			for (R_xlen_t idx=0; idx < n; idx++)
+			{
+				string s = CHAR(STRING_ELT(include, idx));
+				if (IsNum == TRUE)
+				{
+					if (!is_numeric(s)) continue;
+				} else if (IsNum == FALSE)
+				{
+					if (is_numeric(s)) continue;
+				}
+				if (Chrom.Map.find(s) != Chrom.Map.end())
+				{
+					TBpRange rng;
+					rng.Start = pFrom[idx]; rng.End = pTo[idx];
+					if (rng.Start == NA_INTEGER) rng.Start = 0;
+					if (rng.End == NA_INTEGER) rng.End = 2147483647;
+					if (rng.End < rng.Start) rng.End = rng.Start;
+					RngSets[s].push_back(rng);
+				}
+			}
+
+			// the variant blocks of the chromosomes involved
+			vector<TBpBlock> Blocks;
+			map<string, vector<TBpRange> >::iterator it;
+			for (it=RngSets.begin(); it != RngSets.end(); it++)
+			{
+				merge_bp_ranges(it->second);
+				CChromIndex::TRangeList &rng = Chrom.Map[it->first];
+				vector<CChromIndex::TRange>::const_iterator p;
+				for (p=rng.begin(); p != rng.end(); p++)
+				{
+					TBpBlock b;
+					b.Start = p->Start; b.Length = p->Length;
+					b.Range = &it->second;
+					Blocks.push_back(b);
+				}
+			}
+			sort(Blocks.begin(), Blocks.end());
+
+			// only the variants in the previous selection are visited if intersect
+			size_t st = 0, ed = array_size;
+			if (IsIntersect)
+			{
+				Sel.GetStructVariant();
+				st = Sel.varStart; ed = Sel.varEnd;
+			} else
+				Sel.ClearSelectVariant();
+
+			size_t num = 0, i = st;
+			ssize_t first = -1, last = -1;
+			vector<TBpBlock>::const_iterator p;
+			for (p=Blocks.begin(); p != Blocks.end(); p++)
+			{
+				size_t bs = std::max(p->Start, st);
+				size_t be = std::min(p->Start + p->Length, ed);
+				if (bs >= be) continue;
+				if (IsIntersect && i < bs)
+					memset(sel_array + i, FALSE, bs - i);
+				num += select_bp_block(PosIdx, varPos, sel_array, bs, be,
+					*p->Range, IsIntersect, first, last);
+				i = be;
+			}
+			if (IsIntersect && i < ed)
+				memset(sel_array + i, FALSE, ed - i);
+
+			// set the structure of selected variants
+			Sel.varTrueNum = num;
+			if (num > 0)
+			{
+				Sel.varStart = first; Sel.varEnd = last + 1;
+			} else
+				Sel.varStart = Sel.varEnd = 0;
+
+			if (Rf_asLogical(verbose) == TRUE)
+				Rprintf(INFO_SEL_NUM_VARIANT, PrettyInt(num));
+			UNPROTECT(nProtected);
+			return rv_ans;
+		}
+
+		Sel.ClearStructVariant();
 		vector<C_BOOL> tmp_array;
 		if (IsIntersect) tmp_array.resize(array_size);
 
@@ -691,14 +865,8 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceChrom(SEXP gdsfile, SEXP include,
 			}
 
 		} else {
-			// include != NULL
-			vector<C_Int32> *varPos = NULL;
-			if (pFrom && pTo)
-				varPos = &File.Position();
-
+			// include != NULL, no from.bp and to.bp
 			CChromIndex &Chrom = File.Chromosome();
-			map<string, CRangeSet> RngSets;  // Chromosome ==> CRangeSet
-
 			R_xlen_t n = XLENGTH(include);
 			for (R_xlen_t idx=0; idx < n; idx++)
 			{
@@ -715,64 +883,117 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceChrom(SEXP gdsfile, SEXP include,
 					Chrom.Map.find(s);
 				if (it != Chrom.Map.end())
 				{
-					if (varPos)
+					CChromIndex::TRangeList &rng = it->second;
+					vector<CChromIndex::TRange>::iterator p;
+					for (p=rng.begin(); p != rng.end(); p++)
 					{
-						// if specify from.bp and to.bp
-						int from = pFrom[idx], to = pTo[idx];
-						if (from == NA_INTEGER) from = 0;
-						if (to == NA_INTEGER) to = 2147483647;
-						RngSets[s].AddRange(from, to);
-					} else {
-						// no from.bp and to.bp
-						CChromIndex::TRangeList &rng = it->second;
-						vector<CChromIndex::TRange>::iterator p;
-						for (p=rng.begin(); p != rng.end(); p++)
-						{
-							memset(&array[p->Start], TRUE, p->Length);
-						}
+						memset(&array[p->Start], TRUE, p->Length);
 					}
 				}
 			}
+		}
 
-			if (varPos)
+		if (IsIntersect)
+		{
+			// TODO: optimized by SIMD
+			C_BOOL *p = sel_array, *s = array;
+			for (size_t n=array_size; n > 0; n--)
+				(*p++) &= (*s++);
+		}
+		if (Rf_asLogical(verbose) == TRUE)
+			Rprintf(INFO_SEL_NUM_VARIANT, PrettyInt(File.VariantSelNum()));
+
+		UNPROTECT(nProtected);
+
+	COREARRAY_CATCH
+}
+
+
+/// set a working space flag with selected chromosomes and positions
+COREARRAY_DLL_EXPORT SEXP SEQ_SetSpacePos(SEXP gdsfile, SEXP chr, SEXP pos,
+	SEXP intersect, SEXP multi_pos, SEXP verbose)
+{
+	const bool IsIntersect = (Rf_asLogical(intersect) == TRUE);
+	const bool MultiPos = (Rf_asLogical(multi_pos) == TRUE);
+
+	COREARRAY_TRY
+
+		CFileInfo &File = GetFileInfo(gdsfile);
+		TSelection &Sel = File.Selection();
+		C_BOOL *sel_array = Sel.pVariant;
+
+		// chromosome ==> positions
+		map<string, vector<int> > PosSets;
+		const R_xlen_t nchr = XLENGTH(chr), n = XLENGTH(pos);
+		const int *pPos = INTEGER(pos);
+		for (R_xlen_t i=0; i < n; i++)
+		{
+			if (pPos[i] == NA_INTEGER) continue;
+			SEXP s = STRING_ELT(chr, (nchr > 1) ? i : 0);
+			PosSets[CHAR(s)].push_back(pPos[i]);
+		}
+
+		// the candidate variants
+		size_t st = 0, ed = File.VariantNum();
+		if (IsIntersect)
+		{
+			Sel.GetStructVariant();
+			st = Sel.varStart; ed = Sel.varEnd;
+		}
+
+		vector<size_t> hits;
+		if (ed > st && !PosSets.empty())
+		{
+			CChromIndex &Chrom = File.Chromosome();
+			const C_Int32 *varPos = &File.Position()[0];
+			CPosIndex &PosIdx = File.PosIndex();
+			vector<CPosIndex::TSpan> spans;
+
+			map<string, vector<int> >::iterator it;
+			for (it=PosSets.begin(); it != PosSets.end(); it++)
 			{
-				// Chromosome ==> CRangeSet
-				map<string, CRangeSet>::iterator it;
-				for (it=RngSets.begin(); it != RngSets.end(); it++)
+				map<string, CChromIndex::TRangeList>::iterator ic =
+					Chrom.Map.find(it->first);
+				if (ic == Chrom.Map.end()) continue;
+				const CChromIndex::TRangeList &rng = ic->second;
+				vector<int> &P = it->second;
+				sort(P.begin(), P.end());
+				P.resize(unique(P.begin(), P.end()) - P.begin());
+
+				vector<CChromIndex::TRange>::const_iterator p;
+				for (p=rng.begin(); p != rng.end(); p++)
 				{
-					CChromIndex::TRangeList &rng = Chrom.Map[it->first];
-					CRangeSet &RngSet = it->second;
-					vector<CChromIndex::TRange>::const_iterator p;
-					for (p=rng.begin(); p != rng.end(); p++)
+					size_t bs = std::max((size_t)p->Start, st);
+					size_t be = std::min((size_t)(p->Start + p->Length), ed);
+					if (bs >= be) continue;
+					vector<int>::const_iterator x;
+					for (x=P.begin(); x != P.end(); x++)
 					{
-						size_t i=p->Start, n=p->Length;
-						C_Int32 *s = &((*varPos)[0]) + i;
-						if (RngSet.Size() == 1)
+						spans.clear();
+						PosIdx.Find(bs, be, *x, *x, spans);
+						vector<CPosIndex::TSpan>::const_iterator ss;
+						for (ss=spans.begin(); ss != spans.end(); ss++)
 						{
-							// there is only a range, optimized for this situation
-							int st, ed;
-							RngSet.GetRanges(&st, &ed);
-							if (!IsIntersect)
+							for (size_t j=ss->Start; j < ss->End; j++)
 							{
-								for (; n > 0; n--, i++, s++)
-									if (st<=*s && *s<=ed) array[i] = TRUE;
-							} else {
-								C_BOOL *b = &sel_array[i];
-								for (; n > 0; n--, i++, s++)
-									if (*b++ && st<=*s && *s<=ed) array[i] = TRUE;
-							}
-						} else {
-							if (!IsIntersect)
-							{
-								for (; n > 0; n--, i++)
-									if (RngSet.IsIncluded(*s++)) array[i] = TRUE;
-							} else {
-								C_BOOL *b = &sel_array[i];
-								for (; n > 0; n--, i++, s++)
+								if (IsIntersect && !sel_array[j]) continue;
+								if (!ss->Exact && varPos[j] != *x) continue;
+								if (!MultiPos)
 								{
-									if (*b++)
-										if (RngSet.IsIncluded(*s)) array[i] = TRUE;
+									// only the first of consecutive candidates
+									//   at the same chromosome and position
+									ssize_t k = (ssize_t)j - 1;
+									if (IsIntersect)
+										while (k >= (ssize_t)st && !sel_array[k]) k--;
+									if (k >= (ssize_t)st && varPos[k] == *x)
+									{
+										vector<CChromIndex::TRange>::const_iterator q;
+										for (q=rng.begin(); q != rng.end(); q++)
+											if (q->Start<=k && k<q->Start+q->Length) break;
+										if (q != rng.end()) continue;
+									}
 								}
+								hits.push_back(j);
 							}
 						}
 					}
@@ -780,17 +1001,25 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceChrom(SEXP gdsfile, SEXP include,
 			}
 		}
 
+		// set the selection
 		if (IsIntersect)
 		{
-			// TODO: optimized by SIMD
-			C_BOOL *p = sel_array, *s = array;
-			for (size_t n=array_size; n > 0; n--)
-				(*p++) &= (*s++);
-		}
-		if (Rf_asLogical(verbose) == TRUE)
-			Rprintf(INFO_SEL_NUM_VARIANT, PrettyInt(File.VariantSelNum()));
+			if (ed > st) memset(sel_array + st, FALSE, ed - st);
+		} else
+			Sel.ClearSelectVariant();
+		sort(hits.begin(), hits.end());
+		vector<size_t>::const_iterator p;
+		for (p=hits.begin(); p != hits.end(); p++)
+			sel_array[*p] = TRUE;
+		Sel.varTrueNum = hits.size();
+		if (!hits.empty())
+		{
+			Sel.varStart = hits.front(); Sel.varEnd = hits.back() + 1;
+		} else
+			Sel.varStart = Sel.varEnd = 0;
 
-		UNPROTECT(nProtected);
+		if (Rf_asLogical(verbose) == TRUE)
+			Rprintf(INFO_SEL_NUM_VARIANT, PrettyInt(hits.size()));
 
 	COREARRAY_CATCH
 }
@@ -822,29 +1051,20 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SetSpaceAnnotID(SEXP gdsfile, SEXP ID, SEXP Verbos
 		if (len != File.VariantNum())
 			throw ErrSeqArray(ERR_DIM, VarName);
 
+		// the indices of IDs
 		TSelection &Sel = File.Selection();
-		set<string> id_set;
-		const size_t n = XLENGTH(ID);
-		for (size_t i=0; i < n; i++)
-		{
-			SEXP s = STRING_ELT(ID, i);
-			if ((s != NA_STRING) && (CHAR(s) != 0))
-				id_set.insert(CHAR(s));
-		}
-
-		const int SIZE = 4096;
-		C_BOOL *p = Sel.pVariant;
-		vector<string> buffer(SIZE);
-		for (C_Int32 st=0; len > 0; )
+		vector<C_Int32> idx;
+		get_id_index(File, VarName, ID, true, idx);
+		// set selection
+		Sel.GetStructVariant();
+		set_sel_index(Sel.pVariant, Sel.varStart, Sel.varEnd, idx, false);
+		Sel.varTrueNum = idx.size();
+		if (!idx.empty())
 		{
-			C_Int32 m = (len <= SIZE) ? len : SIZE;
-			GDS_Array_ReadData(N, &st, &m, &buffer[0], svStrUTF8);
-			for (C_Int32 i=0; i < m; i++)
-				*p++ = (id_set.find(buffer[i]) != id_set.end());
-			st += m; len -= m;
-		}
+			Sel.varStart = idx.front(); Sel.varEnd = idx.back() + 1;
+		} else
+			Sel.varStart = Sel.varEnd = 0;
 
-		Sel.varTrueNum = -1;
 		if (verbose)
 			Rprintf(INFO_SEL_NUM_VARIANT, PrettyInt(File.VariantSelNum()));
 
@@ -1041,22 +1261,27 @@ COREARRAY_DLL_EXPORT SEXP SEQ_SplitSelectionX(SEXP gdsfile, SEXP index, SEXP spl
 			memset(p_sel, 0, ntot);
 		}
 
-		// set selection
+		// set selection, and the positions of the first and last TRUEs
 		const int st = p_sel_idx[job_idx] - 1;
-		int n = 0, i = st;
+		int n = 0, i = st, i_first = 0, i_last = -1;
 		for (; n<blsize && i<ntot; i++)
 		{
 			if (base_sel[i])
-				{ p_sel[i] = TRUE; n++; }
+			{
+				p_sel[i] = TRUE;
+				if (n++ == 0) i_first = i;
+				i_last = i;
+			}
 		}
 
 		// finalize
 		if (split_by_variant)
 		{
 			s.varTrueNum = n;
-			s.varStart = st; s.varEnd = i;
+			s.varStart = i_first; s.varEnd = i_last + 1;
 		} else {
 			s.ClearStructSample();
+			s.SetCountSample(n, i_first, i_last + 1);
 		}
 
 		// ---------------------------------------------------
@@ -1296,6 +1521,9 @@ COREARRAY_DLL_EXPORT SEXP SEQ_System()
 	#endif
 	#ifdef COREARRAY_SIMD_SSSE3
 		ss.push_back("SSSE3");
+	#else
+		// selected at runtime for the genotype lookup tables
+		if (vec_geno2_lut_simd()) ss.push_back("SSSE3 (runtime)");
 	#endif
 	#ifdef COREARRAY_SIMD_SSE4_1
 		ss.push_back("SSE4.1");
@@ -1488,12 +1716,11 @@ COREARRAY_DLL_EXPORT void R_init_SeqArray(DllInfo *info)
 	extern SEXP SEQ_MergePhase(SEXP, SEXP, SEXP, SEXP, SEXP);
 	extern SEXP SEQ_MergeInfo(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 	extern SEXP SEQ_MergeFormat(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+	extern SEXP SEQ_MergeRows(SEXP, SEXP, SEXP, SEXP);
 
 	extern SEXP SEQ_BApply_Variant(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 	extern SEXP SEQ_Unit_SlidingWindows(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 
-	extern SEXP SEQ_bgzip_create(SEXP);
-
 	static R_CallMethodDef callMethods[] =
 	{
 		CALL(SEQ_Pkg_Init, 3),
@@ -1507,11 +1734,12 @@ COREARRAY_DLL_EXPORT void R_init_SeqArray(DllInfo *info)
 
 		CALL(SEQ_MergeAllele, 4),           CALL(SEQ_MergeGeno, 5),
 		CALL(SEQ_MergePhase, 5),            CALL(SEQ_MergeInfo, 6),
-		CALL(SEQ_MergeFormat, 6),
+		CALL(SEQ_MergeFormat, 6),           CALL(SEQ_MergeRows, 4),
 
 		CALL(SEQ_SetSpaceSample, 4),        CALL(SEQ_SetSpaceSample2, 4),
 		CALL(SEQ_SetSpaceVariant, 4),       CALL(SEQ_SetSpaceVariant2, 4),
-		CALL(SEQ_SetSpaceChrom, 7),         CALL(SEQ_SetSpaceAnnotID, 3),
+		CALL(SEQ_SetSpaceChrom, 7),         CALL(SEQ_SetSpacePos, 6),
+		CALL(SEQ_SetSpaceAnnotID, 3),
 
 		CALL(SEQ_SplitSelection, 5),        CALL(SEQ_SplitSelectionX, 9),
 		CALL(SEQ_GetSpace, 2),
@@ -1528,8 +1756,6 @@ COREARRAY_DLL_EXPORT void R_init_SeqArray(DllInfo *info)
 		CALL(SEQ_IntAssign, 2),             CALL(SEQ_AppendFill, 3),
 		CALL(SEQ_ClearVarMap, 1),
 
-		CALL(SEQ_bgzip_create, 1),
-
 		CALL(SEQ_Progress, 2),              CALL(SEQ_ProgressAdd, 2),
 
 		{ NULL, NULL, 0 }
@@ -193,6 +193,24 @@ SEXP test_int32_replace(SEXP val, SEXP start, SEXP find, SEXP substitute)
 }
 
 
+SEXP test_geno2_lut(SEXP geno, SEXP lut)
+{
+	const size_t n = XLENGTH(geno) / 2;
+	SEXP rv_ans = NEW_RAW(n);
+	vec_u8_geno2_lut(RAW(geno), RAW(rv_ans), n, RAW(lut));
+	return rv_ans;
+}
+
+
+SEXP test_geno2_lut_i32(SEXP geno, SEXP lut)
+{
+	const size_t n = XLENGTH(geno) / 2;
+	SEXP rv_ans = NEW_INTEGER(n);
+	vec_u8_geno2_lut_i32(RAW(geno), INTEGER(rv_ans), n, RAW(lut));
+	return rv_ans;
+}
+
+
 SEXP test_position_index(SEXP node, SEXP position)
 {
 	COREARRAY_TRY
@@ -220,4 +238,61 @@ SEXP test_position_index(SEXP node, SEXP position)
 	COREARRAY_CATCH
 }
 
+
+SEXP test_index_sel(SEXP node, SEXP sel)
+{
+	COREARRAY_TRY
+
+		SeqArray::CIndex Idx;
+		Idx.Init(GDS_R_SEXP2Obj(node, TRUE), NULL);
+
+		std::vector<C_BOOL> ss(XLENGTH(sel));
+		for (size_t i=0; i < ss.size(); i++)
+			ss[i] = (LOGICAL(sel)[i] == TRUE);
+		int var_start, var_count;
+		std::vector<C_BOOL> var_sel;
+
+		rv_ans = PROTECT(NEW_LIST(4));
+		SET_ELEMENT(rv_ans, 0, Idx.GetLen_Sel(&ss[0]));
+		SET_ELEMENT(rv_ans, 1, Idx.GetLen_Sel(&ss[0], var_start, var_count,
+			var_sel));
+		SET_ELEMENT(rv_ans, 2, ScalarInteger(var_start));
+		SEXP vs = NEW_LOGICAL(var_sel.size());
+		SET_ELEMENT(rv_ans, 3, vs);
+		for (size_t i=0; i < var_sel.size(); i++)
+			LOGICAL(vs)[i] = var_sel[i];
+
+		UNPROTECT(1);
+
+	COREARRAY_CATCH
+}
+
+
+SEXP test_geno_index(SEXP node, SEXP position)
+{
+	COREARRAY_TRY
+
+		SeqArray::CGenoIndex Idx;
+		Idx.Init(GDS_R_SEXP2Obj(node, TRUE), NULL);
+
+		rv_ans = PROTECT(NEW_LIST(2));
+		SEXP sum = PROTECT(NEW_INTEGER(XLENGTH(position)));
+		SET_ELEMENT(rv_ans, 0, sum);
+		SEXP value  = PROTECT(NEW_INTEGER(XLENGTH(position)));
+		SET_ELEMENT(rv_ans, 1, value);
+
+		for (int i=0; i < XLENGTH(position); i++)
+		{
+			C_Int64 cnt;
+			C_UInt8 val;
+			Idx.GetInfo(INTEGER(position)[i]-1, cnt, val);
+			INTEGER(sum)[i] = cnt;
+			INTEGER(value)[i] = val;
+		}
+
+		UNPROTECT(3);
+
+	COREARRAY_CATCH
+}
+
 }
@@ -891,6 +891,304 @@ void vec_u8_shr_b2(uint8_t *p, size_t n)
 }
 
 
+/// *p |= (*s) << shift for 8-bit integers
+void vec_u8_or_shl(uint8_t *p, const uint8_t *s, size_t n, int shift)
+{
+#ifdef COREARRAY_SIMD_SSE2
+
+	// header 1, 16-byte aligned
+	size_t h = (16 - ((size_t)p & 0x0F)) & 0x0F;
+	for (; (n > 0) && (h > 0); n--, h--)
+		*p++ |= (uint8_t)((*s++) << shift);
+
+	// body, SSE2, shifting 16-bit integers and masking the carried bits
+	const __m128i cnt  = _mm_cvtsi32_si128(shift);
+	const __m128i mask = _mm_set1_epi8((char)((0xFF << shift) & 0xFF));
+
+#   ifdef COREARRAY_SIMD_AVX2
+
+	// header 2, 32-byte aligned
+	if ((n >= 16) && ((size_t)p & 0x10))
+	{
+		__m128i v = _mm_sll_epi16(_mm_loadu_si128((__m128i const*)s), cnt);
+		v = _mm_or_si128(_mm_load_si128((__m128i const*)p), _mm_and_si128(v, mask));
+		_mm_store_si128((__m128i *)p, v);
+		n -= 16; p += 16; s += 16;
+	}
+
+	const __m256i mask2 = _mm256_set1_epi8((char)((0xFF << shift) & 0xFF));
+	for (; n >= 32; n-=32, p+=32, s+=32)
+	{
+		__m256i v = _mm256_sll_epi16(_mm256_loadu_si256((__m256i const*)s), cnt);
+		v = _mm256_or_si256(_mm256_load_si256((__m256i const*)p),
+			_mm256_and_si256(v, mask2));
+		_mm256_store_si256((__m256i *)p, v);
+	}
+
+#   endif
+
+	for (; n >= 16; n-=16, p+=16, s+=16)
+	{
+		__m128i v = _mm_sll_epi16(_mm_loadu_si128((__m128i const*)s), cnt);
+		v = _mm_or_si128(_mm_load_si128((__m128i const*)p), _mm_and_si128(v, mask));
+		_mm_store_si128((__m128i *)p, v);
+	}
+
+#endif
+
+	// tail
+	for (; n > 0; n--) *p++ |= (uint8_t)((*s++) << shift);
+}
+
+
+/// *p |= (*s) << shift, and then replace 'val' by 'substitute' in the same pass
+void vec_u8_or_shl_replace(uint8_t *p, const uint8_t *s, size_t n, int shift,
+	uint8_t val, uint8_t substitute)
+{
+#ifdef COREARRAY_SIMD_SSE2
+
+	// header 1, 16-byte aligned
+	size_t h = (16 - ((size_t)p & 0x0F)) & 0x0F;
+	for (; (n > 0) && (h > 0); n--, h--, p++)
+	{
+		uint8_t v = *p | (uint8_t)((*s++) << shift);
+		*p = (v == val) ? substitute : v;
+	}
+
+	// body, SSE2, shifting 16-bit integers and masking the carried bits
+	const __m128i cnt  = _mm_cvtsi32_si128(shift);
+	const __m128i mask = _mm_set1_epi8((char)((0xFF << shift) & 0xFF));
+	const __m128i cmp  = _mm_set1_epi8((char)val);
+	const __m128i sub  = _mm_set1_epi8((char)substitute);
+
+#   ifdef COREARRAY_SIMD_AVX2
+
+	// header 2, 32-byte aligned
+	if ((n >= 16) && ((size_t)p & 0x10))
+	{
+		__m128i v = _mm_sll_epi16(_mm_loadu_si128((__m128i const*)s), cnt);
+		v = _mm_or_si128(_mm_load_si128((__m128i const*)p), _mm_and_si128(v, mask));
+		__m128i c = _mm_cmpeq_epi8(v, cmp);
+		v = _mm_or_si128(_mm_and_si128(c, sub), _mm_andnot_si128(c, v));
+		_mm_store_si128((__m128i *)p, v);
+		n -= 16; p += 16; s += 16;
+	}
+
+	const __m256i mask2 = _mm256_set1_epi8((char)((0xFF << shift) & 0xFF));
+	const __m256i cmp2  = _mm256_set1_epi8((char)val);
+	const __m256i sub2  = _mm256_set1_epi8((char)substitute);
+	for (; n >= 32; n-=32, p+=32, s+=32)
+	{
+		__m256i v = _mm256_sll_epi16(_mm256_loadu_si256((__m256i const*)s), cnt);
+		v = _mm256_or_si256(_mm256_load_si256((__m256i const*)p),
+			_mm256_and_si256(v, mask2));
+		__m256i c = _mm256_cmpeq_epi8(v, cmp2);
+		_mm256_store_si256((__m256i *)p, _mm256_blendv_epi8(v, sub2, c));
+	}
+
+#   endif
+
+	for (; n >= 16; n-=16, p+=16, s+=16)
+	{
+		__m128i v = _mm_sll_epi16(_mm_loadu_si128((__m128i const*)s), cnt);
+		v = _mm_or_si128(_mm_load_si128((__m128i const*)p), _mm_and_si128(v, mask));
+		__m128i c = _mm_cmpeq_epi8(v, cmp);
+		v = _mm_or_si128(_mm_and_si128(c, sub), _mm_andnot_si128(c, v));
+		_mm_store_si128((__m128i *)p, v);
+	}
+
+#endif
+
+	// tail
+	for (; n > 0; n--, p++)
+	{
+		uint8_t v = *p | (uint8_t)((*s++) << shift);
+		*p = (v == val) ? substitute : v;
+	}
+}
+
+
+/// pack min(*s, 3) into 2-bit values (4 values per byte, padded with 3)
+void vec_u8_pack_b2(uint8_t *out, const uint8_t *s, size_t n)
+{
+#ifdef COREARRAY_SIMD_SSE2
+
+	// body, SSE2
+	const __m128i three = _mm_set1_epi8(3);
+	const __m128i mask  = _mm_set1_epi32(0xFF);
+	for (; n >= 64; n-=64, s+=64, out+=16)
+	{
+		__m128i v0 = _mm_min_epu8(_mm_loadu_si128((__m128i const*)s), three);
+		__m128i v1 = _mm_min_epu8(_mm_loadu_si128((__m128i const*)(s+16)), three);
+		__m128i v2 = _mm_min_epu8(_mm_loadu_si128((__m128i const*)(s+32)), three);
+		__m128i v3 = _mm_min_epu8(_mm_loadu_si128((__m128i const*)(s+48)), three);
+		// 4 bytes in a 32-bit integer -> the lowest byte
+		v0 = _mm_or_si128(v0, _mm_srli_epi32(v0, 6));
+		v0 = _mm_and_si128(_mm_or_si128(v0, _mm_srli_epi32(v0, 12)), mask);
+		v1 = _mm_or_si128(v1, _mm_srli_epi32(v1, 6));
+		v1 = _mm_and_si128(_mm_or_si128(v1, _mm_srli_epi32(v1, 12)), mask);
+		v2 = _mm_or_si128(v2, _mm_srli_epi32(v2, 6));
+		v2 = _mm_and_si128(_mm_or_si128(v2, _mm_srli_epi32(v2, 12)), mask);
+		v3 = _mm_or_si128(v3, _mm_srli_epi32(v3, 6));
+		v3 = _mm_and_si128(_mm_or_si128(v3, _mm_srli_epi32(v3, 12)), mask);
+		_mm_storeu_si128((__m128i *)out, _mm_packus_epi16(
+			_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3)));
+	}
+
+#endif
+
+	// tail
+	#define B2(x)    ((x) < 3 ? (x) : 3)
+	for (; n >= 4; n-=4, s+=4)
+		*out++ = B2(s[0]) | (B2(s[1]) << 2) | (B2(s[2]) << 4) | (B2(s[3]) << 6);
+	if (n > 0)
+	{
+		uint8_t b = 0xFF;
+		for (size_t i=0; i < n; i++)
+			b = (b & ~(0x03 << (i*2))) | (B2(s[i]) << (i*2));
+		*out = b;
+	}
+	#undef B2
+}
+
+
+// SSSE3 kernels of diploid 2-bit genotypes with a lookup table, selected at
+//   runtime if the compiler flags do not enable SSSE3 (e.g., the default
+//   flags of R on x86-64 which only enable SSE2)
+
+#if defined(COREARRAY_SIMD_SSSE3)
+#   define VEC_GENO2_SSSE3
+#   define VEC_TARGET_SSSE3
+#   define VEC_HAS_SSSE3    1
+#elif defined(COREARRAY_SIMD_SSE2) && (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#   include <tmmintrin.h>
+#   define VEC_GENO2_SSSE3
+#   define VEC_TARGET_SSSE3    __attribute__((target("ssse3")))
+#   define VEC_HAS_SSSE3    __builtin_cpu_supports("ssse3")
+#endif
+
+#ifdef VEC_GENO2_SSSE3
+
+/// the SSSE3 body of vec_u8_geno2_lut(), return the number of outputs
+static VEC_TARGET_SSSE3 size_t geno2_lut_ssse3(const uint8_t *p,
+	uint8_t *out, size_t n, const uint8_t lut[16])
+{
+	const __m128i tab  = _mm_loadu_si128((__m128i const*)lut);
+	const __m128i mask = _mm_set1_epi16(0x03);
+	size_t m = 0;
+	for (; n >= 16; n-=16, p+=32, out+=16, m+=16)
+	{
+		__m128i w1 = _mm_loadu_si128((__m128i const*)p);
+		__m128i w2 = _mm_loadu_si128((__m128i const*)(p+16));
+		// the index of lookup table in a 16-bit integer
+		w1 = _mm_or_si128(_mm_and_si128(w1, mask),
+			_mm_and_si128(_mm_srli_epi16(w1, 6), _mm_slli_epi16(mask, 2)));
+		w2 = _mm_or_si128(_mm_and_si128(w2, mask),
+			_mm_and_si128(_mm_srli_epi16(w2, 6), _mm_slli_epi16(mask, 2)));
+		__m128i i = _mm_packus_epi16(w1, w2);
+		_mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(tab, i));
+	}
+	return m;
+}
+
+/// the SSSE3 body of vec_u8_geno2_lut_i32(), return the number of outputs
+static VEC_TARGET_SSSE3 size_t geno2_lut_i32_ssse3(const uint8_t *p,
+	int32_t *out, size_t n, const uint8_t lut[16])
+{
+	const __m128i tab  = _mm_loadu_si128((__m128i const*)lut);
+	const __m128i mask = _mm_set1_epi16(0x03);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i na   = _mm_set1_epi32(0x80000000);
+	const __m128i ff   = _mm_set1_epi32(0xFF);
+	size_t m = 0;
+	for (; n >= 16; n-=16, p+=32, out+=16, m+=16)
+	{
+		__m128i w1 = _mm_loadu_si128((__m128i const*)p);
+		__m128i w2 = _mm_loadu_si128((__m128i const*)(p+16));
+		// the index of lookup table in a 16-bit integer
+		w1 = _mm_or_si128(_mm_and_si128(w1, mask),
+			_mm_and_si128(_mm_srli_epi16(w1, 6), _mm_slli_epi16(mask, 2)));
+		w2 = _mm_or_si128(_mm_and_si128(w2, mask),
+			_mm_and_si128(_mm_srli_epi16(w2, 6), _mm_slli_epi16(mask, 2)));
+		__m128i d = _mm_shuffle_epi8(tab, _mm_packus_epi16(w1, w2));
+		// expand to 32-bit integers
+		__m128i lo = _mm_unpacklo_epi8(d, zero), hi = _mm_unpackhi_epi8(d, zero);
+		__m128i v, c;
+		v = _mm_unpacklo_epi16(lo, zero); c = _mm_cmpeq_epi32(v, ff);
+		_mm_storeu_si128((__m128i *)out,
+			_mm_or_si128(_mm_andnot_si128(c, v), _mm_and_si128(c, na)));
+		v = _mm_unpackhi_epi16(lo, zero); c = _mm_cmpeq_epi32(v, ff);
+		_mm_storeu_si128((__m128i *)(out+4),
+			_mm_or_si128(_mm_andnot_si128(c, v), _mm_and_si128(c, na)));
+		v = _mm_unpacklo_epi16(hi, zero); c = _mm_cmpeq_epi32(v, ff);
+		_mm_storeu_si128((__m128i *)(out+8),
+			_mm_or_si128(_mm_andnot_si128(c, v), _mm_and_si128(c, na)));
+		v = _mm_unpackhi_epi16(hi, zero); c = _mm_cmpeq_epi32(v, ff);
+		_mm_storeu_si128((__m128i *)(out+12),
+			_mm_or_si128(_mm_andnot_si128(c, v), _mm_and_si128(c, na)));
+	}
+	return m;
+}
+
+#endif
+
+
+/// whether the SSSE3 kernels of vec_u8_geno2_lut*() are used
+int vec_geno2_lut_simd(void)
+{
+#ifdef VEC_GENO2_SSSE3
+	return VEC_HAS_SSSE3 ? 1 : 0;
+#else
+	return 0;
+#endif
+}
+
+
+/// out[i] = lut[p[2*i] | (p[2*i+1] << 2)] for diploid 2-bit genotypes
+void vec_u8_geno2_lut(const uint8_t *p, uint8_t *out, size_t n,
+	const uint8_t lut[16])
+{
+#ifdef VEC_GENO2_SSSE3
+	if (VEC_HAS_SSSE3)
+	{
+		size_t m = geno2_lut_ssse3(p, out, n, lut);
+		p += 2*m; out += m; n -= m;
+	}
+#endif
+
+	// tail
+	for (; n > 0; n--, p+=2)
+		*out++ = lut[(p[0] & 0x03) | ((p[1] & 0x03) << 2)];
+}
+
+
+/// out[i] = lut[p[2*i] | (p[2*i+1] << 2)] for diploid 2-bit genotypes,
+///   and 0xFF in 'lut' is replaced by NA_INTEGER
+void vec_u8_geno2_lut_i32(const uint8_t *p, int32_t *out, size_t n,
+	const uint8_t lut[16])
+{
+	#define NA_INTEGER  0x80000000
+
+#ifdef VEC_GENO2_SSSE3
+	if (VEC_HAS_SSSE3)
+	{
+		size_t m = geno2_lut_i32_ssse3(p, out, n, lut);
+		p += 2*m; out += m; n -= m;
+	}
+#endif
+
+	// tail
+	for (; n > 0; n--, p+=2)
+	{
+		uint8_t d = lut[(p[0] & 0x03) | ((p[1] & 0x03) << 2)];
+		*out++ = (d != 0xFF) ? d : (int32_t)NA_INTEGER;
+	}
+
+	#undef NA_INTEGER
+}
+
+
 
 // ===========================================================
 // functions for int16
@@ -1578,6 +1876,121 @@ void vec_i32_shr_b2(int32_t *p, size_t n)
 }
 
 
+/// *p |= (*s) << shift, assuming 'p' is 4-byte aligned
+void vec_i32_or_shl_u8(int32_t *p, const uint8_t *s, size_t n, int shift)
+{
+#ifdef COREARRAY_SIMD_SSE2
+
+	// header 1, 16-byte aligned
+	size_t h = ((16 - ((size_t)p & 0x0F)) & 0x0F) >> 2;
+	for (; (n > 0) && (h > 0); n--, h--)
+		*p++ |= (int32_t)(*s++) << shift;
+
+	// body, SSE2
+	const __m128i cnt  = _mm_cvtsi32_si128(shift);
+	const __m128i zero = _mm_setzero_si128();
+
+#   ifdef COREARRAY_SIMD_AVX2
+
+	// header 2, 32-byte aligned
+	for (; (n > 0) && ((size_t)p & 0x1F); n--)
+		*p++ |= (int32_t)(*s++) << shift;
+
+	for (; n >= 8; n-=8, p+=8, s+=8)
+	{
+		__m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*)s));
+		v = _mm256_or_si256(_mm256_load_si256((__m256i const*)p),
+			_mm256_sll_epi32(v, cnt));
+		_mm256_store_si256((__m256i *)p, v);
+	}
+
+#   endif
+
+	for (; n >= 4; n-=4, p+=4, s+=4)
+	{
+		int32_t b;
+		memcpy(&b, s, sizeof(b));
+		__m128i v = _mm_unpacklo_epi16(
+			_mm_unpacklo_epi8(_mm_cvtsi32_si128(b), zero), zero);
+		v = _mm_or_si128(_mm_load_si128((__m128i const*)p),
+			_mm_sll_epi32(v, cnt));
+		_mm_store_si128((__m128i *)p, v);
+	}
+
+#endif
+
+	// tail
+	for (; n > 0; n--) *p++ |= (int32_t)(*s++) << shift;
+}
+
+
+/// *p |= (*s) << shift, and then replace 'val' by 'substitute' in the same pass,
+///   assuming 'p' is 4-byte aligned
+void vec_i32_or_shl_u8_replace(int32_t *p, const uint8_t *s, size_t n,
+	int shift, int32_t val, int32_t substitute)
+{
+#ifdef COREARRAY_SIMD_SSE2
+
+	// header 1, 16-byte aligned
+	size_t h = ((16 - ((size_t)p & 0x0F)) & 0x0F) >> 2;
+	for (; (n > 0) && (h > 0); n--, h--, p++)
+	{
+		int32_t v = *p | ((int32_t)(*s++) << shift);
+		*p = (v == val) ? substitute : v;
+	}
+
+	// body, SSE2
+	const __m128i cnt  = _mm_cvtsi32_si128(shift);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i cmp  = _mm_set1_epi32(val);
+	const __m128i sub  = _mm_set1_epi32(substitute);
+
+#   ifdef COREARRAY_SIMD_AVX2
+
+	// header 2, 32-byte aligned
+	for (; (n > 0) && ((size_t)p & 0x1F); n--, p++)
+	{
+		int32_t v = *p | ((int32_t)(*s++) << shift);
+		*p = (v == val) ? substitute : v;
+	}
+
+	const __m256i cmp2 = _mm256_set1_epi32(val);
+	const __m256i sub2 = _mm256_set1_epi32(substitute);
+	for (; n >= 8; n-=8, p+=8, s+=8)
+	{
+		__m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*)s));
+		v = _mm256_or_si256(_mm256_load_si256((__m256i const*)p),
+			_mm256_sll_epi32(v, cnt));
+		__m256i c = _mm256_cmpeq_epi32(v, cmp2);
+		_mm256_store_si256((__m256i *)p, _mm256_blendv_epi8(v, sub2, c));
+	}
+
+#   endif
+
+	for (; n >= 4; n-=4, p+=4, s+=4)
+	{
+		int32_t b;
+		memcpy(&b, s, sizeof(b));
+		__m128i v = _mm_unpacklo_epi16(
+			_mm_unpacklo_epi8(_mm_cvtsi32_si128(b), zero), zero);
+		v = _mm_or_si128(_mm_load_si128((__m128i const*)p),
+			_mm_sll_epi32(v, cnt));
+		__m128i c = _mm_cmpeq_epi32(v, cmp);
+		v = _mm_or_si128(_mm_and_si128(c, sub), _mm_andnot_si128(c, v));
+		_mm_store_si128((__m128i *)p, v);
+	}
+
+#endif
+
+	// tail
+	for (; n > 0; n--, p++)
+	{
+		int32_t v = *p | ((int32_t)(*s++) << shift);
+		*p = (v == val) ? substitute : v;
+	}
+}
+
+
 /// bounds checking, excluding NA_INTEGER
 int vec_i32_bound_check(const int32_t *p, size_t n, int bound)
 {
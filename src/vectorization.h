@@ -330,6 +330,30 @@ COREARRAY_DLL_DEFAULT void vec_i8_cnt_dosage_alt2(const int8_t *p,
 /// shifting *p right by 2 bits, assuming p is 2-byte aligned
 COREARRAY_DLL_DEFAULT void vec_u8_shr_b2(uint8_t *p, size_t n);
 
+/// *p |= (*s) << shift, e.g., merging an additional 2-bit plane of genotypes
+COREARRAY_DLL_DEFAULT void vec_u8_or_shl(uint8_t *p, const uint8_t *s,
+	size_t n, int shift);
+
+/// *p |= (*s) << shift, and then replace 'val' by 'substitute' in the same pass
+COREARRAY_DLL_DEFAULT void vec_u8_or_shl_replace(uint8_t *p, const uint8_t *s,
+	size_t n, int shift, uint8_t val, uint8_t substitute);
+
+/// pack min(*s, 3) into 2-bit values (4 values per byte, padded with 3)
+COREARRAY_DLL_DEFAULT void vec_u8_pack_b2(uint8_t *out, const uint8_t *s,
+	size_t n);
+
+/// whether the SSSE3 kernels of vec_u8_geno2_lut*() are used (1) or not (0)
+COREARRAY_DLL_DEFAULT int vec_geno2_lut_simd(void);
+
+/// out[i] = lut[p[2*i] | (p[2*i+1] << 2)] for diploid 2-bit genotypes
+COREARRAY_DLL_DEFAULT void vec_u8_geno2_lut(const uint8_t *p, uint8_t *out,
+	size_t n, const uint8_t lut[16]);
+
+/// out[i] = lut[p[2*i] | (p[2*i+1] << 2)] for diploid 2-bit genotypes,
+///   and 0xFF in 'lut' is replaced by NA_INTEGER
+COREARRAY_DLL_DEFAULT void vec_u8_geno2_lut_i32(const uint8_t *p, int32_t *out,
+	size_t n, const uint8_t lut[16]);
+
 
 
 // ===========================================================
@@ -375,6 +399,15 @@ COREARRAY_DLL_DEFAULT void vec_i32_cnt_dosage_alt2(const int32_t *p,
 /// shifting *p right by 2 bits, assuming p is 4-byte aligned
 COREARRAY_DLL_DEFAULT void vec_i32_shr_b2(int32_t *p, size_t n);
 
+/// *p |= (*s) << shift, assuming 'p' is 4-byte aligned
+COREARRAY_DLL_DEFAULT void vec_i32_or_shl_u8(int32_t *p, const uint8_t *s,
+	size_t n, int shift);
+
+/// *p |= (*s) << shift, and then replace 'val' by 'substitute' in the same pass,
+///   assuming 'p' is 4-byte aligned
+COREARRAY_DLL_DEFAULT void vec_i32_or_shl_u8_replace(int32_t *p,
+	const uint8_t *s, size_t n, int shift, int32_t val, int32_t substitute);
+
 /// bounds checking, return 0 if fails
 COREARRAY_DLL_DEFAULT int vec_i32_bound_check(const int32_t *p, size_t n, int bound);
 